@@ -0,0 +1,360 @@
+/*
+ * This header contains implementation of ARB_Map, an order-statistic map from keys to values.
+ *
+ * ARB_Map is a thin layer over ARB_Tree which keys are std::pair<const Key_T, T>. Pairs are
+ * compared by their first members with a transparent comparator, so every lookup and rank
+ * query of ARB_Tree takes a bare key. Iterators of the tree are read-only; ARB_Map wraps them
+ * to give mutable access to mapped values. Keys stay const.
+ */
+
+#ifndef INCLUDE_ARB_MAP_HPP
+#define INCLUDE_ARB_MAP_HPP
+
+#include <utility>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <tuple>
+#include <iterator>
+#include <stdexcept>
+#include <compare>
+#include <type_traits>
+
+#include "arb_tree.hpp"
+
+namespace yLab
+{
+
+namespace detail
+{
+
+// Compares pairs and keys by keys
+template<typename Key_T, typename T, typename Compare>
+struct Map_Compare
+{
+    using is_transparent = void;
+    using value_type = std::pair<const Key_T, T>;
+
+    [[no_unique_address]] Compare comp_;
+
+    template<typename K>
+    using key_of_t = std::conditional_t<std::is_same_v<K, value_type>, Key_T, K>;
+
+    template<typename Lhs, typename Rhs>
+    bool operator() (const Lhs &lhs, const Rhs &rhs) const
+    {
+        return comp_(key_of (lhs), key_of (rhs));
+    }
+
+    // Lets the tree compare once per node if Compare can do it
+    template<typename Lhs, typename Rhs>
+    requires three_way_comparator<Compare, key_of_t<Lhs>, key_of_t<Rhs>>
+    auto compare (const Lhs &lhs, const Rhs &rhs) const
+    {
+        return three_way (comp_, key_of (lhs), key_of (rhs));
+    }
+
+    static const Key_T &key_of (const value_type &value) noexcept { return value.first; }
+
+    template<typename K>
+    static const K &key_of (const K &key) noexcept { return key; }
+};
+
+} // namespace detail
+
+// Mutable iterator of ARB_Map. Converts to the read-only iterator of the underlying tree
+template<typename Base_Iterator>
+class map_iterator final
+{
+    Base_Iterator it_;
+
+public:
+
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = typename Base_Iterator::difference_type;
+    using value_type = typename Base_Iterator::value_type;
+    using reference = value_type &;
+    using pointer = value_type *;
+
+    map_iterator () = default;
+    explicit map_iterator (Base_Iterator it) noexcept : it_{it} {}
+
+    // Nodes aren't const objects, so casting const away is fine. It only exposes second as
+    // first of value_type is const
+    reference operator* () const { return const_cast<reference>(*it_); }
+    pointer operator-> () const { return std::addressof (**this); }
+
+    map_iterator &operator++ () noexcept
+    {
+        ++it_;
+        return *this;
+    }
+
+    map_iterator operator++ (int) noexcept { return map_iterator{it_++}; }
+
+    map_iterator &operator-- () noexcept
+    {
+        --it_;
+        return *this;
+    }
+
+    map_iterator operator-- (int) noexcept { return map_iterator{it_--}; }
+
+    Base_Iterator base () const noexcept { return it_; }
+    operator Base_Iterator () const noexcept { return it_; }
+
+    bool operator== (const map_iterator &rhs) const noexcept { return it_ == rhs.it_; }
+
+    friend difference_type operator- (const map_iterator &lhs, const map_iterator &rhs) noexcept
+    {
+        return lhs.it_ - rhs.it_;
+    }
+};
+
+template<typename Key_T, typename T, typename Compare = std::less<Key_T>,
+         typename Allocator = std::allocator<std::pair<const Key_T, T>>>
+class ARB_Map final
+{
+public:
+
+    using key_type = Key_T;
+    using mapped_type = T;
+    using value_type = std::pair<const Key_T, T>;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+
+private:
+
+    using value_compare_ = detail::Map_Compare<Key_T, T, Compare>;
+    using tree_type = ARB_Tree<value_type, value_compare_, Allocator>;
+    using color_type = typename tree_type::node_type::color_type;
+
+    tree_type tree_;
+
+public:
+
+    using size_type = typename tree_type::size_type;
+    using difference_type = typename tree_type::difference_type;
+    using const_iterator = typename tree_type::const_iterator;
+    using iterator = map_iterator<const_iterator>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    ARB_Map () : ARB_Map{key_compare{}} {}
+
+    explicit ARB_Map (const key_compare &comp, const allocator_type &alloc = allocator_type{})
+                     : tree_{value_compare_{comp}, alloc} {}
+
+    explicit ARB_Map (const allocator_type &alloc) : ARB_Map{key_compare{}, alloc} {}
+
+    template<std::input_iterator it>
+    ARB_Map (it first, it last, const key_compare &comp = key_compare{},
+             const allocator_type &alloc = allocator_type{})
+            : tree_{first, last, value_compare_{comp}, alloc} {}
+
+    ARB_Map (std::initializer_list<value_type> ilist, const key_compare &comp = key_compare{},
+             const allocator_type &alloc = allocator_type{})
+            : tree_{ilist, value_compare_{comp}, alloc} {}
+
+    // Observers
+
+    allocator_type get_allocator () const noexcept { return tree_.get_allocator(); }
+
+    key_compare key_comp () const { return tree_.key_comp().comp_; }
+
+    // Capacity
+
+    size_type size () const noexcept { return tree_.size(); }
+    bool empty () const noexcept { return tree_.empty(); }
+    size_type max_size () const noexcept { return tree_.max_size(); }
+
+    // Iterators
+
+    iterator begin () noexcept { return iterator{tree_.begin()}; }
+    const_iterator begin () const noexcept { return tree_.begin(); }
+    iterator end () noexcept { return iterator{tree_.end()}; }
+    const_iterator end () const noexcept { return tree_.end(); }
+
+    reverse_iterator rbegin () noexcept { return reverse_iterator{end()}; }
+    const_reverse_iterator rbegin () const noexcept { return const_reverse_iterator{end()}; }
+    reverse_iterator rend () noexcept { return reverse_iterator{begin()}; }
+    const_reverse_iterator rend () const noexcept { return const_reverse_iterator{begin()}; }
+
+    const_iterator cbegin () const noexcept { return begin(); }
+    const_iterator cend () const noexcept { return end(); }
+
+    // Element access
+
+    mapped_type &operator[] (const key_type &key) { return try_emplace (key).first->second; }
+    mapped_type &operator[] (key_type &&key)
+    {
+        return try_emplace (std::move (key)).first->second;
+    }
+
+    mapped_type &at (const key_type &key)
+    {
+        return const_cast<mapped_type &>(std::as_const (*this).at (key));
+    }
+
+    const mapped_type &at (const key_type &key) const
+    {
+        auto it = find (key);
+        if (it == end())
+            throw std::out_of_range{"ARB_Map: no such key"};
+
+        return it->second;
+    }
+
+    // Modifiers
+
+    void clear () { tree_.clear(); }
+
+    void swap (ARB_Map &other) noexcept (noexcept (tree_.swap (other.tree_)))
+    {
+        tree_.swap (other.tree_);
+    }
+
+    std::pair<iterator, bool> insert (const value_type &value)
+    {
+        return mutable_result (tree_.insert (value));
+    }
+
+    std::pair<iterator, bool> insert (value_type &&value)
+    {
+        return mutable_result (tree_.insert (std::move (value)));
+    }
+
+    template<std::input_iterator it>
+    void insert (it first, it last) { tree_.insert (first, last); }
+
+    void insert (std::initializer_list<value_type> ilist) { tree_.insert (ilist); }
+
+    template<typename... Args>
+    std::pair<iterator, bool> emplace (Args &&... args)
+    {
+        return mutable_result (tree_.emplace (std::forward<Args>(args)...));
+    }
+
+    // Unlike emplace(), doesn't construct anything (and doesn't move from args) if key is
+    // already in the map
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace (const key_type &key, Args &&... args)
+    {
+        return try_emplace_impl (key, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace (key_type &&key, Args &&... args)
+    {
+        return try_emplace_impl (std::move (key), std::forward<Args>(args)...);
+    }
+
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign (const key_type &key, M &&obj)
+    {
+        return insert_or_assign_impl (key, std::forward<M>(obj));
+    }
+
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign (key_type &&key, M &&obj)
+    {
+        return insert_or_assign_impl (std::move (key), std::forward<M>(obj));
+    }
+
+    iterator erase (const_iterator pos) { return iterator{tree_.erase (pos)}; }
+    iterator erase (iterator pos) { return erase (pos.base()); }
+
+    size_type erase (const key_type &key) { return tree_.erase (key); }
+
+    // Lookup
+
+    iterator find (const key_type &key) { return iterator{tree_.find (key)}; }
+    const_iterator find (const key_type &key) const { return tree_.find (key); }
+
+    bool contains (const key_type &key) const { return tree_.contains (key); }
+    size_type count (const key_type &key) const { return tree_.count (key); }
+
+    iterator lower_bound (const key_type &key) { return iterator{tree_.lower_bound (key)}; }
+    const_iterator lower_bound (const key_type &key) const { return tree_.lower_bound (key); }
+
+    iterator upper_bound (const key_type &key) { return iterator{tree_.upper_bound (key)}; }
+    const_iterator upper_bound (const key_type &key) const { return tree_.upper_bound (key); }
+
+    // Order statistics
+
+    // Element with the k-th smallest key or end(). As in ARB_Tree::operator[], k starts from 1
+    iterator nth (size_type k) { return iterator{tree_[k]}; }
+    const_iterator nth (size_type k) const { return tree_[k]; }
+
+    size_type rank (const_iterator it) const noexcept { return tree_.rank (it); }
+
+    size_type n_less_than (const key_type &key) const { return tree_.n_less_than (key); }
+    size_type n_less_equal (const key_type &key) const { return tree_.n_less_equal (key); }
+    size_type n_greater_than (const key_type &key) const { return tree_.n_greater_than (key); }
+
+    // Number of keys in [lo, hi)
+    size_type count_range (const key_type &lo, const key_type &hi) const
+    {
+        return tree_.count_range (lo, hi);
+    }
+
+    friend bool operator== (const ARB_Map &lhs, const ARB_Map &rhs)
+    {
+        return lhs.tree_ == rhs.tree_;
+    }
+
+    friend auto operator<=> (const ARB_Map &lhs, const ARB_Map &rhs)
+    requires std::three_way_comparable<value_type>
+    {
+        return lhs.tree_ <=> rhs.tree_;
+    }
+
+private:
+
+    static std::pair<iterator, bool> mutable_result (std::pair<const_iterator, bool> result)
+    {
+        return std::pair{iterator{result.first}, result.second};
+    }
+
+    template<typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace_impl (K &&key, Args &&... args)
+    {
+        auto position = tree_.find_and_count_position_to_insert (key);
+        if (position.node)
+            return std::pair{iterator{const_iterator{position.node}}, false};
+
+        typename tree_type::node_type *new_node;
+        try
+        {
+            new_node = tree_.make_node (std::in_place, color_type::red, std::piecewise_construct,
+                                        std::forward_as_tuple (std::forward<K>(key)),
+                                        std::forward_as_tuple (std::forward<Args>(args)...));
+        }
+        catch (...)
+        {
+            if (position.counted)
+                tree_.uncount_path (position.parent);
+            throw;
+        }
+
+        tree_.link_new_node (new_node, position);
+
+        return std::pair{iterator{const_iterator{new_node}}, true};
+    }
+
+    template<typename K, typename M>
+    std::pair<iterator, bool> insert_or_assign_impl (K &&key, M &&obj)
+    {
+        auto result = try_emplace_impl (std::forward<K>(key), std::forward<M>(obj));
+        if (!result.second)
+            result.first->second = std::forward<M>(obj);
+
+        return result;
+    }
+};
+
+} // namespace yLab
+
+#endif // INCLUDE_ARB_MAP_HPP
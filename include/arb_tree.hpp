@@ -5,6 +5,23 @@
  * which left child is the root. This implies that every ARB_Node in a tree
  * has a parent: another ARB_Node or the End_Node.
  *
+ * Nodes are allocated by Allocator rebound to ARB_Node<Key_T> through std::allocator_traits,
+ * so any standard-conforming allocator (std::pmr::polymorphic_allocator included) can be used.
+ * Alias yLab::pmr::ARB_Tree is provided for convenience. yLab::Pooled_ARB_Tree uses Pool_Allocator
+ * from node_pool.hpp. Union, intersection and difference of trees live in set_algebra.hpp.
+ * ARB_Map from arb_map.hpp maps keys to values with the same engine.
+ * ARB_Multiset is the same tree that keeps equivalent keys.
+ * Augmented_ARB_Tree keeps user-defined subtree aggregates (see augmentation.hpp) and answers
+ * range aggregate queries in O(log n) time. Persistent_ARB_Tree from persistent_tree.hpp shares
+ * nodes between versions and gives readers O(1) snapshots. Optimistic_ARB_Tree from
+ * optimistic_tree.hpp builds on it to serve lock-free readers next to a writer.
+ * Sharded_ARB_Tree from sharded_tree.hpp splits the key space between trees with separate locks.
+ * freeze() makes a read-only copy with a cache-friendly layout (see frozen_tree.hpp).
+ * BPlus_Tree from bplus_tree.hpp is a wide-node engine with the same set API.
+ * Red-black balancing is the default; AVL, WAVL and treap policies are in balancing.hpp.
+ * Lookups and insertions compare once per node if the comparator is three-way (see
+ * THREE-WAY COMPARISON below).
+ *
  * Defining DEBUG macro makes it possible to call graphic_dump() method that
  * is designed for dumping a tree by means of graphviz for debugging or just
  * for fun.
@@ -19,11 +36,24 @@
 #include <type_traits>
 #include <cassert>
 #include <compare>
+#include <concepts>
 #include <tuple>
 #include <memory>
+#include <memory_resource>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <optional>
+#include <iterator>
+#include <bit>
+#include <span>
+#include <vector>
+#include <numeric>
 
 #include "nodes.hpp"
+#include "balancing.hpp"
 #include "tree_iterator.hpp"
+#include "node_pool.hpp"
 
 #ifdef DEBUG
 #include <iostream>
@@ -36,263 +66,45 @@ namespace yLab
 namespace detail
 {
 
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ INSERTION ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ THREE-WAY COMPARISON ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 /*
- * Properties that:
- * 1. parent->parent_ exists
- * 2. parent->parent_ isn't end_node
- * are guaranteed by the algorithm (look rb_insert_fixup)
+ * A descent that has to tell an equivalent key from a greater one asks a less-than comparator
+ * twice per node. One call is enough if the comparator is three-way: it has member function
+ * compare (lhs, rhs) returning an ordering in addition to operator(), or it is std::less and the
+ * keys have operator<=>. The latter doesn't apply to two pointers as std::less orders any
+ * pointers while <=> doesn't
  */
-template<typename Node_T>
-Node_T *recolor_parent_grandparent_uncle (Node_T *parent, Node_T *uncle,
-                                          const Node_T *root) noexcept
-{
-    using color_type = typename Node_T::color_type;
-
-    assert (parent);
-    assert (uncle);
-    assert (parent->parent_unsafe());
+template<typename Compare>
+inline constexpr bool is_std_less = false;
 
-    parent->color_ = color_type::black;
-
-    parent = parent->parent_unsafe();
-    if (parent != root)
-        parent->color_ = color_type::red;
-
-    uncle->color_ = color_type::black;
-
-    return parent;
-};
+template<typename T>
+inline constexpr bool is_std_less<std::less<T>> = true;
 
-template<typename Node_T>
-Node_T *recolor_parent_grandparent (Node_T *parent) noexcept
+template<typename Compare, typename Lhs, typename Rhs>
+concept has_compare_member = requires (const Compare &comp, const Lhs &lhs, const Rhs &rhs)
 {
-    using color_type = typename Node_T::color_type;
-
-    assert (parent);
-    assert (parent->parent_unsafe());
-
-    parent->color_ = color_type::black;
-
-    parent = parent->parent_unsafe();
-    parent->color_ = color_type::red;
-
-    return parent;
+    { comp.compare (lhs, rhs) } -> std::convertible_to<std::partial_ordering>;
 };
 
-template <typename Node_T>
-void rb_insert_fixup (const Node_T *root, Node_T *new_node) noexcept
-{
-    using color_type = typename Node_T::color_type;
-
-    assert (new_node);
-
-    // Checks if "The root is black" property is violated
-    if (new_node == root)
-    {
-        new_node->color_ = color_type::black;
-        return;
-    }
-
-    // Further: (new_node != root) ==> (root->color_ == color_type::black)
-
-    auto parent = new_node->parent_unsafe();
-
-    // Checks if "If a node is red, then both its children are black" property is violated
-    while (new_node != root && parent->color_ == color_type::red)
-    {
-        /*
-         * Some notes:
-         * (1). First condition is important only for iterations 2, 3, ... but not for 1
-         * (2). (new_node != root) ==> (parent != end_node)
-         * (3). (parent->color_ == color_type::red) ==> (parent != root)
-         */
-
-        if (is_left_child (parent))
-        {
-            // (3) ==> exists (parent->parent_) != end_node
-            // Further: we will refer to parent->parent_ as "grandparent"
-            auto uncle = parent->parent_unsafe()->get_right();
-
-            if (is_red (uncle))
-            {
-                /* (uncle->color_ == color_type::red) ==> grandparent->color_ == color_type::black
-                 * ==> grandparent may be root */
-
-                new_node = recolor_parent_grandparent_uncle (parent, uncle, root);
-            }
-            else
-            {
-                if (!is_left_child (new_node))
-                {
-                    left_rotate (parent);
-                    parent = new_node;
-                }
-
-                /* If grandparent is root and colored red inside recolor_parent_grandparent,
-                 * rotation will put parent (that is black) in place of root */
-                right_rotate (recolor_parent_grandparent (parent));
-                break;
-            }
-        }
-        else
-        {
-            auto uncle = parent->get_parent()->get_left();
-
-            if (is_red (uncle))
-                new_node = recolor_parent_grandparent_uncle (parent, uncle, root);
-            else
-            {
-                if (is_left_child (new_node))
-                {
-                    right_rotate (parent);
-                    parent = new_node;
-                }
-
-                left_rotate (recolor_parent_grandparent (parent));
-                break;
-            }
-        }
-
-        parent = new_node->parent_unsafe();
-    }
-}
-
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ ERASURE FIXUP ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-
-template<typename Node_T, typename Rotor>
-Node_T *recolor_parent_sibling_and_rotate (Node_T *sibling_of_y, Rotor rotate)
-{
-    using color_type = typename Node_T::color_type;
-
-    assert (sibling_of_y);
+template<typename Compare, typename Lhs, typename Rhs>
+concept three_way_comparator =
+    has_compare_member<Compare, Lhs, Rhs> ||
+    (is_std_less<Compare> && std::three_way_comparable_with<Lhs, Rhs> &&
+     !(std::is_pointer_v<std::decay_t<Lhs>> && std::is_pointer_v<std::decay_t<Rhs>>));
 
-    auto parent_of_y = sibling_of_y->parent_unsafe();
-
-    sibling_of_y->color_ = color_type::black;
-    parent_of_y->color_ = color_type::red;
-    rotate (parent_of_y);
-
-    return parent_of_y;
-}
-
-template<typename Node_T, typename Rotor>
-Node_T *recolor_parent_sibling_nephew (Node_T *sibling_of_y, Node_T *l_nephew_of_y,
-                                       Node_T *r_nephew_of_y, Rotor l_rotate)
+// The result is compared with 0: less than 0 if lhs < rhs, 0 if they are equivalent
+template<typename Compare, typename Lhs, typename Rhs>
+auto three_way (const Compare &comp, const Lhs &lhs, const Rhs &rhs)
 {
-    using color_type = typename Node_T::color_type;
-
-    assert (sibling_of_y);
-    assert (l_nephew_of_y == sibling_of_y->get_left() ||
-            l_nephew_of_y == sibling_of_y->get_right());
-    assert (r_nephew_of_y == sibling_of_y->get_left() ||
-            r_nephew_of_y == sibling_of_y->get_right());
-    assert (is_red (l_nephew_of_y) || is_red (r_nephew_of_y));
-
-    if (is_red (l_nephew_of_y))
-        l_nephew_of_y->color_ = color_type::black;
+    if constexpr (has_compare_member<Compare, Lhs, Rhs>)
+        return comp.compare (lhs, rhs);
+    else if constexpr (three_way_comparator<Compare, Lhs, Rhs>)
+        return lhs <=> rhs;
+    else if (comp (lhs, rhs))
+        return std::weak_ordering::less;
     else
-    {
-        // is_red (r_nephew_of_y) ==> r_nephew_of_y != nullptr
-        r_nephew_of_y->color_ = color_type::black;
-        sibling_of_y->color_ = color_type::red;
-
-        l_rotate (sibling_of_y);
-
-        sibling_of_y = r_nephew_of_y;
-    }
-
-    auto parent_of_y = sibling_of_y->parent_unsafe();
-    sibling_of_y->color_ = std::exchange (parent_of_y->color_, color_type::black);
-
-    return parent_of_y;
-}
-
-template<typename Node_T>
-bool recolor_parent_sibling (Node_T *root, Node_T *sibling_of_y) noexcept
-{
-    using color_type = typename Node_T::color_type;
-
-    assert (sibling_of_y);
-
-    sibling_of_y->color_ = color_type::red;
-
-    auto parent_of_y = sibling_of_y->parent_unsafe();
-    if (parent_of_y == root || parent_of_y->color_ == color_type::red)
-    {
-        parent_of_y->color_ = color_type::black;
-        return true;
-    }
-
-    return false;
-}
-
-template<typename Node_T>
-void rb_erase_fixup (Node_T *root, Node_T *sibling_of_y)
-{
-    using color_type = typename Node_T::color_type;
-
-    assert (sibling_of_y);
-
-    auto l_rotate = [](Node_T *node){ left_rotate (node); };
-    auto r_rotate = [](Node_T *node){ right_rotate (node); };
-
-    while (true)
-    {
-        if (is_left_child (sibling_of_y))
-        {
-            if (sibling_of_y->color_ == color_type::red)
-            {
-                auto parent_of_y = recolor_parent_sibling_and_rotate (sibling_of_y, r_rotate);
-
-                if (root == parent_of_y)
-                    root = sibling_of_y;
-
-                sibling_of_y = parent_of_y->get_left();
-            }
-
-            auto l_nephew_of_y = sibling_of_y->get_left();
-            auto r_nephew_of_y = sibling_of_y->get_right();
-            if (is_red (l_nephew_of_y) || is_red (r_nephew_of_y))
-            {
-                right_rotate (recolor_parent_sibling_nephew (sibling_of_y, l_nephew_of_y,
-                                                             r_nephew_of_y, l_rotate));
-                break;
-            }
-        }
-        else
-        {
-            if (sibling_of_y->color_ == color_type::red)
-            {
-                auto parent_of_y = recolor_parent_sibling_and_rotate (sibling_of_y, l_rotate);
-
-                if (root == parent_of_y)
-                    root = sibling_of_y;
-
-                sibling_of_y = parent_of_y->get_right();
-            }
-
-            auto l_nephew_of_y = sibling_of_y->get_left();
-            auto r_nephew_of_y = sibling_of_y->get_right();
-            if (is_red (l_nephew_of_y) || is_red (r_nephew_of_y))
-            {
-                left_rotate (recolor_parent_sibling_nephew (sibling_of_y, r_nephew_of_y,
-                                                            l_nephew_of_y, r_rotate));
-                break;
-            }
-        }
-
-        if (recolor_parent_sibling (root, sibling_of_y))
-            break;
-
-        auto parent_of_y = sibling_of_y->parent_unsafe();
-
-        if (is_left_child (parent_of_y))
-            sibling_of_y = parent_of_y->parent_unsafe()->get_right();
-        else
-            sibling_of_y = parent_of_y->get_parent()->get_left();
-    }
+        return comp (rhs, lhs) ? std::weak_ordering::greater : std::weak_ordering::equivalent;
 }
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ ERASURE ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -315,9 +127,9 @@ std::pair<Node_T *, Node_T *> get_y_and_its_child (Node_T *z) noexcept
     return std::pair{y, child_of_y};
 }
 
+// Returns the sibling of y. Sizes of subtrees are left for recount_path()
 template<typename Node_T>
-auto child_of_y_substitutes_y (Node_T *&root, Node_T *y, Node_T *child_of_y) noexcept
--> std::pair<Node_T *, typename Node_T::size_type>
+Node_T *child_of_y_substitutes_y (Node_T *&root, Node_T *y, Node_T *child_of_y) noexcept
 {
     assert (y);
     assert (child_of_y == y->get_left() || child_of_y == y->get_right());
@@ -354,37 +166,15 @@ auto child_of_y_substitutes_y (Node_T *&root, Node_T *y, Node_T *child_of_y) noe
         sibling_of_y = yp->get_left();
     }
 
-    auto decrement = y->subtree_size_;
     if (child_of_y)
-    {
         child_of_y->set_parent (y->get_parent());
-        decrement -= child_of_y->subtree_size_;
-    }
-
-    y->get_parent()->subtree_size_ -= decrement;
-
-    return std::pair{sibling_of_y, decrement};
-}
-
-// Order of y and z is significant. This function mustn't be called with arbitrary pointers
-template<typename Node_T>
-void decrement_subtee_hights_from_y_to_z (Node_T *y, Node_T *z,
-                                          typename Node_T::size_type decrement) noexcept
-{
-    assert (y);
-
-    // y->parent_->subtree_hight_ has already been changed in child_of_y_substitutes_y()
 
-    if (auto yp = y->parent_unsafe(); yp != z)
-    {
-        for (auto ypp = yp->parent_unsafe(); ypp != z; ypp = ypp->parent_unsafe())
-            ypp->subtree_size_ -= decrement;
-    }
+    return sibling_of_y;
 }
 
 // Order of y and z is significant. This function mustn't be called with arbitrary pointers
 template<typename Node_T>
-void y_substitutes_z (Node_T *y, Node_T *z, typename Node_T::size_type z_size) noexcept
+void y_substitutes_z (Node_T *y, Node_T *z) noexcept
 {
     assert (y);
     assert (z);
@@ -397,116 +187,250 @@ void y_substitutes_z (Node_T *y, Node_T *z, typename Node_T::size_type z_size) n
 
     // We are sure that zl != nullptr because of STATEMENT (*)
     zl->set_parent (y);
-    y->subtree_size_ = zl->subtree_size_ + 1;
 
     if (zr) // We are NOT sure that zr != nullptr because of STATEMENT (**)
-    {
         zr->set_parent (y);
-        y->subtree_size_ += zr->subtree_size_;
-    }
 
-    y->color_ = z->color_;
+    y->set_color (z->get_color());
 
     if (is_left_child (z))
-    {
-        auto zp = z->get_parent();
-        zp->set_left (y);
-        zp->subtree_size_ += (y->subtree_size_ - z_size);
-    }
+        z->get_parent()->set_left (y);
     else
-    {
-        auto zp = z->parent_unsafe();
-        zp->set_right (y);
-        zp->subtree_size_ += (y->subtree_size_ - z_size);
-    }
+        z->parent_unsafe()->set_right (y);
 
     y->set_parent (z->get_parent());
 }
 
+/*
+ * Relinking in erase_impl() changes subtrees of the nodes on the path from the lowest changed
+ * node up to the root only. Their sizes and aggregates are recounted from children in one pass
+ */
 template<typename Node_T, typename End_Node_T>
-void decrement_subtree_hights_upper_z (Node_T *z, End_Node_T *end_node) noexcept
+void recount_path (End_Node_T *node, End_Node_T *end_node) noexcept
 {
-    assert (z);
     assert (end_node);
-    assert (z->get_parent() != end_node);
-
-    /*
-     * if (y == z), then z->parent_->subtree_hight_ has already been changed
-     * in child_of_y_substitutes_y()
-     *
-     * if (y != z), then z->parent_->subtree_hight_ has already been changed
-     * in y_substitutes_z()
-     */
 
-    auto zpp = z->parent_unsafe()->get_parent();
-    while (zpp != end_node)
+    while (node != end_node)
     {
-        zpp->subtree_size_--;
-        zpp = static_cast<Node_T *>(zpp)->get_parent();
+        auto node_ = static_cast<Node_T *>(node);
+
+        node_->subtree_size_ = 1 + Node_T::size (node_->get_left())
+                                 + Node_T::size (node_->get_right());
+        node_->update_aggregate();
+
+        node = node_->get_parent();
     }
+
     end_node->subtree_size_--;
 }
 
-template<typename Node_T>
+template<typename Balance_T, typename Node_T>
 void erase_impl (Node_T *root, Node_T *z)
 {
-    using color_type = typename Node_T::color_type;
-    using size_type = typename Node_T::size_type;
-
     assert (root);
     assert (z);
 
-    auto [y, child_of_y] = get_y_and_its_child (z);
-
     // child_of_y_substitutes_y() may change root, so we save a pointer to end_node
-    // child_of_y_substitutes_y() may change z->subtree_size_, so we save it
     auto end_node = root->get_parent();
-    auto z_size = z->subtree_size_;
 
-    auto [sibling_of_y, decrement] = child_of_y_substitutes_y (root, y, child_of_y);
+    // The policy may rotate z down first; rotations may change root as well
+    Balance_T::erase_prepare (z);
+    root = end_node->get_left();
+
+    auto [y, child_of_y] = get_y_and_its_child (z);
+
+    // The lowest node which subtree loses a node: y takes place of z if y was z's child
+    auto lowest_changed = (y->get_parent() == z) ? static_cast<decltype (end_node)>(y)
+                                                 : y->get_parent();
 
-    // y_substitutes_z() changes y->color_, so we save it
-    auto y_original_color = y->color_;
+    auto is_left = is_left_child (y);
+    auto sibling_of_y = child_of_y_substitutes_y (root, y, child_of_y);
+
+    // y_substitutes_z() changes color of y, so we save it
+    auto y_original_color = y->get_color();
 
     if (y != z)
     {
-        decrement_subtee_hights_from_y_to_z (y, z, decrement);
-        y_substitutes_z (y, z, z_size);
+        y_substitutes_z (y, z);
 
         if (z == root)
             root = y;
     }
 
-    if (z->get_parent() != end_node)
-        decrement_subtree_hights_upper_z (z, end_node);
+    // Sizes and aggregates are restored before the fixup as rotations rely on those of children
+    recount_path<Node_T>(lowest_changed, end_node);
+
+    Balance_T::erase_fixup (Removal<Node_T>{root, z, y, child_of_y, sibling_of_y, lowest_changed,
+                                            is_left, y_original_color});
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ SPLIT AND JOIN ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// Detached subtrees (see Subtree in balancing.hpp) are joined by their balancing policy
+template<typename Node_T, typename Balance_T>
+Subtree<Node_T, Balance_T> join (Subtree<Node_T, Balance_T> left, Node_T *pivot,
+                                 Subtree<Node_T, Balance_T> right) noexcept
+{
+    return Balance_T::join (left, pivot, right);
+}
+
+// Makes a child of the root of tree the root of a detached subtree of its own
+template<typename Node_T, typename Balance_T>
+Subtree<Node_T, Balance_T> detach_child (Subtree<Node_T, Balance_T> tree, Node_T *child) noexcept
+{
+    return {child, Balance_T::detach_child (child, tree.rank)};
+}
+
+// Joins two trees without a pivot: the greatest node of left is cut out and used as one
+template<typename Node_T, typename Balance_T>
+Subtree<Node_T, Balance_T> join (Subtree<Node_T, Balance_T> left,
+                                 Subtree<Node_T, Balance_T> right) noexcept
+{
+    if (left.root == nullptr)
+        return right;
+    if (right.root == nullptr)
+        return left;
+
+    typename Node_T::end_node_type sentinel{};
+    sentinel.set_left (left.root);
+    sentinel.subtree_size_ = left.root->subtree_size_ + 1;
+    left.root->set_parent (std::addressof (sentinel));
+
+    auto pivot = maximum (left.root);
+    erase_impl<Balance_T>(left.root, pivot);
+
+    left.root = sentinel.get_left();
+    if (left.root)
+        left.root->set_parent (nullptr);
+    left.rank = Balance_T::rank (left.root);
+
+    return join (left, pivot, right);
+}
+
+template<typename Node_T, typename Balance_T>
+struct Split_Result
+{
+    Subtree<Node_T, Balance_T> less;
+    Node_T *equal = nullptr;
+    Subtree<Node_T, Balance_T> greater;
+};
+
+/*
+ * Splits a subtree into nodes with keys less than key, the node with key equal to it (if any)
+ * and nodes with keys greater than it. Every level of recursion joins the subtree that doesn't
+ * contain key with the result of the previous one. Ranks of the joined trees grow along the
+ * way, so joins take O(log n) time in total.
+ */
+template<typename Node_T, typename Balance_T, typename Key_T, typename Compare>
+Split_Result<Node_T, Balance_T> split (Subtree<Node_T, Balance_T> tree, const Key_T &key,
+                                       const Compare &comp)
+{
+    auto root = tree.root;
+    if (root == nullptr)
+        return {};
+
+    auto left = detach_child (tree, root->get_left());
+    auto right = detach_child (tree, root->get_right());
+
+    if (comp (key, root->key()))
+    {
+        auto result = split (left, key, comp);
+        result.greater = join (result.greater, root, right);
+
+        return result;
+    }
+    else if (comp (root->key(), key))
+    {
+        auto result = split (right, key, comp);
+        result.less = join (left, root, result.less);
+
+        return result;
+    }
+    else
+    {
+        root->set_left (nullptr);
+        root->set_right (nullptr);
+        root->subtree_size_ = 1;
+        root->update_aggregate();
+
+        return {left, root, right};
+    }
+}
+
+// Splits a subtree into k smallest nodes and the rest
+template<typename Node_T, typename Balance_T>
+std::pair<Subtree<Node_T, Balance_T>, Subtree<Node_T, Balance_T>> split_at_rank (
+    Subtree<Node_T, Balance_T> tree, std::size_t k)
+{
+    auto root = tree.root;
+    if (root == nullptr)
+        return {};
+
+    auto left_size = Node_T::size (root->get_left());
 
-    if (y_original_color == color_type::black && root)
+    auto left = detach_child (tree, root->get_left());
+    auto right = detach_child (tree, root->get_right());
+
+    if (k <= left_size)
     {
-        if (child_of_y)
-            child_of_y->color_ = color_type::black;
-        else
-            rb_erase_fixup (root, sibling_of_y);
+        auto [less, greater] = split_at_rank (left, k);
+        return {less, join (greater, root, right)};
+    }
+    else
+    {
+        auto [less, greater] = split_at_rank (right, k - left_size - 1);
+        return {join (left, root, less), greater};
     }
 }
 
+// Implementation of set operations from set_algebra.hpp
+struct Set_Algebra;
+
+// Comparators that can compare keys with values of other types
+template<typename Compare>
+concept transparent_compare = requires { typename Compare::is_transparent; };
+
+
 } // namespace detail
 
-template <typename Key_T, typename Compare = std::less<Key_T>>
+// Key-value map built on ARB_Tree (see arb_map.hpp)
+template<typename Key_T, typename T, typename Compare, typename Allocator>
+class ARB_Map;
+
+// Read-only contiguous copy of ARB_Tree (see frozen_tree.hpp)
+template<typename Key_T, typename Compare>
+class Frozen_ARB_Tree;
+
+/*
+ * If Unique_Keys is false, the tree is a multiset: equivalent keys are kept in the order of
+ * insertion, insert() returns an iterator as in std::multiset and every rank query counts
+ * all copies of a key. Balance_T is a balancing policy from balancing.hpp
+ */
+template <typename Key_T, typename Compare = std::less<Key_T>,
+          typename Allocator = std::allocator<Key_T>, typename Node_T = ARB_Node<Key_T>,
+          bool Unique_Keys = true, typename Balance_T = Red_Black_Balance>
 class ARB_Tree final
 {
+    static_assert (std::is_same_v<typename Node_T::key_type, Key_T>,
+                   "Node_T has to store keys of type Key_T");
+
 public:
 
     using key_type = Key_T;
     using key_compare = Compare;
     using value_type = key_type;
     using value_compare = Compare;
-    using pointer = value_type *;
-    using const_pointer = const value_type *;
+    using allocator_type = Allocator;
+    using pointer = typename std::allocator_traits<allocator_type>::pointer;
+    using const_pointer = typename std::allocator_traits<allocator_type>::const_pointer;
     using reference = value_type &;
     using const_reference = const value_type &;
     using size_type = std::size_t;
     using difference_type = std::ptrdiff_t;
-    using node_type = ARB_Node<key_type>;
+    using node_type = Node_T;
+    using balance_type = Balance_T;
+    using augmentation_type = typename node_type::augmentation_type;
+    using aggregate_type = typename node_type::aggregate_type;
     using iterator = tree_iterator<node_type>;
     using const_iterator = iterator;
     using reverse_iterator = std::reverse_iterator<iterator>;
@@ -517,33 +441,127 @@ private:
     using color_type = typename node_type::color_type;
     using node_ptr = node_type *;
     using const_node_ptr = const node_type *;
-    using end_node_type = End_Node<node_type>;
+    using end_node_type = typename node_type::end_node_type;
     using end_node_ptr = end_node_type *;
     using const_end_node_ptr = const end_node_type *;
+    using subtree_type = detail::Subtree<node_type, Balance_T>;
+
+    friend struct detail::Set_Algebra;
+
+    template<typename key_t, typename t, typename compare, typename allocator>
+    friend class ARB_Map;
+
+    using node_allocator_type =
+        typename std::allocator_traits<allocator_type>::template rebind_alloc<node_type>;
+    using node_alloc_traits = std::allocator_traits<node_allocator_type>;
 
     struct Root_Wrapper
     {
         end_node_type end_node_{};
+        [[no_unique_address]] node_allocator_type alloc_;
+
+        Root_Wrapper () { end_node_.set_rightmost (nullptr); }
 
-        Root_Wrapper () = default;
+        explicit Root_Wrapper (const node_allocator_type &alloc) : alloc_{alloc}
+        {
+            end_node_.set_rightmost (nullptr);
+        }
 
         Root_Wrapper (Root_Wrapper &&rhs) = default;
-        Root_Wrapper &operator= (Root_Wrapper &&rhs) = default;
+
+        // Allocators are swapped only if they propagate on swap. Otherwise they are
+        // required to compare equal, so nodes of one tree can be freed by the other
+        void swap (Root_Wrapper &rhs) noexcept
+        {
+            std::swap (end_node_, rhs.end_node_);
+
+            if constexpr (node_alloc_traits::propagate_on_container_swap::value)
+            {
+                using std::swap;
+                swap (alloc_, rhs.alloc_);
+            }
+            else
+                assert (alloc_ == rhs.alloc_);
+        }
 
         void set_default ()
         {
             set_root (nullptr);
+            end_node_.set_rightmost (nullptr);
             end_node_.subtree_size_ = 1;
         }
 
+        template<typename... Args>
+        node_ptr create_node (Args &&... args)
+        {
+            auto node = std::to_address (node_alloc_traits::allocate (alloc_, 1));
+
+            try
+            {
+                node_alloc_traits::construct (alloc_, node, std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                node_alloc_traits::deallocate (alloc_, node, 1);
+                throw;
+            }
+
+            return node;
+        }
+
+        void destroy_node (node_ptr node) noexcept
+        {
+            node_alloc_traits::destroy (alloc_, node);
+            node_alloc_traits::deallocate (alloc_, node, 1);
+        }
+
         void clean_up ()
         {
-            for (node_ptr node = get_root(), save{}; node != nullptr; node = save)
+            if constexpr (detail::bulk_releasable<node_allocator_type> &&
+                          std::is_trivially_destructible_v<node_type>)
+            {
+                // Nodes own nothing but trivially destructible keys and aggregates, so their
+                // storage may be reused without calling destructors
+                if (get_root() && alloc_.release_exclusive())
+                    return;
+            }
+
+            destroy_subtree (get_root());
+        }
+
+        // Destroys the old key of a node and constructs a new one in the same storage
+        template<typename... Args>
+        void reconstruct_node (node_ptr node, Args &&... args)
+        {
+            node_alloc_traits::destroy (alloc_, node);
+
+            try
+            {
+                node_alloc_traits::construct (alloc_, node, std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                node_alloc_traits::deallocate (alloc_, node, 1);
+                throw;
+            }
+        }
+
+        void destroy_subtree (node_ptr root) noexcept
+        {
+            dismantle (root, [this](node_ptr node){ destroy_node (node); });
+        }
+
+        // Calls action for every node of the subtree. A node is detached by that time,
+        // so action may destroy or reuse it
+        template<typename Action>
+        static void dismantle (node_ptr root, Action action)
+        {
+            for (node_ptr node = root, save{}; node != nullptr; node = save)
             {
                 if (node->get_left() == nullptr)
                 {
                     save = node->get_right();
-                    delete node;
+                    action (node);
                 }
                 else
                 {
@@ -562,6 +580,10 @@ private:
         node_ptr get_root () noexcept { return end_node_.get_left(); }
         const_node_ptr get_root () const noexcept { return end_node_.get_left(); }
         void set_root (node_ptr root) noexcept { return end_node_.set_left (root); }
+
+        node_ptr get_rightmost () noexcept { return end_node_.get_rightmost(); }
+        const_node_ptr get_rightmost () const noexcept { return end_node_.get_rightmost(); }
+        void set_rightmost (node_ptr node) noexcept { end_node_.set_rightmost (node); }
     };
 
     Root_Wrapper top_node_{};
@@ -570,32 +592,183 @@ private:
 
 public:
 
-    ARB_Tree () : ARB_Tree{key_compare{}} {}
-
-    explicit ARB_Tree (const key_compare &comp) : comp_{comp} {}
-
-    template<std::input_iterator it>
-    ARB_Tree (it first, it last, const key_compare &comp = key_compare{}) : comp_{comp}
+    // Owns a node extracted from a tree. The node can be inserted into any tree with an equal
+    // allocator without reallocation
+    class node_handle final
     {
-        insert (first, last);
-    }
+        node_ptr node_ = nullptr;
+        std::optional<node_allocator_type> alloc_;
 
-    ARB_Tree (std::initializer_list<value_type> ilist, const key_compare &comp = key_compare{})
-            : comp_{comp}
-    {
-        insert (ilist);
-    }
+        friend class ARB_Tree;
 
-    ARB_Tree (const ARB_Tree &rhs) : comp_{rhs.comp_}
+        node_handle (node_ptr node, const node_allocator_type &alloc)
+                    : node_{node}, alloc_{alloc} {}
+
+        node_ptr release () noexcept
+        {
+            alloc_.reset();
+            return std::exchange (node_, nullptr);
+        }
+
+        void destroy_node () noexcept
+        {
+            if (node_)
+            {
+                node_alloc_traits::destroy (*alloc_, node_);
+                node_alloc_traits::deallocate (*alloc_, node_, 1);
+            }
+        }
+
+        // Allocators such as std::pmr::polymorphic_allocator are neither assignable nor
+        // swappable, so they are moved by re-construction; from is left empty
+        static void move_allocator (std::optional<node_allocator_type> &to,
+                                    std::optional<node_allocator_type> &from) noexcept
+        {
+            to.reset();
+            if (from)
+                to.emplace (std::move (*from));
+            from.reset();
+        }
+
+    public:
+
+        using key_type = Key_T;
+        using value_type = Key_T;
+        using allocator_type = Allocator;
+
+        node_handle () noexcept = default;
+
+        node_handle (node_handle &&rhs) noexcept
+                    : node_{std::exchange (rhs.node_, nullptr)}, alloc_{std::move (rhs.alloc_)}
+        {
+            rhs.alloc_.reset();
+        }
+
+        // The node held before is destroyed; rhs is left empty
+        node_handle &operator= (node_handle &&rhs) noexcept
+        {
+            if (this != std::addressof (rhs))
+            {
+                destroy_node();
+                node_ = std::exchange (rhs.node_, nullptr);
+
+                move_allocator (alloc_, rhs.alloc_);
+            }
+
+            return *this;
+        }
+
+        ~node_handle () { destroy_node(); }
+
+        bool empty () const noexcept { return node_ == nullptr; }
+        explicit operator bool () const noexcept { return !empty(); }
+
+        allocator_type get_allocator () const { return allocator_type{*alloc_}; }
+
+        // The key may be changed before the node is inserted into a tree again
+        value_type &value () const
+        {
+            assert (!empty());
+            return node_->key();
+        }
+
+        void swap (node_handle &other) noexcept
+        {
+            std::swap (node_, other.node_);
+
+            std::optional<node_allocator_type> tmp;
+            move_allocator (tmp, alloc_);
+            move_allocator (alloc_, other.alloc_);
+            move_allocator (other.alloc_, tmp);
+        }
+
+        friend void swap (node_handle &lhs, node_handle &rhs) noexcept { lhs.swap (rhs); }
+    };
+
+    struct insert_return_type
+    {
+        iterator position;
+        bool inserted;
+        node_handle node;
+    };
+
+private:
+
+    // Multisets return just an iterator as insertion always succeeds
+    using key_insert_result = std::conditional_t<Unique_Keys, std::pair<iterator, bool>, iterator>;
+    using node_insert_result = std::conditional_t<Unique_Keys, insert_return_type, iterator>;
+
+    // The node with a key equivalent to the new one (only in trees with unique keys) or nullptr.
+    // In the latter case the new node becomes the left or the right child of parent. If counted,
+    // the new key is already included in sizes of subtrees of parent and its ancestors
+    struct Insert_Position
+    {
+        node_ptr node;
+        end_node_ptr parent;
+        bool as_left;
+        bool counted = false;
+    };
+
+public:
+
+    ARB_Tree () : ARB_Tree{key_compare{}} {}
+
+    explicit ARB_Tree (const key_compare &comp, const allocator_type &alloc = allocator_type{})
+                      : top_node_{node_allocator_type{alloc}}, comp_{comp} {}
+
+    explicit ARB_Tree (const allocator_type &alloc) : ARB_Tree{key_compare{}, alloc} {}
+
+    template<std::input_iterator it>
+    ARB_Tree (it first, it last, const key_compare &comp = key_compare{},
+              const allocator_type &alloc = allocator_type{})
+             : ARB_Tree{comp, alloc}
+    {
+        insert (first, last);
+    }
+
+    template<std::input_iterator it>
+    ARB_Tree (it first, it last, const allocator_type &alloc)
+             : ARB_Tree{first, last, key_compare{}, alloc} {}
+
+    ARB_Tree (std::initializer_list<value_type> ilist, const key_compare &comp = key_compare{},
+              const allocator_type &alloc = allocator_type{})
+             : ARB_Tree{comp, alloc}
+    {
+        insert (ilist);
+    }
+
+    ARB_Tree (std::initializer_list<value_type> ilist, const allocator_type &alloc)
+             : ARB_Tree{ilist, key_compare{}, alloc} {}
+
+    ARB_Tree (const ARB_Tree &rhs)
+             : ARB_Tree{rhs, node_alloc_traits::select_on_container_copy_construction (
+                                 rhs.top_node_.alloc_)} {}
+
+    ARB_Tree (const ARB_Tree &rhs, const allocator_type &alloc) : ARB_Tree{rhs.comp_, alloc}
     {
-        for (auto &&key : rhs)
-            insert_unique (key);
+        clone_from (rhs, [this]<typename... Args>(Args &&... args)
+        {
+            return top_node_.create_node (std::forward<Args>(args)...);
+        });
     }
 
+    // Nodes of *this are reused for keys of rhs when possible
     ARB_Tree &operator= (const ARB_Tree &rhs)
     {
-        auto tmp_tree{rhs};
-        std::swap (*this, tmp_tree);
+        if (this == std::addressof (rhs))
+            return *this;
+
+        if constexpr (node_alloc_traits::propagate_on_container_copy_assignment::value)
+        {
+            if (top_node_.alloc_ != rhs.top_node_.alloc_)
+                clear();
+
+            top_node_.alloc_ = rhs.top_node_.alloc_;
+        }
+
+        Node_Recycler recycler{top_node_, detach_nodes()};
+        comp_ = rhs.comp_;
+        clone_from (rhs, recycler);
 
         return *this;
     }
@@ -608,19 +781,53 @@ public:
         set_leftmost_or_parent_of_root();
     }
 
-    ARB_Tree &operator= (ARB_Tree &&rhs) noexcept (std::is_nothrow_swappable_v<key_compare> &&
-                                                   std::is_nothrow_swappable_v<end_node_type>)
+    ARB_Tree (ARB_Tree &&rhs, const allocator_type &alloc) : ARB_Tree{rhs.comp_, alloc}
     {
-        swap (rhs);
-        set_leftmost_or_parent_of_root();
+        if (top_node_.alloc_ == rhs.top_node_.alloc_)
+            swap_contents (rhs);
+        else
+            move_elements_from (rhs);
+    }
+
+    ARB_Tree &operator= (ARB_Tree &&rhs) noexcept (node_alloc_traits::is_always_equal::value &&
+                                                   std::is_nothrow_swappable_v<key_compare>)
+    {
+        if constexpr (node_alloc_traits::propagate_on_container_move_assignment::value)
+        {
+            swap_contents (rhs);
+
+            using std::swap;
+            swap (top_node_.alloc_, rhs.top_node_.alloc_);
+        }
+        else if (top_node_.alloc_ == rhs.top_node_.alloc_)
+            swap_contents (rhs);
+        else
+        {
+            clear();
+            comp_ = rhs.comp_;
+            move_elements_from (rhs);
+        }
 
         return *this;
     }
 
     ~ARB_Tree () = default;
 
+    // Builds a tree in O(n) time. Keys in [first, last) have to be sorted (and unique for sets)
+    template<std::forward_iterator it>
+    static ARB_Tree from_sorted (it first, it last, const key_compare &comp = key_compare{},
+                                 const allocator_type &alloc = allocator_type{})
+    {
+        ARB_Tree tree{comp, alloc};
+        tree.build_from_sorted<false>(first, last, std::distance (first, last));
+
+        return tree;
+    }
+
     // Observers
 
+    allocator_type get_allocator () const noexcept { return allocator_type{top_node_.alloc_}; }
+
     const key_compare &key_comp () const { return comp_; }
 
     const value_compare &value_comp () const { return key_comp(); }
@@ -630,6 +837,18 @@ public:
     size_type size () const noexcept { return top_node_.get_end_node()->subtree_size_ - 1; }
     bool empty () const noexcept { return size() == 0; }
 
+    size_type max_size () const noexcept
+    {
+        // The end node counts itself in its subtree size
+        using node_size_type = typename node_type::size_type;
+        constexpr size_type size_limit = std::numeric_limits<node_size_type>::max() - 1;
+
+        return std::min<size_type>(node_alloc_traits::max_size (top_node_.alloc_), size_limit);
+    }
+
+    // The number of nodes on the longest path from the root down. Takes O(n) time
+    size_type height () const noexcept { return detail::height (top_node_.get_root()); }
+
     // Iterators
 
     const_iterator begin () const noexcept { return const_iterator{leftmost_}; }
@@ -645,49 +864,1138 @@ public:
 
     // Modifiers
 
-    void swap (ARB_Tree &other) noexcept (std::is_nothrow_swappable_v<key_compare> &&
-                                          std::is_nothrow_swappable_v<end_node_type>)
-    {
-        std::swap (top_node_, other.top_node_);
-        std::swap (leftmost_, other.leftmost_);
-        std::swap (comp_, other.comp_);
+    void swap (ARB_Tree &other) noexcept (std::is_nothrow_swappable_v<key_compare>)
+    {
+        top_node_.swap (other.top_node_);
+        std::swap (leftmost_, other.leftmost_);
+        std::swap (comp_, other.comp_);
+
+        set_leftmost_or_parent_of_root();
+        other.set_leftmost_or_parent_of_root();
+    }
+
+    void clear ()
+    {
+        top_node_.clean_up();
+        top_node_.set_default();
+
+        leftmost_ = top_node_.get_end_node();
+    }
+
+    key_insert_result insert (const key_type &key) { return insert_result (insert_key (key)); }
+
+    key_insert_result insert (key_type &&key)
+    {
+        return insert_result (insert_key (std::move (key)));
+    }
+
+    // Inserts key as close as possible to the position just prior to hint. If key belongs right
+    // before or right after hint, the position is found in amortized O(1) time
+    iterator insert (const_iterator hint, const key_type &key) { return insert_key (hint, key); }
+
+    iterator insert (const_iterator hint, key_type &&key)
+    {
+        return insert_key (hint, std::move (key));
+    }
+
+    // Same as insert (key) but also returns the number of keys before the inserted one
+    // (or the found one). The bool is always true for multisets
+    std::tuple<iterator, bool, size_type> insert_with_rank (const key_type &key)
+    {
+        return insert_key_with_rank (key);
+    }
+
+    std::tuple<iterator, bool, size_type> insert_with_rank (key_type &&key)
+    {
+        return insert_key_with_rank (std::move (key));
+    }
+
+    // Constructs a key from args. The node is destroyed if the key is already in the tree
+    template<typename... Args>
+    key_insert_result emplace (Args &&... args)
+    {
+        auto new_node = make_node (std::in_place, color_type::red, std::forward<Args>(args)...);
+
+        return insert_result (insert_constructed (new_node, [this](const key_type &key)
+        {
+            return find_and_count_position_to_insert (key);
+        }));
+    }
+
+    template<typename... Args>
+    iterator emplace_hint (const_iterator hint, Args &&... args)
+    {
+        auto new_node = make_node (std::in_place, color_type::red, std::forward<Args>(args)...);
+
+        return insert_constructed (new_node, [this, hint](const key_type &key)
+        {
+            return find_position_to_insert (hint, key);
+        }).first;
+    }
+
+    // Sorted ranges are inserted into an empty tree in O(n) time
+    template<std::input_iterator it>
+    void insert (it first, it last)
+    {
+        if constexpr (std::forward_iterator<it>)
+        {
+            if (empty())
+            {
+                if (auto n_keys = n_keys_if_sorted (first, last))
+                {
+                    build_from_sorted<Unique_Keys>(first, last, *n_keys);
+                    return;
+                }
+            }
+        }
+
+        for (; first != last; ++first)
+            insert_one (*first);
+    }
+
+    void insert (std::initializer_list<value_type> ilist) { insert (ilist.begin(), ilist.end()); }
+
+    iterator erase (iterator pos)
+    {
+        auto node = unlink_node (pos);
+        top_node_.destroy_node (node);
+
+        return pos;
+    }
+
+    size_type erase (const key_type &key) { return erase_key (key); }
+
+    // Same as erase (key) but also returns the number of keys less than key
+    std::pair<size_type, size_type> erase_with_rank (const key_type &key)
+    {
+        if constexpr (!Unique_Keys)
+        {
+            auto [first, rank] = lower_bound_with_rank (key);
+            return std::pair{erase_equivalent (first, key), rank};
+        }
+        else
+        {
+            auto [position, rank] = find_position_with_rank (key);
+            if (position.node == nullptr)
+                return std::pair{size_type{0}, rank};
+
+            erase (iterator{position.node});
+            return std::pair{size_type{1}, rank};
+        }
+    }
+
+    template<typename K>
+    requires detail::transparent_compare<key_compare> && (!std::is_convertible_v<K, iterator>)
+    size_type erase (const K &key) { return erase_key (key); }
+
+    // Node handles. Allocators of trees that exchange nodes have to compare equal
+
+    node_handle extract (const_iterator pos)
+    {
+        auto node = unlink_node (pos);
+        return node_handle{node, top_node_.alloc_};
+    }
+
+    node_handle extract (const key_type &key)
+    {
+        auto it = find (key);
+        return (it == end()) ? node_handle{} : extract (it);
+    }
+
+    // If the key is already in the tree, the node stays in the handle
+    node_insert_result insert (node_handle &&handle)
+    {
+        if (handle.empty())
+        {
+            if constexpr (Unique_Keys)
+                return node_insert_result{end(), false, node_handle{}};
+            else
+                return end();
+        }
+
+        assert (*handle.alloc_ == top_node_.alloc_);
+
+        auto position = find_position_to_insert (handle.node_->key());
+        if constexpr (Unique_Keys)
+        {
+            if (position.node)
+                return {iterator{position.node}, false, std::move (handle)};
+        }
+
+        ensure_capacity();
+
+        auto new_node = handle.release();
+        link_new_node (new_node, position);
+
+        if constexpr (Unique_Keys)
+            return {iterator{new_node}, true, node_handle{}};
+        else
+            return iterator{new_node};
+    }
+
+    iterator insert (const_iterator hint, node_handle &&handle)
+    {
+        if (handle.empty())
+            return end();
+
+        assert (*handle.alloc_ == top_node_.alloc_);
+
+        auto position = find_position_to_insert (hint, handle.node_->key());
+        if (position.node)
+            return iterator{position.node};
+
+        ensure_capacity();
+
+        auto new_node = handle.release();
+        link_new_node (new_node, position);
+
+        return iterator{new_node};
+    }
+
+    // Moves nodes with keys that aren't in *this (all nodes for multisets) from source without
+    // reallocation
+    void merge (ARB_Tree &source)
+    {
+        assert (top_node_.alloc_ == source.top_node_.alloc_);
+
+        if (this == std::addressof (source))
+            return;
+
+        for (auto it = source.begin(), ite = source.end(); it != ite;)
+        {
+            auto position = find_position_to_insert (*it);
+            if (position.node)
+            {
+                ++it;
+                continue;
+            }
+
+            ensure_capacity();
+            link_new_node (source.unlink_node (it), position);
+        }
+    }
+
+    void merge (ARB_Tree &&source) { merge (source); }
+
+    // Moves keys less than key to the first tree and the rest to the second one.
+    // The tree is left empty. Takes O(log n) time
+    std::pair<ARB_Tree, ARB_Tree> split (const key_type &key)
+    {
+        if constexpr (Unique_Keys)
+        {
+            std::pair result{ARB_Tree{comp_, get_allocator()}, ARB_Tree{comp_, get_allocator()}};
+
+            auto [less, equal, greater] = detail::split (detach_subtree(), key, comp_);
+            if (equal)
+                greater = detail::join (subtree_type{}, equal, greater);
+
+            result.first.adopt_subtree (less);
+            result.second.adopt_subtree (greater);
+
+            return result;
+        }
+        else // Equivalent keys may be on both sides of a node with such key
+            return split_at_rank (n_less_than (key));
+    }
+
+    // Moves k smallest keys to the first tree and the rest to the second one.
+    // The tree is left empty. Takes O(log n) time
+    std::pair<ARB_Tree, ARB_Tree> split_at_rank (size_type k)
+    {
+        std::pair result{ARB_Tree{comp_, get_allocator()}, ARB_Tree{comp_, get_allocator()}};
+
+        auto [less, greater] = detail::split_at_rank (detach_subtree(), k);
+
+        result.first.adopt_subtree (less);
+        result.second.adopt_subtree (greater);
+
+        return result;
+    }
+
+    // Concatenates two trees in O(log n) time. All keys of left have to be less than all keys
+    // of right (not greater for multisets) and allocators of the trees have to compare equal
+    static ARB_Tree join (ARB_Tree &&left, ARB_Tree &&right)
+    {
+        assert (left.top_node_.alloc_ == right.top_node_.alloc_);
+        assert (left.empty() || right.empty() ||
+                (Unique_Keys ? left.comp_ (*std::prev (left.end()), *right.begin())
+                             : !left.comp_ (*right.begin(), *std::prev (left.end()))));
+
+        auto less = left.detach_subtree();
+        auto greater = right.detach_subtree();
+
+        left.adopt_subtree (detail::join (less, greater));
+
+        return std::move (left);
+    }
+
+    // Read-only copy with the lookup and rank queries of the tree laid out for fast searches.
+    // Requires frozen_tree.hpp. Takes O(n) time
+    Frozen_ARB_Tree<Key_T, Compare> freeze () const
+    {
+        return Frozen_ARB_Tree<Key_T, Compare>{begin(), end(), comp_};
+    }
+
+    // Lookup
+
+    const_iterator find (const key_type &key) const { return iterator_or_end (find_impl (key)); }
+
+    // Finds first element that is not less than key
+    const_iterator lower_bound (const key_type &key) const
+    {
+        return iterator_or_end (lower_bound_impl (key));
+    }
+
+    // Finds first element that is greater than key
+    const_iterator upper_bound (const key_type &key) const
+    {
+        return iterator_or_end (upper_bound_impl (key));
+    }
+
+    bool contains (const key_type &key) const { return find (key) != end(); }
+
+    // Takes two descents for multisets
+    size_type count (const key_type &key) const { return count_impl (key); }
+
+    std::pair<const_iterator, const_iterator> equal_range (const key_type &key) const
+    {
+        return std::pair{lower_bound (key), upper_bound (key)};
+    }
+
+    // Overloads for keys of other types. They take part in overload resolution only if
+    // the comparator is transparent
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    const_iterator find (const K &key) const { return iterator_or_end (find_impl (key)); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    const_iterator lower_bound (const K &key) const
+    {
+        return iterator_or_end (lower_bound_impl (key));
+    }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    const_iterator upper_bound (const K &key) const
+    {
+        return iterator_or_end (upper_bound_impl (key));
+    }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    bool contains (const K &key) const { return find (key) != end(); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    size_type count (const K &key) const { return count_impl (key); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    std::pair<const_iterator, const_iterator> equal_range (const K &key) const
+    {
+        return std::pair{lower_bound (key), upper_bound (key)};
+    }
+
+    // k-th smallest element
+    const_iterator operator[] (size_type k) const
+    {
+        if (empty() || k == 0)
+            return end();
+
+        auto node = detail::kth_smallest (top_node_.get_root(), k);
+        return node ? const_iterator{node} : end();
+    }
+
+    // Iterator arithmetic in O(log n) time
+
+    // The number of keys before it
+    size_type rank (const_iterator it) const noexcept { return detail::rank (it.node_); }
+
+    difference_type distance (const_iterator first, const_iterator last) const noexcept
+    {
+        return last - first;
+    }
+
+    // Iterator k positions after it or end() if there are fewer keys after it
+    const_iterator next (const_iterator it, size_type k = 1) const noexcept
+    {
+        if (it == end() || k == 0)
+            return it;
+
+        return const_iterator{detail::advance (static_cast<const_node_ptr>(it.node_), k)};
+    }
+
+    // Iterator k positions before it. There have to be at least k keys before it
+    const_iterator prev (const_iterator it, size_type k = 1) const noexcept
+    {
+        assert (k <= rank (it));
+
+        if (k == 0)
+            return it;
+
+        auto node = (it == end()) ? top_node_.get_rightmost()
+                                  : static_cast<const_node_ptr>(it.node_);
+        if (it == end())
+            k--;
+
+        return const_iterator{detail::retreat (node, k)};
+    }
+
+    // Rank queries. Each of them but kth_in_range() takes one descent from the root
+
+    size_type n_less_than (const key_type &key) const { return n_less_than_impl (key); }
+    size_type n_less_equal (const key_type &key) const { return n_less_equal_impl (key); }
+    size_type n_greater_than (const key_type &key) const { return size() - n_less_equal (key); }
+
+    // Number of keys in [lo, hi)
+    size_type count_range (const key_type &lo, const key_type &hi) const
+    {
+        return count_range_impl (lo, hi);
+    }
+
+    // k-th smallest key that is not less than lo or end() if there are fewer such keys. Takes
+    // two descents from the root: one counts keys less than lo, the other selects by rank
+    const_iterator kth_in_range (const key_type &lo, size_type k) const
+    {
+        return kth_in_range_impl (lo, k);
+    }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    size_type n_less_than (const K &key) const { return n_less_than_impl (key); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    size_type n_less_equal (const K &key) const { return n_less_equal_impl (key); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    size_type n_greater_than (const K &key) const { return size() - n_less_equal (key); }
+
+    template<typename K, typename L> requires detail::transparent_compare<key_compare>
+    size_type count_range (const K &lo, const L &hi) const { return count_range_impl (lo, hi); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    const_iterator kth_in_range (const K &lo, size_type k) const
+    {
+        return kth_in_range_impl (lo, k);
+    }
+
+    /*
+     * Aggregate queries. They are available if nodes are augmented (see augmentation.hpp) and
+     * take one descent from the root. Empty ranges have no aggregate, so std::nullopt is returned
+     */
+
+    std::optional<aggregate_type> aggregate () const requires node_type::is_augmented
+    {
+        if (empty())
+            return std::nullopt;
+
+        return top_node_.get_root()->aggregate();
+    }
+
+    // Aggregate of keys in [lo, hi)
+    std::optional<aggregate_type> aggregate_range (const key_type &lo, const key_type &hi) const
+    requires node_type::is_augmented
+    {
+        return aggregate_range_impl (lo, hi);
+    }
+
+    template<typename K, typename L>
+    requires node_type::is_augmented && detail::transparent_compare<key_compare>
+    std::optional<aggregate_type> aggregate_range (const K &lo, const L &hi) const
+    {
+        return aggregate_range_impl (lo, hi);
+    }
+
+    /*
+     * The first key such that pred (aggregate of keys up to it inclusive) is true or end(). pred
+     * has to be false for aggregates of some prefix of keys and true for the rest. For example,
+     * weighted k-th key is the first one with the weight of keys up to it not less than k
+     */
+    template<typename Predicate> requires node_type::is_augmented
+    const_iterator lower_bound_by_aggregate (Predicate pred) const
+    {
+        std::optional<aggregate_type> prefix;
+
+        for (auto node = top_node_.get_root(); node;)
+        {
+            if (auto left = node->get_left())
+            {
+                auto with_left = append (prefix, left->aggregate());
+                if (pred (std::as_const (with_left)))
+                {
+                    node = left;
+                    continue;
+                }
+
+                prefix = std::move (with_left);
+            }
+
+            prefix = append (prefix, augmentation_type::make (node->key()));
+            if (pred (std::as_const (*prefix)))
+                return const_iterator{node};
+
+            node = node->get_right();
+        }
+
+        return end();
+    }
+
+    /*
+     * Batched queries. A batch is sorted and answered in one descent that visits common parts
+     * of the paths once. If the batch is large compared to the tree, one in-order pass is made
+     * instead. Answers are in the order of queries.
+     */
+
+    // operator[] for every k of ks
+    std::vector<const_iterator> batch_kth (std::span<const size_type> ks) const
+    {
+        std::vector<const_iterator> answers(ks.size(), end());
+
+        auto order = sorted_order (ks, std::less<size_type>{});
+
+        // Queries out of [1, size()] are answered with end()
+        auto first = std::partition_point (order.begin(), order.end(),
+                                           [&](size_type i){ return ks[i] == 0; });
+        auto last = std::partition_point (first, order.end(),
+                                          [&](size_type i){ return ks[i] <= size(); });
+
+        if (prefers_linear_pass (last - first))
+        {
+            auto it = begin();
+            size_type position = 1;
+
+            for (; first != last; ++first)
+            {
+                std::advance (it, ks[*first] - position);
+                position = ks[*first];
+                answers[*first] = it;
+            }
+        }
+        else
+            batch_kth_impl (top_node_.get_root(), 0, first, last, ks, answers);
+
+        return answers;
+    }
+
+    // n_less_than for every key of keys
+    std::vector<size_type> batch_rank (std::span<const key_type> keys) const
+    {
+        std::vector<size_type> answers(keys.size());
+
+        auto order = sorted_order (keys, comp_);
+
+        if (prefers_linear_pass (order.size()))
+        {
+            auto it = begin();
+            size_type rank = 0;
+
+            for (auto i : order)
+            {
+                for (; it != end() && comp_(*it, keys[i]); ++it)
+                    ++rank;
+
+                answers[i] = rank;
+            }
+        }
+        else
+            batch_rank_impl (top_node_.get_root(), 0, order.begin(), order.end(), keys, answers);
+
+        return answers;
+    }
+
+    #ifdef DEBUG
+
+    // I see how this violates SRP but I don't know any better implementation
+    void graphic_dump (std::ostream &os = std::cout) const
+    {
+        if (empty())
+            return;
+
+        detail::graphic_dump (os, begin().node_, end().node_);
+    }
+
+    #endif // DEBUG
+
+private:
+
+    const_iterator iterator_or_end (const_node_ptr node) const
+    {
+        return node ? const_iterator{node} : end();
+    }
+
+    /*
+     * Counts nodes of the subtree for which in_prefix (key) is true. The predicate has to be true
+     * for some prefix of sorted keys, so the rank is accumulated during one descent
+     */
+    template<typename Predicate>
+    static size_type count_prefix (const_node_ptr node, Predicate in_prefix)
+    {
+        size_type count = 0;
+
+        while (node)
+        {
+            if (in_prefix (node->key()))
+            {
+                count += node_type::size (node->get_left()) + 1;
+                node = node->get_right();
+            }
+            else
+                node = node->get_left();
+        }
+
+        return count;
+    }
+
+    template<typename K>
+    size_type n_less_than_impl (const K &key) const
+    {
+        return count_prefix (top_node_.get_root(), [&](const key_type &node_key)
+        {
+            return comp_(node_key, key);
+        });
+    }
+
+    template<typename K>
+    size_type n_less_equal_impl (const K &key) const
+    {
+        return count_prefix (top_node_.get_root(), [&](const key_type &node_key)
+        {
+            return !comp_(key, node_key);
+        });
+    }
+
+    template<typename K>
+    size_type count_impl (const K &key) const
+    {
+        if constexpr (Unique_Keys)
+            return find_impl (key) != nullptr;
+        else
+            return n_less_equal_impl (key) - n_less_than_impl (key);
+    }
+
+    // Descends to the node where paths to lo and hi diverge and then follows both of them
+    template<typename K, typename L>
+    size_type count_range_impl (const K &lo, const L &hi) const
+    {
+        auto less_than_lo = [&](const key_type &node_key){ return comp_(node_key, lo); };
+        auto less_than_hi = [&](const key_type &node_key){ return comp_(node_key, hi); };
+
+        for (auto node = top_node_.get_root(); node;)
+        {
+            if (less_than_lo (node->key()))
+                node = node->get_right();
+            else if (!less_than_hi (node->key()))
+                node = node->get_left();
+            else
+            {
+                auto left = node->get_left();
+                auto n_left = node_type::size (left) - count_prefix (left, less_than_lo);
+
+                return 1 + n_left + count_prefix (node->get_right(), less_than_hi);
+            }
+        }
+
+        return 0;
+    }
+
+    static aggregate_type append (const std::optional<aggregate_type> &lhs,
+                                  const aggregate_type &rhs)
+    {
+        return lhs ? augmentation_type::combine (*lhs, rhs) : rhs;
+    }
+
+    static aggregate_type prepend (const aggregate_type &lhs,
+                                   const std::optional<aggregate_type> &rhs)
+    {
+        return rhs ? augmentation_type::combine (lhs, *rhs) : lhs;
+    }
+
+    // Aggregate of keys of the subtree for which in_prefix (key) is true. Same as count_prefix()
+    template<typename Predicate>
+    static std::optional<aggregate_type> aggregate_prefix (const_node_ptr node,
+                                                           Predicate in_prefix)
+    {
+        std::optional<aggregate_type> result;
+
+        while (node)
+        {
+            if (in_prefix (node->key()))
+            {
+                auto part = augmentation_type::make (node->key());
+                if (auto left = node->get_left())
+                    part = augmentation_type::combine (left->aggregate(), part);
+
+                result = append (result, part);
+                node = node->get_right();
+            }
+            else
+                node = node->get_left();
+        }
+
+        return result;
+    }
+
+    // Aggregate of keys of the subtree for which in_prefix (key) is false
+    template<typename Predicate>
+    static std::optional<aggregate_type> aggregate_suffix (const_node_ptr node,
+                                                           Predicate in_prefix)
+    {
+        std::optional<aggregate_type> result;
+
+        while (node)
+        {
+            if (in_prefix (node->key()))
+                node = node->get_right();
+            else
+            {
+                auto part = augmentation_type::make (node->key());
+                if (auto right = node->get_right())
+                    part = augmentation_type::combine (part, right->aggregate());
+
+                result = prepend (part, result);
+                node = node->get_left();
+            }
+        }
+
+        return result;
+    }
+
+    // Same descent as in count_range_impl()
+    template<typename K, typename L>
+    std::optional<aggregate_type> aggregate_range_impl (const K &lo, const L &hi) const
+    {
+        auto less_than_lo = [&](const key_type &node_key){ return comp_(node_key, lo); };
+        auto less_than_hi = [&](const key_type &node_key){ return comp_(node_key, hi); };
+
+        for (auto node = top_node_.get_root(); node;)
+        {
+            if (less_than_lo (node->key()))
+                node = node->get_right();
+            else if (!less_than_hi (node->key()))
+                node = node->get_left();
+            else
+            {
+                auto result = append (aggregate_suffix (node->get_left(), less_than_lo),
+                                      augmentation_type::make (node->key()));
+
+                if (auto right = aggregate_prefix (node->get_right(), less_than_hi))
+                    result = augmentation_type::combine (result, *right);
+
+                return result;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    template<typename K>
+    const_iterator kth_in_range_impl (const K &lo, size_type k) const
+    {
+        auto n_less = n_less_than_impl (lo);
+        if (k == 0 || k > size() - n_less)
+            return end();
+
+        return const_iterator{detail::kth_smallest (top_node_.get_root(), n_less + k)};
+    }
+
+    using order_iterator = typename std::vector<size_type>::iterator;
+
+    // Indices of values in sorted order
+    template<typename T, typename Less>
+    static std::vector<size_type> sorted_order (std::span<const T> values, const Less &less)
+    {
+        std::vector<size_type> order(values.size());
+        std::iota (order.begin(), order.end(), size_type{0});
+
+        if (!std::is_sorted (values.begin(), values.end(), less))
+            std::stable_sort (order.begin(), order.end(), [&](size_type lhs, size_type rhs)
+            {
+                return less (values[lhs], values[rhs]);
+            });
+
+        return order;
+    }
+
+    // A descent per query costs about log(n) steps, a pass through the tree costs n steps
+    bool prefers_linear_pass (size_type n_queries) const noexcept
+    {
+        return n_queries * std::bit_width (size()) >= size();
+    }
+
+    // All queries in [first, last) ask for nodes of the subtree of node with ranks from
+    // (offset, offset + size (node)]
+    static void batch_kth_impl (const_node_ptr node, size_type offset,
+                                order_iterator first, order_iterator last,
+                                std::span<const size_type> ks, std::vector<const_iterator> &answers)
+    {
+        while (first != last)
+        {
+            assert (node);
+
+            auto node_rank = offset + node_type::size (node->get_left()) + 1;
+
+            auto mid = std::partition_point (first, last,
+                                             [&](size_type i){ return ks[i] < node_rank; });
+            auto after = std::partition_point (mid, last,
+                                               [&](size_type i){ return ks[i] == node_rank; });
+
+            for (auto it = mid; it != after; ++it)
+                answers[*it] = const_iterator{node};
+
+            if (first != mid)
+                batch_kth_impl (node->get_left(), offset, first, mid, ks, answers);
+
+            node = node->get_right();
+            offset = node_rank;
+            first = after;
+        }
+    }
+
+    // offset is the number of keys less than any key of the subtree of node
+    void batch_rank_impl (const_node_ptr node, size_type offset,
+                          order_iterator first, order_iterator last,
+                          std::span<const key_type> keys, std::vector<size_type> &answers) const
+    {
+        while (first != last)
+        {
+            if (node == nullptr)
+            {
+                for (; first != last; ++first)
+                    answers[*first] = offset;
+
+                return;
+            }
+
+            // Keys that are not greater than the key of node go to the left subtree
+            auto mid = std::partition_point (first, last, [&](size_type i)
+            {
+                return !comp_(node->key(), keys[i]);
+            });
+
+            if (first != mid)
+                batch_rank_impl (node->get_left(), offset, first, mid, keys, answers);
+
+            offset += node_type::size (node->get_left()) + 1;
+            node = node->get_right();
+            first = mid;
+        }
+    }
+
+    template<typename K>
+    const_node_ptr find_impl (const K &key) const
+    {
+        auto node = top_node_.get_root();
+
+        while (node)
+        {
+            auto order = detail::three_way (comp_, key, node->key());
+
+            if (order < 0)
+                node = node->get_left();
+            else if (order > 0)
+                node = node->get_right();
+            else
+                return node;
+        }
+
+        return nullptr;
+    }
+
+    // In multisets a new key is placed after all keys equivalent to it unless a hint says otherwise
+    template<typename K>
+    bool goes_after (const K &key, const key_type &node_key) const
+    {
+        if constexpr (Unique_Keys)
+            return comp_(node_key, key);
+        else
+            return !comp_(key, node_key);
+    }
+
+    template<typename K>
+    bool goes_before (const K &key, const key_type &node_key) const
+    {
+        if constexpr (Unique_Keys)
+            return comp_(key, node_key);
+        else
+            return !comp_(node_key, key);
+    }
+
+    template<typename K>
+    Insert_Position find_position_to_insert (const K &key)
+    {
+        // Increasing keys are appended without descent
+        auto rightmost = top_node_.get_rightmost();
+        if (rightmost && goes_after (key, rightmost->key()))
+            return Insert_Position{nullptr, rightmost, false};
+
+        auto node = top_node_.get_root();
+        end_node_ptr parent = top_node_.get_end_node();
+        auto as_left = true;
+
+        while (node)
+        {
+            auto order = detail::three_way (comp_, key, node->key());
+
+            if (order < 0) // key < node->key()
+            {
+                as_left = true;
+                parent = std::exchange (node, node->get_left());
+            }
+            else if (order > 0 || !Unique_Keys) // key > node->key()
+            {
+                as_left = false;
+                parent = std::exchange (node, node->get_right());
+            }
+            else
+                break;
+        }
+
+        return Insert_Position{node, parent, as_left};
+    }
+
+    /*
+     * Same as find_position_to_insert (key) but counts the new key in sizes of subtrees on the way
+     * down, so linking a new node doesn't walk the path once more. The counts are taken back if
+     * the key is already in the tree or if the comparator throws. size() doesn't change until
+     * the node is linked
+     */
+    template<typename K>
+    Insert_Position find_and_count_position_to_insert (const K &key)
+    {
+        auto rightmost = top_node_.get_rightmost();
+        if (rightmost && goes_after (key, rightmost->key()))
+            return Insert_Position{nullptr, rightmost, false};
+
+        auto node = top_node_.get_root();
+        end_node_ptr parent = top_node_.get_end_node();
+        auto as_left = true;
+
+        try
+        {
+            while (node)
+            {
+                auto order = detail::three_way (comp_, key, node->key());
+
+                if (order < 0) // key < node->key()
+                    as_left = true;
+                else if (order > 0 || !Unique_Keys) // key > node->key()
+                    as_left = false;
+                else
+                {
+                    uncount_path (parent);
+                    return Insert_Position{node, parent, as_left};
+                }
+
+                node->subtree_size_++;
+                parent = std::exchange (node, as_left ? node->get_left() : node->get_right());
+            }
+        }
+        catch (...)
+        {
+            uncount_path (parent);
+            throw;
+        }
+
+        return Insert_Position{nullptr, parent, as_left, true};
+    }
+
+    // Takes back the key counted by find_and_count_position_to_insert() from node and above
+    void uncount_path (end_node_ptr node) noexcept
+    {
+        for (auto end_node = top_node_.get_end_node(); node != end_node;
+             node = static_cast<node_ptr>(node)->get_parent())
+        {
+            node->subtree_size_--;
+        }
+    }
+
+    // Position before all keys equivalent to key. Used by multisets only
+    template<typename K>
+    Insert_Position find_lower_position_to_insert (const K &key)
+    {
+        auto node = top_node_.get_root();
+        end_node_ptr parent = top_node_.get_end_node();
+        auto as_left = true;
+
+        while (node)
+        {
+            as_left = !comp_(node->key(), key); // key <= node->key()
+            parent = std::exchange (node, as_left ? node->get_left() : node->get_right());
+        }
+
+        return Insert_Position{nullptr, parent, as_left};
+    }
+
+    // Same as find_position_to_insert (key) but also counts keys before the position
+    template<typename K>
+    std::pair<Insert_Position, size_type> find_position_with_rank (const K &key)
+    {
+        auto rightmost = top_node_.get_rightmost();
+        if (rightmost && goes_after (key, rightmost->key()))
+            return std::pair{Insert_Position{nullptr, rightmost, false}, size()};
+
+        auto node = top_node_.get_root();
+        end_node_ptr parent = top_node_.get_end_node();
+        auto as_left = true;
+        size_type rank = 0;
+
+        while (node)
+        {
+            auto order = detail::three_way (comp_, key, node->key());
+
+            if (order < 0) // key < node->key()
+            {
+                as_left = true;
+                parent = std::exchange (node, node->get_left());
+            }
+            else if (order > 0 || !Unique_Keys) // key > node->key()
+            {
+                as_left = false;
+                rank += node_type::size (node->get_left()) + 1;
+                parent = std::exchange (node, node->get_right());
+            }
+            else
+            {
+                rank += node_type::size (node->get_left());
+                break;
+            }
+        }
+
+        return std::pair{Insert_Position{node, parent, as_left}, rank};
+    }
+
+    /*
+     * Makes O(1) comparisons if key belongs right before or right after hint. Multisets accept
+     * a hint if prev (hint) <= key <= *hint or *hint <= key <= next (hint)
+     */
+    template<typename K>
+    Insert_Position find_position_to_insert (const_iterator hint, const K &key)
+    {
+        auto hint_node = const_cast<end_node_ptr>(hint.node_);
+
+        if (hint_node == top_node_.get_end_node() ||
+            goes_before (key, static_cast<node_ptr>(hint_node)->key())) // key < *hint
+        {
+            if (hint_node == leftmost_) // leftmost has no left child
+                return Insert_Position{nullptr, hint_node, true};
+
+            // If hint has a left child, its predecessor has no right one
+            auto prev = detail::predecessor (hint_node);
+            if (goes_after (key, prev->key()))
+                return hint_node->get_left() ? Insert_Position{nullptr, prev, false}
+                                             : Insert_Position{nullptr, hint_node, true};
+        }
+        else if (!Unique_Keys ||
+                 comp_(static_cast<node_ptr>(hint_node)->key(), key)) // key > *hint
+        {
+            // If hint has a right child, its successor has no left one
+            auto hint_ = static_cast<node_ptr>(hint_node);
+            auto next = detail::successor (hint_);
+            if (next == top_node_.get_end_node() ||
+                goes_before (key, static_cast<node_ptr>(next)->key()))
+            {
+                return hint_->get_right() ? Insert_Position{nullptr, next, true}
+                                          : Insert_Position{nullptr, hint_node, false};
+            }
+
+            // The closest position to hint is before all keys equivalent to key
+            if constexpr (!Unique_Keys)
+                return find_lower_position_to_insert (key);
+        }
+        else
+            return Insert_Position{static_cast<node_ptr>(hint_node), nullptr, false};
+
+        return find_position_to_insert (key);
+    }
+
+    template<typename K>
+    const_node_ptr lower_bound_impl (const K &key) const
+    {
+        auto node = top_node_.get_root();
+        const_node_ptr result = nullptr;
+
+        while (node)
+        {
+            if (!comp_(node->key(), key)) // key <= node->key()
+                result = std::exchange (node, node->get_left());
+            else
+                node = node->get_right();
+        }
+
+        return result;
+    }
+
+    // Same as lower_bound_impl (key) but also counts keys less than key
+    template<typename K>
+    std::pair<const_node_ptr, size_type> lower_bound_with_rank (const K &key) const
+    {
+        auto node = top_node_.get_root();
+        const_node_ptr result = nullptr;
+        size_type rank = 0;
+
+        while (node)
+        {
+            if (!comp_(node->key(), key)) // key <= node->key()
+                result = std::exchange (node, node->get_left());
+            else
+            {
+                rank += node_type::size (node->get_left()) + 1;
+                node = node->get_right();
+            }
+        }
+
+        return std::pair{result, rank};
     }
 
-    void clear ()
+    template<typename K>
+    const_node_ptr upper_bound_impl (const K &key) const
     {
-        top_node_.clean_up();
-        top_node_.set_default();
+        auto node = top_node_.get_root();
+        const_node_ptr result = nullptr;
 
-        leftmost_ = top_node_.get_end_node();
+        while (node)
+        {
+            if (comp_(key, node->key())) // key < node->key()
+                result = std::exchange (node, node->get_left());
+            else
+                node = node->get_right();
+        }
+
+        return result;
     }
 
-    std::pair<iterator, bool> insert (const key_type &key)
+    template<typename K>
+    node_ptr insert_impl (K &&key, const Insert_Position &position)
     {
-        auto [node, parent] = find_position_to_insert (key);
+        node_ptr new_node;
 
-        if (node == nullptr) // No node with such key in the tree
+        try
         {
-            auto new_node = insert_impl (key, parent);
-            return std::pair{iterator{new_node}, true};
+            new_node = make_node (std::forward<K>(key), color_type::red);
         }
-        else
-            return std::pair{iterator{node}, false};
+        catch (...)
+        {
+            if (position.counted)
+                uncount_path (position.parent);
+            throw;
+        }
+
+        link_new_node (new_node, position);
+
+        return new_node;
     }
 
-    template<std::input_iterator it>
-    void insert (it first, it last)
+    template<typename... Args>
+    node_ptr make_node (Args &&... args)
     {
-        for (; first != last; ++first)
-            insert_unique (*first);
+        ensure_capacity();
+        return top_node_.create_node (std::forward<Args>(args)...);
     }
 
-    void insert (std::initializer_list<value_type> ilist)
+    void ensure_capacity () const
     {
-        for (auto &&key : ilist)
-            insert_unique (key);
+        if (size() == max_size())
+            throw std::length_error{"ARB_Tree: size() would exceed max_size()"};
     }
 
-    iterator erase (iterator pos)
+    // Takes a node out of the tree and moves pos to the next node. The node is left detached:
+    // without children, red and with subtree size 1
+    node_ptr unlink_node (iterator &pos)
     {
         auto node = const_cast<end_node_ptr>(pos.node_);
         ++pos;
@@ -695,195 +2003,433 @@ public:
         if (node == leftmost_)
             leftmost_ = pos.node_;
 
-        detail::erase_impl (top_node_.get_root(), static_cast<node_ptr>(node));
-        delete node;
+        if (node == top_node_.get_rightmost())
+            top_node_.set_rightmost (size() == 1 ? nullptr : detail::predecessor (node));
+
+        auto node_ = static_cast<node_ptr>(node);
+        detail::erase_impl<Balance_T>(top_node_.get_root(), node_);
+
+        node_->set_left (nullptr);
+        node_->set_right (nullptr);
+        node_->set_color (color_type::red);
+        node_->subtree_size_ = 1;
 
         assert (search_verifier());
-        assert (red_black_verifier());
+        assert (balance_verifier());
         assert (subtree_sizes_verifier());
+        assert (aggregates_verifier());
+        assert (extremes_verifier());
 
-        return pos;
+        return node_;
     }
 
-    size_type erase (const key_type &key)
+    // Attaches a new red node to the parent of position and restores balance
+    void link_new_node (node_ptr new_node, const Insert_Position &position)
     {
-        auto it = find (key);
-        if (it == end())
-            return 0;
+        auto parent = position.parent;
+        new_node->set_parent (parent);
+
+        if (position.as_left)
+            parent->set_left (new_node);
         else
+            static_cast<node_ptr>(parent)->set_right (new_node);
+
+        auto rightmost = top_node_.get_rightmost();
+        if (rightmost == nullptr || new_node == rightmost->get_right())
+            top_node_.set_rightmost (new_node);
+
+        // The key of an extracted node might have been changed
+        new_node->update_aggregate();
+
+        // Sizes of a counted position have been updated on the way down, aggregates haven't
+        if (!position.counted || node_type::is_augmented)
         {
-            erase (it);
-            return 1;
+            for (auto node = parent; node != top_node_.get_end_node();
+                 node = static_cast<node_ptr>(node)->get_parent())
+            {
+                node->subtree_size_ += !position.counted;
+                static_cast<node_ptr>(node)->update_aggregate();
+            }
         }
-    }
+        top_node_.get_end_node()->subtree_size_++;
 
-    // Lookup
+        // Fixup may rotate new_node away from its place under leftmost_
+        if (new_node == leftmost_->get_left())
+            leftmost_ = new_node;
+
+        Balance_T::insert_fixup (top_node_.get_root(), new_node);
+
+        assert (search_verifier());
+        assert (balance_verifier());
+        assert (subtree_sizes_verifier());
+        assert (aggregates_verifier());
+        assert (extremes_verifier());
+    }
 
-    const_iterator find (const key_type &key) const
+    // Links a node constructed in advance or destroys it if its key is already in the tree
+    template<typename Finder>
+    std::pair<iterator, bool> insert_constructed (node_ptr new_node, Finder find_position)
     {
-        auto node = find_impl (key);
-        return node ? const_iterator{node} : end();
+        Insert_Position position;
+
+        try
+        {
+            position = find_position (new_node->key());
+        }
+        catch (...)
+        {
+            top_node_.destroy_node (new_node);
+            throw;
+        }
+
+        if (position.node == nullptr)
+        {
+            link_new_node (new_node, position);
+            return std::pair{iterator{new_node}, true};
+        }
+        else
+        {
+            top_node_.destroy_node (new_node);
+            return std::pair{iterator{position.node}, false};
+        }
     }
 
-    // Finds first element that is not less than key
-    const_iterator lower_bound (const key_type &key) const
+    template<typename K>
+    size_type erase_key (const K &key)
     {
-        auto node = lower_bound_impl (key);
-        return node ? const_iterator{node} : end();
+        if constexpr (!Unique_Keys)
+            return erase_equivalent (lower_bound_impl (key), key);
+        else
+        {
+            auto it = find (key);
+            if (it == end())
+                return 0;
+
+            erase (it);
+            return 1;
+        }
     }
 
-    // Finds first element that is greater than key
-    const_iterator upper_bound (const key_type &key) const
+    // Erases first and the following keys equivalent to key. Used by multisets only
+    template<typename K>
+    size_type erase_equivalent (const_node_ptr first, const K &key)
     {
-        auto node = upper_bound_impl (key);
-        return node ? const_iterator{node} : end();
+        size_type n_erased = 0;
+        for (auto it = iterator_or_end (first); it != end() && !comp_(key, *it); ++n_erased)
+            it = erase (it);
+
+        return n_erased;
     }
 
-    bool contains (const key_type &key) const { return find (key) != end(); }
+    static key_insert_result insert_result (std::pair<iterator, bool> result) noexcept
+    {
+        if constexpr (Unique_Keys)
+            return result;
+        else
+            return result.first;
+    }
 
-    // k-th smallest element
-    const_iterator operator[] (size_type k) const
+    template<typename K>
+    std::pair<iterator, bool> insert_key (K &&key)
     {
-        if (empty() || k == 0)
-            return end();
+        auto position = find_and_count_position_to_insert (key);
 
-        auto node = detail::kth_smallest (top_node_.get_root(), k);
-        return node ? const_iterator{node} : end();
+        if (position.node == nullptr) // No node with such key in the tree
+        {
+            auto new_node = insert_impl (std::forward<K>(key), position);
+            return std::pair{iterator{new_node}, true};
+        }
+        else
+            return std::pair{iterator{position.node}, false};
     }
 
-    size_type n_less_than (const key_type &key) const
+    template<typename K>
+    std::tuple<iterator, bool, size_type> insert_key_with_rank (K &&key)
     {
-        if (empty())
-            return 0;
+        auto [position, rank] = find_position_with_rank (key);
 
-        auto it = lower_bound (key);
-        if (it == end())
-            return size();
+        if (position.node == nullptr)
+        {
+            auto new_node = insert_impl (std::forward<K>(key), position);
+            return std::tuple{iterator{new_node}, true, rank};
+        }
         else
-            return detail::n_less_than (static_cast<const_end_node_ptr>(top_node_.get_root()),
-                                        it.node_);
+            return std::tuple{iterator{position.node}, false, rank};
     }
 
-    #ifdef DEBUG
-
-    // I see how this violates SRP but I don't know any better implementation
-    void graphic_dump (std::ostream &os = std::cout) const
+    template<typename K>
+    iterator insert_key (const_iterator hint, K &&key)
     {
-        if (empty())
-            return;
+        auto position = find_position_to_insert (hint, key);
 
-        detail::graphic_dump (os, begin().node_, end().node_);
+        if (position.node == nullptr)
+            return iterator{insert_impl (std::forward<K>(key), position)};
+        else
+            return iterator{position.node};
     }
 
-    #endif // DEBUG
+    template<typename K>
+    void insert_one (K &&key)
+    {
+        auto position = find_and_count_position_to_insert (key);
 
-private:
+        if (position.node == nullptr)
+            insert_impl (std::forward<K>(key), position);
+    }
 
-    const_node_ptr find_impl (const key_type &key) const
+    // Hands out nodes of a dismantled tree before allocating new ones
+    class Node_Recycler final
     {
-        auto node = top_node_.get_root();
+        Root_Wrapper &owner_;
+        node_ptr nodes_; // linked through right children
 
-        while (node)
+    public:
+
+        Node_Recycler (Root_Wrapper &owner, node_ptr root) : owner_{owner}, nodes_{nullptr}
         {
-            if (comp_(key, node->key()))
-                node = node->get_left();
-            else if (comp_(node->key(), key))
-                node = node->get_right();
-            else
-                return node;
+            Root_Wrapper::dismantle (root, [this](node_ptr node)
+            {
+                node->set_right (std::exchange (nodes_, node));
+            });
         }
 
-        return nullptr;
+        Node_Recycler (const Node_Recycler &rhs) = delete;
+        Node_Recycler &operator= (const Node_Recycler &rhs) = delete;
+
+        ~Node_Recycler ()
+        {
+            while (nodes_)
+                owner_.destroy_node (std::exchange (nodes_, nodes_->get_right()));
+        }
+
+        template<typename... Args>
+        node_ptr operator() (Args &&... args)
+        {
+            if (nodes_ == nullptr)
+                return owner_.create_node (std::forward<Args>(args)...);
+
+            auto node = std::exchange (nodes_, nodes_->get_right());
+            owner_.reconstruct_node (node, std::forward<Args>(args)...);
+
+            return node;
+        }
+    };
+
+    // Leaves the tree empty and returns its former root
+    node_ptr detach_nodes () noexcept
+    {
+        auto root = top_node_.get_root();
+
+        top_node_.set_default();
+        leftmost_ = top_node_.get_end_node();
+
+        return root;
     }
 
-    std::pair<node_ptr, end_node_ptr> find_position_to_insert (const key_type &key)
+    // Leaves the tree empty and returns its former root as a detached subtree
+    subtree_type detach_subtree () noexcept
     {
-        auto node = top_node_.get_root();
-        end_node_ptr parent = top_node_.get_end_node();
+        auto root = detach_nodes();
+        return {root, Balance_T::rank (root)};
+    }
 
-        while (node)
+    void adopt_subtree (subtree_type subtree) noexcept
+    {
+        assert (empty());
+
+        if (auto root = subtree.root)
         {
-            if (comp_(key, node->key())) // key < node->key()
-                parent = std::exchange (node, node->get_left());
-            else if (comp_(node->key(), key)) // key > node->key()
-                parent = std::exchange (node, node->get_right());
-            else
-                break;
+            top_node_.set_root (root);
+            root->set_parent (top_node_.get_end_node());
+            top_node_.get_end_node()->subtree_size_ = root->subtree_size_ + 1;
+            leftmost_ = detail::minimum (root);
+            top_node_.set_rightmost (detail::maximum (root));
         }
 
-        return std::pair{node, parent};
+        assert (search_verifier());
+        assert (balance_verifier());
+        assert (subtree_sizes_verifier());
+        assert (aggregates_verifier());
+        assert (extremes_verifier());
     }
 
-    const_node_ptr lower_bound_impl (const key_type &key) const
+    // Copies shape, colors and subtree sizes of rhs into empty *this without comparisons
+    template<typename Node_Factory>
+    void clone_from (const ARB_Tree &rhs, Node_Factory &&make_node)
     {
-        auto node = top_node_.get_root();
-        const_node_ptr result = nullptr;
+        assert (empty());
 
-        while (node)
+        if (rhs.empty())
+            return;
+
+        auto root = Balance_T::settle (clone_subtree (rhs.top_node_.get_root(), make_node));
+
+        top_node_.set_root (root);
+        root->set_parent (top_node_.get_end_node());
+        top_node_.get_end_node()->subtree_size_ = rhs.top_node_.get_end_node()->subtree_size_;
+        leftmost_ = detail::minimum (root);
+        top_node_.set_rightmost (detail::maximum (root));
+    }
+
+    template<typename Node_Factory>
+    node_ptr clone_subtree (const_node_ptr source, Node_Factory &make_node)
+    {
+        assert (source);
+
+        auto node = make_node (source->key(), source->get_color());
+        node->subtree_size_ = source->subtree_size_;
+
+        try
         {
-            if (!comp_(node->key(), key)) // key <= node->key()
-                result = std::exchange (node, node->get_left());
-            else
-                node = node->get_right();
+            if (auto left = source->get_left())
+            {
+                auto left_clone = clone_subtree (left, make_node);
+                node->set_left (left_clone);
+                left_clone->set_parent (node);
+            }
+
+            if (auto right = source->get_right())
+            {
+                auto right_clone = clone_subtree (right, make_node);
+                node->set_right (right_clone);
+                right_clone->set_parent (node);
+            }
+        }
+        catch (...)
+        {
+            top_node_.destroy_subtree (node);
+            throw;
         }
 
-        return result;
+        node->update_aggregate();
+
+        return node;
     }
 
-    const_node_ptr upper_bound_impl (const key_type &key) const
+    // The number of keys of [first, last) that get into the tree (duplicates are skipped only
+    // if keys are unique). Returns std::nullopt if [first, last) isn't sorted
+    template<std::forward_iterator it>
+    std::optional<size_type> n_keys_if_sorted (it first, it last) const
     {
-        auto node = top_node_.get_root();
-        const_node_ptr result = nullptr;
+        if (first == last)
+            return 0;
 
-        while (node)
+        size_type n_keys = 1;
+        for (auto prev = first++; first != last; prev = first++)
         {
-            if (comp_(key, node->key())) // key < node->key()
-                result = std::exchange (node, node->get_left());
-            else
-                node = node->get_right();
+            if (comp_(*first, *prev))
+                return std::nullopt;
+
+            if (!Unique_Keys || comp_(*prev, *first))
+                n_keys++;
         }
 
-        return result;
+        return n_keys;
+    }
+
+    /*
+     * Builds a perfectly balanced tree from n_unique keys of sorted range [first, last).
+     * All levels but the last one are full. Colors of nodes are chosen by the balancing
+     * policy. If Skip_Duplicates is false, keys have to be unique.
+     */
+    template<bool Skip_Duplicates, std::forward_iterator it>
+    void build_from_sorted (it first, it last, size_type n_unique)
+    {
+        assert (empty());
+
+        if (n_unique == 0)
+            return;
+
+        auto root = build_subtree<Skip_Duplicates>(first, last, n_unique, 0, n_unique);
+        root = Balance_T::settle (root);
+
+        top_node_.set_root (root);
+        root->set_parent (top_node_.get_end_node());
+        top_node_.get_end_node()->subtree_size_ = n_unique + 1;
+        leftmost_ = detail::minimum (root);
+        top_node_.set_rightmost (detail::maximum (root));
+
+        assert (search_verifier());
+        assert (balance_verifier());
+        assert (subtree_sizes_verifier());
+        assert (aggregates_verifier());
+        assert (extremes_verifier());
     }
 
-    node_ptr insert_impl (const key_type &key, end_node_ptr parent)
+    template<bool Skip_Duplicates, std::forward_iterator it>
+    node_ptr build_subtree (it &first, it last, size_type n, size_type depth, size_type total)
     {
-        auto new_node = new node_type{key, color_type::red};
-        new_node->set_parent (parent);
+        if (n == 0)
+            return nullptr;
+
+        auto n_left = (n - 1) / 2;
+        auto left = build_subtree<Skip_Duplicates>(first, last, n_left, depth + 1, total);
 
-        if (parent == top_node_.get_end_node() ||
-            comp_(key, static_cast<node_ptr>(parent)->key()))
+        // Duplicates are skipped before the key is used, as it may be moved from
+        auto current = first++;
+        if constexpr (Skip_Duplicates)
         {
-            parent->set_left (new_node);
+            while (first != last && !comp_(*current, *first))
+                ++first;
         }
-        else
-            static_cast<node_ptr>(parent)->set_right (new_node);
 
-        for (auto node = parent; node != top_node_.get_end_node();
-             node = static_cast<node_ptr>(node)->get_parent())
+        node_ptr node;
+        try
         {
-            node->subtree_size_++;
+            node = top_node_.create_node (*current, Balance_T::build_color (depth, n, total));
+        }
+        catch (...)
+        {
+            top_node_.destroy_subtree (left);
+            throw;
         }
-        top_node_.get_end_node()->subtree_size_++;
 
-        detail::rb_insert_fixup (top_node_.get_root(), new_node);
+        node->set_left (left);
+        if (left)
+            left->set_parent (node);
 
-        if (new_node == leftmost_->get_left())
-            leftmost_ = new_node;
+        node_ptr right;
+        try
+        {
+            right = build_subtree<Skip_Duplicates>(first, last, n - 1 - n_left, depth + 1, total);
+        }
+        catch (...)
+        {
+            top_node_.destroy_subtree (node);
+            throw;
+        }
 
-        assert (search_verifier());
-        assert (red_black_verifier());
-        assert (subtree_sizes_verifier());
+        node->set_right (right);
+        if (right)
+            right->set_parent (node);
 
-        return new_node;
+        node->subtree_size_ = n;
+        node->update_aggregate();
+
+        return node;
+    }
+
+    // Exchanges nodes and comparators but not allocators
+    void swap_contents (ARB_Tree &other) noexcept (std::is_nothrow_swappable_v<key_compare>)
+    {
+        std::swap (top_node_.end_node_, other.top_node_.end_node_);
+        std::swap (leftmost_, other.leftmost_);
+        std::swap (comp_, other.comp_);
+
+        set_leftmost_or_parent_of_root();
+        other.set_leftmost_or_parent_of_root();
     }
 
-    void insert_unique (const key_type &key)
+    // Used when nodes of other can't be adopted because allocators compare unequal
+    void move_elements_from (ARB_Tree &other)
     {
-        auto [node, parent] = find_position_to_insert (key);
+        for (auto it = other.begin(), ite = other.end(); it != ite; ++it)
+        {
+            auto node = const_cast<node_ptr>(static_cast<const_node_ptr>(it.node_));
+            insert_one (std::move (node->key()));
+        }
 
-        if (node == nullptr)
-            insert_impl (key, parent);
+        other.clear();
     }
 
     bool search_verifier () const
@@ -891,7 +2437,7 @@ private:
         return std::is_sorted (begin(), end(), comp_);
     }
 
-    bool red_black_verifier () const
+    bool balance_verifier () const
     {
         if (top_node_.get_root() == nullptr)
             return true; // empty tree
@@ -902,10 +2448,16 @@ private:
         if (!detail::is_left_child (top_node_.get_root()))
             return false;
 
-        if (top_node_.get_root()->color_ != color_type::black)
-            return false;
+        return Balance_T::verifier (top_node_.get_root());
+    }
 
-        return (detail::red_black_verifier (top_node_.get_root()) != 0);
+    bool extremes_verifier () const
+    {
+        if (empty())
+            return leftmost_ == top_node_.get_end_node() && top_node_.get_rightmost() == nullptr;
+
+        return leftmost_ == detail::minimum (top_node_.get_root()) &&
+               top_node_.get_rightmost() == detail::maximum (top_node_.get_root());
     }
 
     bool subtree_sizes_verifier () const
@@ -926,6 +2478,28 @@ private:
         return true;
     }
 
+    bool aggregates_verifier () const
+    {
+        if constexpr (node_type::is_augmented && std::equality_comparable<aggregate_type>)
+        {
+            for (auto it = begin(), ite = end(); it != ite; ++it)
+            {
+                auto node = static_cast<const_node_ptr>(it.node_);
+
+                auto expected = augmentation_type::make (node->key());
+                if (auto left = node->get_left())
+                    expected = augmentation_type::combine (left->aggregate(), expected);
+                if (auto right = node->get_right())
+                    expected = augmentation_type::combine (expected, right->aggregate());
+
+                if (!(expected == node->aggregate()))
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
     void set_leftmost_or_parent_of_root ()
     {
         if (top_node_.get_root())
@@ -935,20 +2509,51 @@ private:
     }
 };
 
-template<typename Key_T, typename Compare>
-bool operator== (const ARB_Tree<Key_T, Compare> &lhs, const ARB_Tree<Key_T, Compare> &rhs)
+template<typename Key_T, typename Compare, typename Allocator, typename Node_T, bool Unique_Keys,
+         typename Balance_T>
+bool operator== (const ARB_Tree<Key_T, Compare, Allocator, Node_T, Unique_Keys, Balance_T> &lhs,
+                 const ARB_Tree<Key_T, Compare, Allocator, Node_T, Unique_Keys, Balance_T> &rhs)
 {
     return (lhs.size() == rhs.size()) &&
            (std::equal (lhs.begin(), lhs.end(), rhs.begin()));
 }
 
-template<typename Key_T, typename Compare>
-auto operator<=> (const ARB_Tree<Key_T, Compare> &lhs, const ARB_Tree<Key_T, Compare> &rhs)
+template<typename Key_T, typename Compare, typename Allocator, typename Node_T, bool Unique_Keys,
+         typename Balance_T>
+auto operator<=> (const ARB_Tree<Key_T, Compare, Allocator, Node_T, Unique_Keys, Balance_T> &lhs,
+                  const ARB_Tree<Key_T, Compare, Allocator, Node_T, Unique_Keys, Balance_T> &rhs)
 -> decltype (std::compare_three_way{}(*lhs.begin(), *rhs.begin()))
 {
     return std::lexicographical_compare_three_way (lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
 }
 
+// ARB_Tree that keeps equivalent keys
+template<typename Key_T, typename Compare = std::less<Key_T>,
+         typename Allocator = std::allocator<Key_T>, typename Node_T = ARB_Node<Key_T>>
+using ARB_Multiset = ARB_Tree<Key_T, Compare, Allocator, Node_T, false>;
+
+// Same interface as ARB_Tree. Subtree sizes are 32-bit, so it holds up to 2^32 - 2 keys
+template<typename Key_T, typename Compare = std::less<Key_T>,
+         typename Allocator = std::allocator<Key_T>>
+using Compact_ARB_Tree = ARB_Tree<Key_T, Compare, Allocator, Compact_ARB_Node<Key_T>>;
+
+// ARB_Tree with subtree aggregates of Augment_T in addition to sizes (see augmentation.hpp)
+template<typename Key_T, typename Augment_T, typename Compare = std::less<Key_T>,
+         typename Allocator = std::allocator<Key_T>>
+using Augmented_ARB_Tree = ARB_Tree<Key_T, Compare, Allocator,
+                                    ARB_Node<Key_T, std::size_t, Augment_T>>;
+
+template<typename Key_T, typename Compare = std::less<Key_T>>
+using Pooled_ARB_Tree = ARB_Tree<Key_T, Compare, Pool_Allocator<Key_T>>;
+
+namespace pmr
+{
+
+template<typename Key_T, typename Compare = std::less<Key_T>>
+using ARB_Tree = yLab::ARB_Tree<Key_T, Compare, std::pmr::polymorphic_allocator<Key_T>>;
+
+} // namespace pmr
+
 } // namespace yLab
 
 #endif // INCLUDE_RB_TREE_HPP
@@ -0,0 +1,83 @@
+/*
+ * This header contains augmentation policies of ARB_Node.
+ *
+ * Every node of a tree keeps the number of nodes in its subtree. An augmentation policy adds one
+ * more subtree aggregate: a value of a monoid computed over the keys of the subtree in their
+ * in-order sequence. A policy is a class with:
+ *
+ *     using value_type = ...;
+ *     static value_type make (const Key_T &key);                           // of a single key
+ *     static value_type combine (const value_type &lhs, const value_type &rhs); // associative
+ *
+ * combine() needn't be commutative: lhs always comes from lesser keys. Neither function is
+ * supposed to throw as they are called from rotations. An identity element isn't needed.
+ *
+ * No_Augmentation is the default policy: nodes don't store anything for it.
+ */
+
+#ifndef INCLUDE_AUGMENTATION_HPP
+#define INCLUDE_AUGMENTATION_HPP
+
+#include <functional>
+#include <type_traits>
+#include <algorithm>
+
+namespace yLab
+{
+
+struct No_Augmentation
+{
+    struct value_type {};
+
+    template<typename Key_T>
+    static value_type make (const Key_T &) noexcept { return {}; }
+
+    static value_type combine (value_type, value_type) noexcept { return {}; }
+};
+
+/*
+ * Sum of projections of keys. With the default projection it is the sum of keys; a projection
+ * returning a weight of a key makes it a weighted count
+ */
+template<typename Key_T, typename Projection = std::identity>
+struct Sum_Augmentation
+{
+    using value_type = std::remove_cvref_t<std::invoke_result_t<Projection, const Key_T &>>;
+
+    static value_type make (const Key_T &key) { return std::invoke (Projection{}, key); }
+
+    static value_type combine (const value_type &lhs, const value_type &rhs)
+    {
+        return lhs + rhs;
+    }
+};
+
+template<typename Key_T, typename Projection = std::identity>
+struct Min_Augmentation
+{
+    using value_type = std::remove_cvref_t<std::invoke_result_t<Projection, const Key_T &>>;
+
+    static value_type make (const Key_T &key) { return std::invoke (Projection{}, key); }
+
+    static value_type combine (const value_type &lhs, const value_type &rhs)
+    {
+        return std::min (lhs, rhs);
+    }
+};
+
+template<typename Key_T, typename Projection = std::identity>
+struct Max_Augmentation
+{
+    using value_type = std::remove_cvref_t<std::invoke_result_t<Projection, const Key_T &>>;
+
+    static value_type make (const Key_T &key) { return std::invoke (Projection{}, key); }
+
+    static value_type combine (const value_type &lhs, const value_type &rhs)
+    {
+        return std::max (lhs, rhs);
+    }
+};
+
+} // namespace yLab
+
+#endif // INCLUDE_AUGMENTATION_HPP
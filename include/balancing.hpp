@@ -0,0 +1,1156 @@
+/*
+ * This header contains balancing policies of ARB_Tree. A policy is the last template parameter of
+ * the tree and decides how the tree restores balance after insertion and erasure, how it joins
+ * detached subtrees and how it checks itself. Rotations and maintenance of subtree sizes and
+ * aggregates are shared by all policies (see nodes.hpp).
+ *
+ * Red_Black_Balance is the default policy. AVL_Balance keeps the tree the lowest: its height is
+ * under 1.44 log(n), which pays off when reads dominate. WAVL_Balance (weak AVL) behaves as AVL
+ * until the first erasure, but erasure takes O(1) rotations (at most 2) in the worst case, as in
+ * red-black trees, while the height stays under 2 log(n). Treap_Balance keeps the tree in heap
+ * order of pseudo-random priorities: its expected height is about 3 log(n), it needs O(1)
+ * expected rotations per update (erasure rotates the node down until it has at most one child,
+ * which takes under 2 rotations on average) and it has the simplest join.
+ *
+ * No policy needs more space in a node than the color bit. AVL_Balance and WAVL_Balance keep the
+ * parity of the height of a node there (red nodes have odd heights; the height of nullptr is 0).
+ * Heights of a node and its child differ by 1 or 2 in such trees, so the parity is enough to know
+ * the difference. Treap_Balance takes the priority of a node from a hash of its address and
+ * doesn't use the color at all, so the tree rebuilds its shape when it gets copied.
+ *
+ * A policy is a class with static member functions:
+ *     insert_fixup (root, node)      node has just been linked as a red leaf with subtree sizes
+ *                                    updated. Returns true if the rank of the tree has grown
+ *     erase_prepare (z)              called before z is removed; may rotate z down
+ *     erase_fixup (removal)          see detail::Removal
+ *     rank (root)                    rank of a detached subtree (see detail::Subtree)
+ *     detach_child (child, rank)     makes a child of a node of the given rank the root of
+ *                                    a detached subtree and returns its rank
+ *     join (left, pivot, right)      joins detached subtrees with a pivot between them
+ *     build_color (depth, n, total)  color of a node at depth with n nodes in its subtree in
+ *                                    a perfectly balanced tree of total nodes
+ *     settle (root)                  restores balance of a tree which shape has been copied
+ *                                    from another tree; returns the new root
+ *     verifier (root)                checks the invariants of the policy
+ */
+
+#ifndef INCLUDE_BALANCING_HPP
+#define INCLUDE_BALANCING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <memory>
+#include <bit>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <initializer_list>
+
+#include "nodes.hpp"
+
+namespace yLab
+{
+
+namespace detail
+{
+
+/*
+ * Split and join work with detached subtrees: a subtree is described by its root (or nullptr)
+ * and its rank. The rank of a red-black subtree is its black height, that is the number of black
+ * nodes on any path from the root down to a leaf (its root is black). The rank of an AVL or WAVL
+ * subtree is its height. Treaps don't need ranks. Parent pointers of such roots are meaningless.
+ */
+template<typename Node_T, typename Balance_T>
+struct Subtree
+{
+    Node_T *root = nullptr;
+    std::size_t rank = 0;
+};
+
+/*
+ * What erase_impl() from arb_tree.hpp has done to a tree to remove node z. y is z itself if z has
+ * had less than 2 children and the successor of z otherwise; then y has taken the place and the
+ * color of z. child_of_y (may be nullptr) has taken the former place of y, which is now a child of
+ * parent. Subtree sizes and aggregates are up to date
+ */
+template<typename Node_T>
+struct Removal
+{
+    Node_T *root;                                // nullptr if the tree has become empty
+    Node_T *z;
+    Node_T *y;
+    Node_T *child_of_y;
+    Node_T *sibling_of_y;                        // nullptr if y has been the root
+    typename Node_T::end_node_type *parent;      // the end node if y has been the root
+    bool is_left;                                // whether child_of_y is a left child
+    RB_Color y_original_color;
+};
+
+// Makes pivot the root of a detached subtree with children left and right
+template<typename Node_T>
+void link_pivot (Node_T *pivot, Node_T *left, Node_T *right) noexcept
+{
+    pivot->set_left (left);
+    pivot->set_right (right);
+
+    if (left)
+        left->set_parent (pivot);
+    if (right)
+        right->set_parent (pivot);
+
+    pivot->subtree_size_ = 1 + Node_T::size (left) + Node_T::size (right);
+    pivot->update_aggregate();
+}
+
+// Rotates the edge between node and its parent, so that node takes place of the parent
+template<typename Node_T>
+void rotate_up (Node_T *node) noexcept
+{
+    auto parent = node->parent_unsafe();
+
+    if (is_left_child (node))
+        right_rotate (parent);
+    else
+        left_rotate (parent);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ RED-BLACK ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/*
+ * Properties that:
+ * 1. parent->parent_ exists
+ * 2. parent->parent_ isn't end_node
+ * are guaranteed by the algorithm (look rb_insert_fixup)
+ */
+template<typename Node_T>
+Node_T *recolor_parent_grandparent_uncle (Node_T *parent, Node_T *uncle,
+                                          const Node_T *root) noexcept
+{
+    using color_type = typename Node_T::color_type;
+
+    assert (parent);
+    assert (uncle);
+    assert (parent->parent_unsafe());
+
+    parent->set_color (color_type::black);
+
+    parent = parent->parent_unsafe();
+    if (parent != root)
+        parent->set_color (color_type::red);
+
+    uncle->set_color (color_type::black);
+
+    return parent;
+};
+
+template<typename Node_T>
+Node_T *recolor_parent_grandparent (Node_T *parent) noexcept
+{
+    using color_type = typename Node_T::color_type;
+
+    assert (parent);
+    assert (parent->parent_unsafe());
+
+    parent->set_color (color_type::black);
+
+    parent = parent->parent_unsafe();
+    parent->set_color (color_type::red);
+
+    return parent;
+};
+
+// Returns true if black height of the tree has grown
+template <typename Node_T>
+bool rb_insert_fixup (const Node_T *root, Node_T *new_node) noexcept
+{
+    using color_type = typename Node_T::color_type;
+
+    assert (new_node);
+
+    // Checks if "The root is black" property is violated
+    if (new_node == root)
+    {
+        new_node->set_color (color_type::black);
+        return true;
+    }
+
+    // Further: (new_node != root) ==> (root->get_color() == color_type::black)
+
+    auto parent = new_node->parent_unsafe();
+
+    // Checks if "If a node is red, then both its children are black" property is violated
+    while (new_node != root && parent->get_color() == color_type::red)
+    {
+        /*
+         * Some notes:
+         * (1). First condition is important only for iterations 2, 3, ... but not for 1
+         * (2). (new_node != root) ==> (parent != end_node)
+         * (3). (parent->get_color() == color_type::red) ==> (parent != root)
+         */
+
+        if (is_left_child (parent))
+        {
+            // (3) ==> exists (parent->parent_) != end_node
+            // Further: we will refer to parent->parent_ as "grandparent"
+            auto uncle = parent->parent_unsafe()->get_right();
+
+            if (is_red (uncle))
+            {
+                /* (uncle->get_color() == color_type::red) ==>
+                 * grandparent->get_color() == color_type::black ==> grandparent may be root */
+
+                new_node = recolor_parent_grandparent_uncle (parent, uncle, root);
+            }
+            else
+            {
+                if (!is_left_child (new_node))
+                {
+                    left_rotate (parent);
+                    parent = new_node;
+                }
+
+                /* If grandparent is root and colored red inside recolor_parent_grandparent,
+                 * rotation will put parent (that is black) in place of root */
+                right_rotate (recolor_parent_grandparent (parent));
+                return false;
+            }
+        }
+        else
+        {
+            auto uncle = parent->get_parent()->get_left();
+
+            if (is_red (uncle))
+                new_node = recolor_parent_grandparent_uncle (parent, uncle, root);
+            else
+            {
+                if (is_left_child (new_node))
+                {
+                    right_rotate (parent);
+                    parent = new_node;
+                }
+
+                left_rotate (recolor_parent_grandparent (parent));
+                return false;
+            }
+        }
+
+        parent = new_node->parent_unsafe();
+    }
+
+    // Recoloring has reached the root: both its children have become black
+    return new_node == root;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ ERASURE FIXUP ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+template<typename Node_T, typename Rotor>
+Node_T *recolor_parent_sibling_and_rotate (Node_T *sibling_of_y, Rotor rotate)
+{
+    using color_type = typename Node_T::color_type;
+
+    assert (sibling_of_y);
+
+    auto parent_of_y = sibling_of_y->parent_unsafe();
+
+    sibling_of_y->set_color (color_type::black);
+    parent_of_y->set_color (color_type::red);
+    rotate (parent_of_y);
+
+    return parent_of_y;
+}
+
+template<typename Node_T, typename Rotor>
+Node_T *recolor_parent_sibling_nephew (Node_T *sibling_of_y, Node_T *l_nephew_of_y,
+                                       Node_T *r_nephew_of_y, Rotor l_rotate)
+{
+    using color_type = typename Node_T::color_type;
+
+    assert (sibling_of_y);
+    assert (l_nephew_of_y == sibling_of_y->get_left() ||
+            l_nephew_of_y == sibling_of_y->get_right());
+    assert (r_nephew_of_y == sibling_of_y->get_left() ||
+            r_nephew_of_y == sibling_of_y->get_right());
+    assert (is_red (l_nephew_of_y) || is_red (r_nephew_of_y));
+
+    if (is_red (l_nephew_of_y))
+        l_nephew_of_y->set_color (color_type::black);
+    else
+    {
+        /*
+         * is_red (r_nephew_of_y) ==> r_nephew_of_y != nullptr
+         *
+         * After the rotation old sibling becomes the outer nephew of y. It has to stay black
+         * (see the first branch), and r_nephew_of_y takes the color of parent_of_y below
+         */
+        l_rotate (sibling_of_y);
+
+        sibling_of_y = r_nephew_of_y;
+    }
+
+    auto parent_of_y = sibling_of_y->parent_unsafe();
+    sibling_of_y->set_color (parent_of_y->get_color());
+    parent_of_y->set_color (color_type::black);
+
+    return parent_of_y;
+}
+
+template<typename Node_T>
+bool recolor_parent_sibling (Node_T *root, Node_T *sibling_of_y) noexcept
+{
+    using color_type = typename Node_T::color_type;
+
+    assert (sibling_of_y);
+
+    sibling_of_y->set_color (color_type::red);
+
+    auto parent_of_y = sibling_of_y->parent_unsafe();
+    if (parent_of_y == root || parent_of_y->get_color() == color_type::red)
+    {
+        parent_of_y->set_color (color_type::black);
+        return true;
+    }
+
+    return false;
+}
+
+template<typename Node_T>
+void rb_erase_fixup (Node_T *root, Node_T *sibling_of_y)
+{
+    using color_type = typename Node_T::color_type;
+
+    assert (sibling_of_y);
+
+    auto l_rotate = [](Node_T *node){ left_rotate (node); };
+    auto r_rotate = [](Node_T *node){ right_rotate (node); };
+
+    while (true)
+    {
+        if (is_left_child (sibling_of_y))
+        {
+            if (sibling_of_y->get_color() == color_type::red)
+            {
+                auto parent_of_y = recolor_parent_sibling_and_rotate (sibling_of_y, r_rotate);
+
+                if (root == parent_of_y)
+                    root = sibling_of_y;
+
+                sibling_of_y = parent_of_y->get_left();
+            }
+
+            auto l_nephew_of_y = sibling_of_y->get_left();
+            auto r_nephew_of_y = sibling_of_y->get_right();
+            if (is_red (l_nephew_of_y) || is_red (r_nephew_of_y))
+            {
+                right_rotate (recolor_parent_sibling_nephew (sibling_of_y, l_nephew_of_y,
+                                                             r_nephew_of_y, l_rotate));
+                break;
+            }
+        }
+        else
+        {
+            if (sibling_of_y->get_color() == color_type::red)
+            {
+                auto parent_of_y = recolor_parent_sibling_and_rotate (sibling_of_y, l_rotate);
+
+                if (root == parent_of_y)
+                    root = sibling_of_y;
+
+                sibling_of_y = parent_of_y->get_right();
+            }
+
+            auto l_nephew_of_y = sibling_of_y->get_left();
+            auto r_nephew_of_y = sibling_of_y->get_right();
+            if (is_red (l_nephew_of_y) || is_red (r_nephew_of_y))
+            {
+                left_rotate (recolor_parent_sibling_nephew (sibling_of_y, r_nephew_of_y,
+                                                            l_nephew_of_y, r_rotate));
+                break;
+            }
+        }
+
+        if (recolor_parent_sibling (root, sibling_of_y))
+            break;
+
+        auto parent_of_y = sibling_of_y->parent_unsafe();
+
+        if (is_left_child (parent_of_y))
+            sibling_of_y = parent_of_y->parent_unsafe()->get_right();
+        else
+            sibling_of_y = parent_of_y->get_parent()->get_left();
+    }
+}
+
+template<typename Node_T>
+std::size_t black_height (const Node_T *root) noexcept
+{
+    using color_type = typename Node_T::color_type;
+
+    std::size_t height = 0;
+    for (; root; root = root->get_left())
+        height += (root->get_color() == color_type::black);
+
+    return height;
+}
+
+/*
+ * Joins left, pivot and right into one tree. All keys of left have to be less than the key of
+ * pivot and all keys of right have to be greater than it. The pivot is hung on the spine of the
+ * higher tree at the black node of the same black height as the lower tree and then the usual
+ * insertion fixup is run. Takes O(|left.rank - right.rank| + 1) time.
+ */
+template<typename Balance_T, typename Node_T>
+Subtree<Node_T, Balance_T> rb_join (Subtree<Node_T, Balance_T> left, Node_T *pivot,
+                                    Subtree<Node_T, Balance_T> right) noexcept
+{
+    using color_type = typename Node_T::color_type;
+
+    assert (pivot);
+
+    if (left.rank == right.rank)
+    {
+        link_pivot (pivot, left.root, right.root);
+        pivot->set_color (color_type::black);
+
+        return {pivot, left.rank + 1};
+    }
+
+    // Rotations and fixup need the root to have a parent
+    typename Node_T::end_node_type sentinel{};
+
+    auto higher = (left.rank > right.rank) ? left : right;
+    auto lower = (left.rank > right.rank) ? right : left;
+    auto go_right = (higher.root == left.root);
+
+    sentinel.set_left (higher.root);
+    higher.root->set_parent (std::addressof (sentinel));
+
+    // Black height of a child equals black height of its parent minus 1 if the parent is black
+    auto parent = higher.root;
+    auto node = higher.root;
+    auto height = higher.rank;
+    do
+    {
+        parent = node;
+        height -= (parent->get_color() == color_type::black);
+        node = go_right ? parent->get_right() : parent->get_left();
+    }
+    while (node && !(node->get_color() == color_type::black && height == lower.rank));
+
+    if (go_right)
+    {
+        link_pivot (pivot, node, lower.root);
+        parent->set_right (pivot);
+    }
+    else
+    {
+        link_pivot (pivot, lower.root, node);
+        parent->set_left (pivot);
+    }
+
+    pivot->set_parent (parent);
+    pivot->set_color (color_type::red);
+
+    for (auto n = parent; n != std::addressof (sentinel); n = n->parent_unsafe())
+    {
+        n->subtree_size_ += Node_T::size (lower.root) + 1;
+        n->update_aggregate();
+    }
+
+    auto grown = rb_insert_fixup (sentinel.get_left(), pivot);
+
+    auto root = sentinel.get_left();
+    root->set_parent (nullptr);
+
+    return {root, higher.rank + grown};
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ AVL AND WAVL ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+template<typename Node_T>
+bool has_odd_height (const Node_T *node) noexcept { return is_red (node); }
+
+// Promotes or demotes node by 1
+template<typename Node_T>
+void flip_height (Node_T *node) noexcept
+{
+    node->set_color (is_red (node) ? RB_Color::black : RB_Color::red);
+}
+
+template<typename Node_T>
+void set_height (Node_T *node, std::size_t height) noexcept
+{
+    node->set_color ((height % 2) ? RB_Color::red : RB_Color::black);
+}
+
+// Tells 1 from 2 (and 0 from 1, and 3 from 2) as the difference between heights of parent and child
+template<typename Node_T>
+bool is_odd_difference (const Node_T *parent, const Node_T *child) noexcept
+{
+    return has_odd_height (parent) != has_odd_height (child);
+}
+
+template<typename Node_T>
+std::size_t child_height (std::size_t parent_height, const Node_T *child) noexcept
+{
+    return parent_height - ((parent_height % 2 != has_odd_height (child)) ? 1 : 2);
+}
+
+template<typename Node_T>
+std::size_t height_of (const Node_T *root) noexcept
+{
+    std::size_t height = 0;
+    for (; root; root = root->get_left())
+        height += is_odd_difference (root, root->get_left()) ? 1 : 2;
+
+    return height;
+}
+
+/*
+ * x has grown by 1, so it may be as high as its parent. While it is so, either the parent grows
+ * too, or a rotation makes the subtree of the parent balanced and keeps its height. Insertion and
+ * the last step of join are the same for AVL and WAVL trees. Returns true if the tree has grown
+ */
+template<typename Node_T>
+bool rank_insert_fixup (const typename Node_T::end_node_type *top, Node_T *x) noexcept
+{
+    while (x->get_parent() != top)
+    {
+        auto parent = x->parent_unsafe();
+        if (is_odd_difference (parent, x))
+            return false;
+
+        auto x_is_left = is_left_child (x);
+        auto sibling = x_is_left ? parent->get_right() : parent->get_left();
+
+        if (is_odd_difference (parent, sibling))
+        {
+            flip_height (parent);
+            x = parent;
+
+            continue;
+        }
+
+        // The sibling is lower than the parent by 2
+        auto inner = x_is_left ? x->get_right() : x->get_left();
+        auto outer = x_is_left ? x->get_left() : x->get_right();
+
+        if (is_odd_difference (x, inner) && is_odd_difference (x, outer))
+        {
+            // Only join makes such x. It goes up and grows by 1 more, the parent keeps its height
+            rotate_up (x);
+            flip_height (x);
+        }
+        else if (is_odd_difference (x, outer))
+        {
+            rotate_up (x);
+            flip_height (parent);
+
+            return false;
+        }
+        else
+        {
+            rotate_up (inner);
+            rotate_up (inner);
+
+            flip_height (inner);
+            flip_height (x);
+            flip_height (parent);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * The child of parent on the side of removal.is_left has become lower by 1. AVL trees have no
+ * nodes with both children lower by 2, so such nodes are demoted and rotations may be needed on
+ * every level up to the root
+ */
+template<typename Node_T>
+void avl_erase_fixup (const Removal<Node_T> &removal) noexcept
+{
+    auto top = removal.root->get_parent();
+    if (removal.parent == top)
+        return;
+
+    auto parent = static_cast<Node_T *>(removal.parent);
+    auto is_left = removal.is_left;
+
+    while (true)
+    {
+        auto x = is_left ? parent->get_left() : parent->get_right();
+        auto sibling = is_left ? parent->get_right() : parent->get_left();
+        Node_T *subtree_root;
+
+        if (!is_odd_difference (parent, x)) // x is lower than parent by 2
+        {
+            if (is_odd_difference (parent, sibling))
+                return;
+
+            flip_height (parent);
+            subtree_root = parent;
+        }
+        else // x is lower than parent by 3, the sibling is lower by 1
+        {
+            auto inner = is_left ? sibling->get_left() : sibling->get_right();
+            auto outer = is_left ? sibling->get_right() : sibling->get_left();
+
+            if (is_odd_difference (sibling, outer))
+            {
+                rotate_up (sibling);
+
+                if (is_odd_difference (sibling, inner))
+                {
+                    // The subtree keeps its height
+                    flip_height (sibling);
+                    flip_height (parent);
+
+                    return;
+                }
+
+                // The parent is demoted twice
+                subtree_root = sibling;
+            }
+            else
+            {
+                rotate_up (inner);
+                rotate_up (inner);
+
+                // inner is promoted, the sibling is demoted and the parent is demoted twice
+                flip_height (inner);
+                flip_height (sibling);
+                subtree_root = inner;
+            }
+        }
+
+        if (subtree_root->get_parent() == top)
+            return;
+
+        is_left = is_left_child (subtree_root);
+        parent = subtree_root->parent_unsafe();
+    }
+}
+
+/*
+ * The same as avl_erase_fixup() but WAVL trees allow nodes with both children lower by 2 (except
+ * leaves), so rebalancing stops after the first rotation
+ */
+template<typename Node_T>
+void wavl_erase_fixup (const Removal<Node_T> &removal) noexcept
+{
+    auto top = removal.root->get_parent();
+    if (removal.parent == top)
+        return;
+
+    auto parent = static_cast<Node_T *>(removal.parent);
+    auto is_left = removal.is_left;
+
+    while (true)
+    {
+        auto x = is_left ? parent->get_left() : parent->get_right();
+        auto sibling = is_left ? parent->get_right() : parent->get_left();
+
+        if (!is_odd_difference (parent, x)) // x is lower than parent by 2
+        {
+            if (parent->get_left() || parent->get_right())
+                return;
+
+            // Leaves have height 1
+            flip_height (parent);
+        }
+        else if (!is_odd_difference (parent, sibling)) // x is lower by 3, the sibling by 2
+            flip_height (parent);
+        else
+        {
+            auto inner = is_left ? sibling->get_left() : sibling->get_right();
+            auto outer = is_left ? sibling->get_right() : sibling->get_left();
+
+            if (!is_odd_difference (sibling, inner) && !is_odd_difference (sibling, outer))
+            {
+                flip_height (parent);
+                flip_height (sibling);
+            }
+            else if (is_odd_difference (sibling, outer))
+            {
+                rotate_up (sibling);
+                flip_height (sibling);
+
+                // The parent is demoted once or twice if it has become a leaf
+                if (parent->get_left() || parent->get_right())
+                    flip_height (parent);
+
+                return;
+            }
+            else
+            {
+                rotate_up (inner);
+                rotate_up (inner);
+
+                // inner is promoted twice, the sibling is demoted and the parent is demoted twice
+                flip_height (sibling);
+
+                return;
+            }
+        }
+
+        if (parent->get_parent() == top)
+            return;
+
+        is_left = is_left_child (parent);
+        parent = parent->parent_unsafe();
+    }
+}
+
+/*
+ * The pivot is hung on the spine of the higher tree above the first node that isn't higher than
+ * the lower tree by more than 1, and then the insertion fixup is run. Takes
+ * O(|left.rank - right.rank| + 1) time
+ */
+template<typename Balance_T, typename Node_T>
+Subtree<Node_T, Balance_T> rank_join (Subtree<Node_T, Balance_T> left, Node_T *pivot,
+                                      Subtree<Node_T, Balance_T> right) noexcept
+{
+    assert (pivot);
+
+    auto higher = (left.rank > right.rank) ? left : right;
+    auto lower = (left.rank > right.rank) ? right : left;
+
+    if (higher.rank <= lower.rank + 1)
+    {
+        link_pivot (pivot, left.root, right.root);
+        set_height (pivot, higher.rank + 1);
+
+        return {pivot, higher.rank + 1};
+    }
+
+    // Rotations and fixup need the root to have a parent
+    typename Node_T::end_node_type sentinel{};
+
+    auto go_right = (higher.root == left.root);
+
+    sentinel.set_left (higher.root);
+    higher.root->set_parent (std::addressof (sentinel));
+
+    auto parent = higher.root;
+    auto node = go_right ? parent->get_right() : parent->get_left();
+    auto height = child_height (higher.rank, node);
+
+    while (height > lower.rank + 1)
+    {
+        parent = node;
+        node = go_right ? parent->get_right() : parent->get_left();
+        height = child_height (height, node);
+    }
+
+    if (go_right)
+    {
+        link_pivot (pivot, node, lower.root);
+        parent->set_right (pivot);
+    }
+    else
+    {
+        link_pivot (pivot, lower.root, node);
+        parent->set_left (pivot);
+    }
+
+    pivot->set_parent (parent);
+    set_height (pivot, height + 1);
+
+    for (auto n = parent; n != std::addressof (sentinel); n = n->parent_unsafe())
+    {
+        n->subtree_size_ += Node_T::size (lower.root) + 1;
+        n->update_aggregate();
+    }
+
+    auto grown = rank_insert_fixup (std::addressof (sentinel), pivot);
+
+    auto root = sentinel.get_left();
+    root->set_parent (nullptr);
+
+    return {root, higher.rank + grown};
+}
+
+// Returns the height of the subtree of node plus 1 or 0 if the subtree isn't balanced
+template<bool Is_AVL, typename Node_T>
+std::size_t rank_verifier (const Node_T *node) noexcept
+{
+    if (node == nullptr)
+        return 1;
+
+    auto left = node->get_left();
+    auto right = node->get_right();
+
+    if ((left && left->get_parent() != node) ||
+        (right && right->get_parent() != node))
+        return 0;
+
+    auto left_height = rank_verifier<Is_AVL>(left);
+    auto right_height = rank_verifier<Is_AVL>(right);
+    if (left_height == 0 || right_height == 0)
+        return 0;
+
+    // Parity of the height of node gives the difference with the height of the left child
+    auto height = left_height + (is_odd_difference (node, left) ? 1 : 2);
+
+    if (height <= right_height || height - right_height > 2)
+        return 0;
+
+    if constexpr (Is_AVL)
+    {
+        if (height != std::max (left_height, right_height) + 1)
+            return 0;
+    }
+    else if (!left && !right && height != 2)
+        return 0;
+
+    return height;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ TREAP ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+// The finalizer of splitmix64. It is a bijection, so different nodes have different priorities
+inline std::uint64_t treap_priority (const void *node) noexcept
+{
+    auto z = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(node));
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+
+    return z ^ (z >> 31);
+}
+
+// Moves node down while one of its children has a greater priority
+template<typename Node_T>
+void treap_sift_down (Node_T *node) noexcept
+{
+    while (true)
+    {
+        auto child = node->get_left();
+        if (auto right = node->get_right();
+            right && (!child || treap_priority (child) < treap_priority (right)))
+            child = right;
+
+        if (!child || treap_priority (child) < treap_priority (node))
+            return;
+
+        rotate_up (child);
+    }
+}
+
+template<typename Balance_T, typename Node_T>
+Subtree<Node_T, Balance_T> treap_join (Subtree<Node_T, Balance_T> left, Node_T *pivot,
+                                       Subtree<Node_T, Balance_T> right) noexcept
+{
+    assert (pivot);
+
+    // Rotations need the root to have a parent
+    typename Node_T::end_node_type sentinel{};
+
+    link_pivot (pivot, left.root, right.root);
+    sentinel.set_left (pivot);
+    pivot->set_parent (std::addressof (sentinel));
+
+    treap_sift_down (pivot);
+
+    auto root = sentinel.get_left();
+    root->set_parent (nullptr);
+
+    return {root, 0};
+}
+
+// Links nodes of the subtree of node in order through their right children before head
+template<typename Node_T>
+void thread_in_order (Node_T *node, Node_T *&head) noexcept
+{
+    if (node == nullptr)
+        return;
+
+    thread_in_order (node->get_right(), head);
+
+    auto left = node->get_left();
+    node->set_left (nullptr);
+    node->set_right (std::exchange (head, node));
+
+    thread_in_order (left, head);
+}
+
+/*
+ * Rebuilds a tree in heap order of priorities of its nodes in O(n) time. Nodes are taken in order
+ * and every one is put at the bottom of the right spine of the tree built so far, so the nodes of
+ * the spine with lower priorities become its left subtree. The spine is a stack linked through
+ * parent pointers
+ */
+template<typename Node_T>
+Node_T *treap_rebuild (Node_T *root) noexcept
+{
+    Node_T *head = nullptr;
+    thread_in_order (root, head);
+
+    auto finish = [](Node_T *node)
+    {
+        node->subtree_size_ = 1 + Node_T::size (node->get_left())
+                                + Node_T::size (node->get_right());
+        node->update_aggregate();
+    };
+
+    root = nullptr;
+    Node_T *spine = nullptr; // The lowest node of the right spine
+
+    for (auto node = head; node;)
+    {
+        auto next = node->get_right();
+        node->set_right (nullptr);
+
+        Node_T *left = nullptr;
+        while (spine && treap_priority (spine) < treap_priority (node))
+        {
+            finish (spine);
+            left = spine;
+            spine = (spine == root) ? nullptr : spine->parent_unsafe();
+        }
+
+        node->set_left (left);
+        if (left)
+            left->set_parent (node);
+
+        if (spine)
+        {
+            spine->set_right (node);
+            node->set_parent (spine);
+        }
+        else
+            root = node;
+
+        spine = node;
+        node = next;
+    }
+
+    for (; spine; spine = (spine == root) ? nullptr : spine->parent_unsafe())
+        finish (spine);
+
+    return root;
+}
+
+template<typename Node_T>
+bool treap_verifier (const Node_T *node) noexcept
+{
+    if (node == nullptr)
+        return true;
+
+    for (auto child : {node->get_left(), node->get_right()})
+    {
+        if (child && (child->get_parent() != node ||
+                      treap_priority (node) < treap_priority (child)))
+            return false;
+    }
+
+    return treap_verifier (node->get_left()) && treap_verifier (node->get_right());
+}
+
+} // namespace detail
+
+struct Red_Black_Balance
+{
+    template<typename Node_T>
+    static bool insert_fixup (const Node_T *root, Node_T *node) noexcept
+    {
+        return detail::rb_insert_fixup (root, node);
+    }
+
+    template<typename Node_T>
+    static void erase_prepare (Node_T *) noexcept {}
+
+    template<typename Node_T>
+    static void erase_fixup (const detail::Removal<Node_T> &removal) noexcept
+    {
+        if (removal.y_original_color == RB_Color::black && removal.root)
+        {
+            if (removal.child_of_y)
+                removal.child_of_y->set_color (RB_Color::black);
+            else
+                detail::rb_erase_fixup (removal.root, removal.sibling_of_y);
+        }
+    }
+
+    template<typename Node_T>
+    static std::size_t rank (const Node_T *root) noexcept { return detail::black_height (root); }
+
+    // The parent has to be black
+    template<typename Node_T>
+    static std::size_t detach_child (Node_T *child, std::size_t parent_rank) noexcept
+    {
+        if (detail::is_red (child))
+        {
+            child->set_color (RB_Color::black);
+            return parent_rank;
+        }
+
+        return parent_rank - 1;
+    }
+
+    template<typename Node_T>
+    static detail::Subtree<Node_T, Red_Black_Balance> join (
+        detail::Subtree<Node_T, Red_Black_Balance> left, Node_T *pivot,
+        detail::Subtree<Node_T, Red_Black_Balance> right) noexcept
+    {
+        return detail::rb_join (left, pivot, right);
+    }
+
+    // Every node is black except the nodes of the incomplete last level which are red
+    static RB_Color build_color (std::size_t depth, std::size_t n, std::size_t total) noexcept
+    {
+        (void)n;
+
+        auto red_depth = std::has_single_bit (total + 1) ? std::numeric_limits<std::size_t>::max()
+                                                         : std::bit_width (total) - 1;
+
+        return (depth == red_depth) ? RB_Color::red : RB_Color::black;
+    }
+
+    template<typename Node_T>
+    static Node_T *settle (Node_T *root) noexcept { return root; }
+
+    template<typename Node_T>
+    static bool verifier (const Node_T *root) noexcept
+    {
+        return root == nullptr ||
+               (root->get_color() == RB_Color::black && detail::red_black_verifier (root) != 0);
+    }
+};
+
+namespace detail
+{
+
+// AVL_Balance and WAVL_Balance differ only in erasure
+template<typename Balance_T, bool Is_AVL>
+struct Rank_Balance
+{
+    template<typename Node_T>
+    static bool insert_fixup (const Node_T *root, Node_T *node) noexcept
+    {
+        return rank_insert_fixup (root->get_parent(), node);
+    }
+
+    template<typename Node_T>
+    static void erase_prepare (Node_T *) noexcept {}
+
+    template<typename Node_T>
+    static void erase_fixup (const Removal<Node_T> &removal) noexcept
+    {
+        if (removal.root == nullptr)
+            return;
+
+        if constexpr (Is_AVL)
+            avl_erase_fixup (removal);
+        else
+            wavl_erase_fixup (removal);
+    }
+
+    template<typename Node_T>
+    static std::size_t rank (const Node_T *root) noexcept { return height_of (root); }
+
+    template<typename Node_T>
+    static std::size_t detach_child (Node_T *child, std::size_t parent_rank) noexcept
+    {
+        return child_height (parent_rank, child);
+    }
+
+    template<typename Node_T>
+    static Subtree<Node_T, Balance_T> join (Subtree<Node_T, Balance_T> left, Node_T *pivot,
+                                            Subtree<Node_T, Balance_T> right) noexcept
+    {
+        return rank_join (left, pivot, right);
+    }
+
+    // The height of a perfectly balanced subtree depends only on its size
+    static RB_Color build_color (std::size_t depth, std::size_t n, std::size_t total) noexcept
+    {
+        (void)depth;
+        (void)total;
+
+        return (std::bit_width (n) % 2) ? RB_Color::red : RB_Color::black;
+    }
+
+    template<typename Node_T>
+    static Node_T *settle (Node_T *root) noexcept { return root; }
+
+    template<typename Node_T>
+    static bool verifier (const Node_T *root) noexcept
+    {
+        return rank_verifier<Is_AVL>(root) != 0;
+    }
+};
+
+} // namespace detail
+
+struct AVL_Balance : detail::Rank_Balance<AVL_Balance, true> {};
+
+struct WAVL_Balance : detail::Rank_Balance<WAVL_Balance, false> {};
+
+struct Treap_Balance
+{
+    template<typename Node_T>
+    static bool insert_fixup (const Node_T *root, Node_T *node) noexcept
+    {
+        auto top = root->get_parent();
+
+        while (node->get_parent() != top &&
+               detail::treap_priority (node->parent_unsafe()) < detail::treap_priority (node))
+            detail::rotate_up (node);
+
+        return false;
+    }
+
+    // Rotates z down until it has at most one child, so that it's replaced by that child only
+    template<typename Node_T>
+    static void erase_prepare (Node_T *z) noexcept
+    {
+        while (z->get_left() && z->get_right())
+        {
+            auto left = z->get_left();
+            auto right = z->get_right();
+
+            detail::rotate_up (detail::treap_priority (left) < detail::treap_priority (right)
+                               ? right : left);
+        }
+    }
+
+    // z has no successor to take its place, so heap order holds
+    template<typename Node_T>
+    static void erase_fixup ([[maybe_unused]] const detail::Removal<Node_T> &removal) noexcept
+    {
+        assert (removal.y == removal.z);
+    }
+
+    template<typename Node_T>
+    static std::size_t rank (const Node_T *) noexcept { return 0; }
+
+    template<typename Node_T>
+    static std::size_t detach_child (Node_T *, std::size_t) noexcept { return 0; }
+
+    template<typename Node_T>
+    static detail::Subtree<Node_T, Treap_Balance> join (
+        detail::Subtree<Node_T, Treap_Balance> left, Node_T *pivot,
+        detail::Subtree<Node_T, Treap_Balance> right) noexcept
+    {
+        return detail::treap_join (left, pivot, right);
+    }
+
+    static RB_Color build_color (std::size_t, std::size_t, std::size_t) noexcept
+    {
+        return RB_Color::black;
+    }
+
+    template<typename Node_T>
+    static Node_T *settle (Node_T *root) noexcept { return detail::treap_rebuild (root); }
+
+    template<typename Node_T>
+    static bool verifier (const Node_T *root) noexcept { return detail::treap_verifier (root); }
+};
+
+} // namespace yLab
+
+#endif // INCLUDE_BALANCING_HPP
@@ -0,0 +1,1129 @@
+/*
+ * This header contains implementation of BPlus_Tree, an order-statistic B+-tree with the same
+ * set API as ARB_Tree.
+ *
+ * Keys are kept in leaves of up to Node_Capacity keys. Leaves are linked in both directions for
+ * iteration. An internal node has up to Node_Capacity children, a separator for every child but
+ * the first one and the number of keys in the subtree of every child. A separator is not greater
+ * than all keys of its child and is greater than all keys of the previous one. Every node but the
+ * root is at least half full, so all leaves are at the same depth of O(log n / log Node_Capacity).
+ *
+ * operator[] and n_less_than() descend from the root once and scan the counts and the separators
+ * of one node per level. Those arrays are contiguous, so a level costs a few cache lines instead
+ * of a cache miss per binary level in ARB_Tree.
+ *
+ * Unlike in ARB_Tree, insertion and erasure invalidate all iterators, since keys move between
+ * nodes. Keys have to be default-initializable.
+ *
+ * If insertion throws, the tree is left unchanged: the key is looked up, copied and all the nodes
+ * that splits may need are allocated before anything is modified. Moves of keys mustn't throw.
+ */
+
+#ifndef INCLUDE_BPLUS_TREE_HPP
+#define INCLUDE_BPLUS_TREE_HPP
+
+#include <cstddef>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <array>
+#include <iterator>
+#include <utility>
+#include <algorithm>
+#include <concepts>
+#include <compare>
+#include <numeric>
+#include <initializer_list>
+#include <limits>
+#include <tuple>
+
+namespace yLab
+{
+
+template<typename Key_T, typename Compare = std::less<Key_T>,
+         typename Allocator = std::allocator<Key_T>, std::size_t Node_Capacity = 32>
+class BPlus_Tree final
+{
+    static_assert (Node_Capacity >= 4, "Nodes have to hold at least 4 keys");
+    static_assert (std::default_initializable<Key_T>, "Nodes store keys in arrays");
+
+public:
+
+    using key_type = Key_T;
+    using key_compare = Compare;
+    using value_type = key_type;
+    using value_compare = Compare;
+    using allocator_type = Allocator;
+    using reference = value_type &;
+    using const_reference = const value_type &;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    static constexpr size_type node_capacity = Node_Capacity;
+
+private:
+
+    static constexpr size_type min_occupancy = Node_Capacity / 2;
+
+    struct Node {};
+
+    struct Leaf : Node
+    {
+        size_type n_keys_ = 0;
+        Leaf *prev_ = nullptr;
+        Leaf *next_ = nullptr;
+        std::array<key_type, Node_Capacity> keys_;
+    };
+
+    struct Internal : Node
+    {
+        size_type n_children_ = 0;
+        std::array<key_type, Node_Capacity - 1> separators_; // separators_[i] is for child i + 1
+        std::array<Node *, Node_Capacity> children_;
+        std::array<size_type, Node_Capacity> counts_;
+    };
+
+    using alloc_traits = std::allocator_traits<Allocator>;
+    using leaf_allocator_type = typename alloc_traits::template rebind_alloc<Leaf>;
+    using internal_allocator_type = typename alloc_traits::template rebind_alloc<Internal>;
+    using leaf_alloc_traits = std::allocator_traits<leaf_allocator_type>;
+    using internal_alloc_traits = std::allocator_traits<internal_allocator_type>;
+
+    // A node that has been split off a full one, to be linked right after it
+    struct Split
+    {
+        Node *right = nullptr;
+        key_type separator{};
+        size_type count = 0;
+    };
+
+    // Internal nodes have at least 2 children, so a tree of size_type keys can't be higher
+    static constexpr size_type max_height = std::numeric_limits<size_type>::digits;
+
+    // An internal node on the way from the root to a leaf and the index of the child taken
+    struct Step
+    {
+        Internal *node;
+        size_type child;
+    };
+
+    using Path = std::array<Step, max_height + 1>;
+
+    // Nodes that an insertion may split off, allocated before the tree is changed. Those that
+    // are left unused are destroyed
+    class Node_Reserve final
+    {
+        BPlus_Tree &tree_;
+        Leaf *leaf_ = nullptr;
+        std::array<Internal *, max_height> internals_;
+        size_type n_internals_ = 0;
+
+    public:
+
+        explicit Node_Reserve (BPlus_Tree &tree) noexcept : tree_{tree} {}
+
+        Node_Reserve (const Node_Reserve &rhs) = delete;
+        Node_Reserve &operator= (const Node_Reserve &rhs) = delete;
+
+        ~Node_Reserve ()
+        {
+            if (leaf_)
+                tree_.destroy_leaf (leaf_);
+
+            while (n_internals_ != 0)
+                tree_.destroy_internal (internals_[--n_internals_]);
+        }
+
+        void push (Leaf *leaf) noexcept { leaf_ = leaf; }
+        void push (Internal *internal) noexcept { internals_[n_internals_++] = internal; }
+
+        Leaf *take_leaf () noexcept
+        {
+            assert (leaf_);
+            return std::exchange (leaf_, nullptr);
+        }
+
+        Internal *take_internal () noexcept
+        {
+            assert (n_internals_ != 0);
+            return internals_[--n_internals_];
+        }
+    };
+
+    Node *root_ = nullptr;
+    size_type height_ = 0; // 0 for an empty tree, 1 if the root is a leaf
+    size_type size_ = 0;
+    Leaf *first_leaf_ = nullptr;
+    Leaf *last_leaf_ = nullptr;
+
+    [[no_unique_address]] leaf_allocator_type leaf_alloc_;
+    [[no_unique_address]] internal_allocator_type internal_alloc_;
+    Compare comp_;
+
+public:
+
+    class const_iterator final
+    {
+        const Leaf *leaf_ = nullptr;
+        size_type index_ = 0;
+
+        friend class BPlus_Tree;
+
+        const_iterator (const Leaf *leaf, size_type index) noexcept : leaf_{leaf}, index_{index}
+        {
+            // The position after the last key of a leaf is the first key of the next one
+            if (leaf_ && index_ == leaf_->n_keys_ && leaf_->next_)
+            {
+                leaf_ = leaf_->next_;
+                index_ = 0;
+            }
+        }
+
+    public:
+
+        using iterator_category = std::bidirectional_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = Key_T;
+        using reference = const value_type &;
+        using pointer = const value_type *;
+
+        const_iterator () = default;
+
+        reference operator* () const noexcept { return leaf_->keys_[index_]; }
+        pointer operator-> () const noexcept { return std::addressof (**this); }
+
+        const_iterator &operator++ () noexcept
+        {
+            if (++index_ == leaf_->n_keys_ && leaf_->next_)
+            {
+                leaf_ = leaf_->next_;
+                index_ = 0;
+            }
+
+            return *this;
+        }
+
+        const_iterator operator++ (int) noexcept
+        {
+            auto tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        const_iterator &operator-- () noexcept
+        {
+            if (index_ == 0)
+            {
+                leaf_ = leaf_->prev_;
+                index_ = leaf_->n_keys_;
+            }
+
+            --index_;
+            return *this;
+        }
+
+        const_iterator operator-- (int) noexcept
+        {
+            auto tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
+        bool operator== (const const_iterator &rhs) const noexcept
+        {
+            return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+        }
+    };
+
+    using iterator = const_iterator;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    BPlus_Tree () : BPlus_Tree{key_compare{}} {}
+
+    explicit BPlus_Tree (const key_compare &comp, const allocator_type &alloc = allocator_type{})
+                        : leaf_alloc_{alloc}, internal_alloc_{alloc}, comp_{comp} {}
+
+    explicit BPlus_Tree (const allocator_type &alloc) : BPlus_Tree{key_compare{}, alloc} {}
+
+    template<std::input_iterator it>
+    BPlus_Tree (it first, it last, const key_compare &comp = key_compare{},
+                const allocator_type &alloc = allocator_type{})
+               : BPlus_Tree{comp, alloc}
+    {
+        insert (first, last);
+    }
+
+    BPlus_Tree (std::initializer_list<value_type> ilist, const key_compare &comp = key_compare{},
+                const allocator_type &alloc = allocator_type{})
+               : BPlus_Tree{ilist.begin(), ilist.end(), comp, alloc} {}
+
+    BPlus_Tree (const BPlus_Tree &rhs)
+               : BPlus_Tree{rhs.comp_, alloc_traits::select_on_container_copy_construction (
+                                           rhs.get_allocator())}
+    {
+        if (rhs.root_)
+        {
+            Leaf *prev_leaf = nullptr;
+            root_ = clone_subtree (rhs.root_, rhs.height_, prev_leaf);
+            last_leaf_ = prev_leaf;
+            height_ = rhs.height_;
+            size_ = rhs.size_;
+        }
+    }
+
+    BPlus_Tree (BPlus_Tree &&rhs) noexcept
+               : root_{std::exchange (rhs.root_, nullptr)},
+                 height_{std::exchange (rhs.height_, 0)},
+                 size_{std::exchange (rhs.size_, 0)},
+                 first_leaf_{std::exchange (rhs.first_leaf_, nullptr)},
+                 last_leaf_{std::exchange (rhs.last_leaf_, nullptr)},
+                 leaf_alloc_{rhs.leaf_alloc_}, internal_alloc_{rhs.internal_alloc_},
+                 comp_{rhs.comp_} {}
+
+    BPlus_Tree &operator= (const BPlus_Tree &rhs)
+    {
+        if (this != &rhs)
+        {
+            auto tmp = rhs;
+            swap (tmp);
+        }
+
+        return *this;
+    }
+
+    BPlus_Tree &operator= (BPlus_Tree &&rhs) noexcept
+    {
+        swap (rhs);
+        return *this;
+    }
+
+    ~BPlus_Tree () { clear(); }
+
+    // Observers
+
+    allocator_type get_allocator () const { return allocator_type{leaf_alloc_}; }
+    const key_compare &key_comp () const { return comp_; }
+    const value_compare &value_comp () const { return comp_; }
+
+    // Capacity
+
+    size_type size () const noexcept { return size_; }
+    bool empty () const noexcept { return size_ == 0; }
+
+    // Depth of leaves; 0 for an empty tree
+    size_type height () const noexcept { return height_; }
+
+    // Iterators
+
+    const_iterator begin () const noexcept { return const_iterator{first_leaf_, 0}; }
+
+    const_iterator end () const noexcept
+    {
+        return const_iterator{last_leaf_, last_leaf_ ? last_leaf_->n_keys_ : 0};
+    }
+
+    const_iterator cbegin () const noexcept { return begin(); }
+    const_iterator cend () const noexcept { return end(); }
+
+    const_reverse_iterator rbegin () const noexcept { return const_reverse_iterator{end()}; }
+    const_reverse_iterator rend () const noexcept { return const_reverse_iterator{begin()}; }
+    const_reverse_iterator crbegin () const noexcept { return rbegin(); }
+    const_reverse_iterator crend () const noexcept { return rend(); }
+
+    // Modifiers
+
+    void swap (BPlus_Tree &other) noexcept
+    {
+        using std::swap;
+
+        swap (root_, other.root_);
+        swap (height_, other.height_);
+        swap (size_, other.size_);
+        swap (first_leaf_, other.first_leaf_);
+        swap (last_leaf_, other.last_leaf_);
+        swap (leaf_alloc_, other.leaf_alloc_);
+        swap (internal_alloc_, other.internal_alloc_);
+        swap (comp_, other.comp_);
+    }
+
+    void clear ()
+    {
+        if (root_)
+            destroy_subtree (root_, height_);
+
+        root_ = nullptr;
+        first_leaf_ = last_leaf_ = nullptr;
+        height_ = size_ = 0;
+    }
+
+    std::pair<iterator, bool> insert (const key_type &key)
+    {
+        Path path;
+        auto [leaf, pos] = find_position_to_insert (key, path);
+
+        if (leaf && pos != leaf->n_keys_ && !comp_(key, leaf->keys_[pos]))
+            return std::pair{iterator{leaf, pos}, false};
+
+        // Everything that may throw is done before the tree is changed: the key and the
+        // separator are copied and the nodes split off on the way up are allocated in advance
+        key_type new_key = key;
+
+        if (root_ == nullptr)
+        {
+            auto root = make_leaf();
+            root->keys_[0] = std::move (new_key);
+            root->n_keys_ = 1;
+
+            root_ = first_leaf_ = last_leaf_ = root;
+            height_ = size_ = 1;
+
+            assert (verifier());
+            return std::pair{iterator{root, 0}, true};
+        }
+
+        Split split;
+        Node_Reserve reserve{*this};
+
+        if (leaf->n_keys_ == Node_Capacity)
+        {
+            split.separator = leaf->keys_[Node_Capacity / 2];
+            reserve.push (make_leaf());
+
+            // Every full ancestor is split too. If all of them are, the tree grows a new root
+            auto level = size_type{2};
+            for (; level <= height_ && path[level].node->n_children_ == Node_Capacity; ++level)
+                reserve.push (make_internal());
+
+            if (level > height_)
+                reserve.push (make_internal());
+        }
+
+        std::tie (leaf, pos) = insert_into_leaf (leaf, pos, std::move (new_key), split, reserve);
+
+        for (auto level = size_type{2}; level <= height_; ++level)
+        {
+            auto [internal, i] = path[level];
+            ++internal->counts_[i];
+
+            if (split.right)
+            {
+                internal->counts_[i] -= split.count;
+
+                Split parent_split;
+                insert_child (internal, i + 1, std::move (split), parent_split, reserve);
+                split = std::move (parent_split);
+            }
+        }
+
+        if (split.right)
+        {
+            auto new_root = reserve.take_internal();
+
+            new_root->n_children_ = 2;
+            new_root->children_[0] = root_;
+            new_root->children_[1] = split.right;
+            new_root->separators_[0] = std::move (split.separator);
+            new_root->counts_[0] = size_ + 1 - split.count;
+            new_root->counts_[1] = split.count;
+
+            root_ = new_root;
+            ++height_;
+        }
+
+        ++size_;
+
+        assert (verifier());
+        return std::pair{iterator{leaf, pos}, true};
+    }
+
+    template<std::input_iterator it>
+    void insert (it first, it last)
+    {
+        for (; first != last; ++first)
+            insert (*first);
+    }
+
+    void insert (std::initializer_list<value_type> ilist) { insert (ilist.begin(), ilist.end()); }
+
+    template<typename... Args>
+    std::pair<iterator, bool> emplace (Args &&... args)
+    {
+        return insert (key_type(std::forward<Args>(args)...));
+    }
+
+    size_type erase (const key_type &key)
+    {
+        if (root_ == nullptr || !erase_impl (root_, height_, key))
+            return 0;
+
+        --size_;
+        shrink_root();
+
+        assert (verifier());
+        return 1;
+    }
+
+    // Returns the iterator following the erased key
+    iterator erase (const_iterator pos)
+    {
+        assert (pos != end());
+
+        auto key = *pos;
+        erase (key);
+
+        return upper_bound (key);
+    }
+
+    // Lookup
+
+    const_iterator find (const key_type &key) const
+    {
+        auto it = lower_bound (key);
+        return (it == end() || comp_(key, *it)) ? end() : it;
+    }
+
+    bool contains (const key_type &key) const { return find (key) != end(); }
+    size_type count (const key_type &key) const { return contains (key); }
+
+    const_iterator lower_bound (const key_type &key) const
+    {
+        auto leaf = find_leaf (key);
+        if (leaf == nullptr)
+            return end();
+
+        return const_iterator{leaf, leaf_lower_bound (leaf, key)};
+    }
+
+    const_iterator upper_bound (const key_type &key) const
+    {
+        auto leaf = find_leaf (key);
+        if (leaf == nullptr)
+            return end();
+
+        return const_iterator{leaf, leaf_upper_bound (leaf, key)};
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range (const key_type &key) const
+    {
+        auto first = lower_bound (key);
+        auto last = (first != end() && !comp_(key, *first)) ? std::next (first) : first;
+
+        return std::pair{first, last};
+    }
+
+    // Order statistics
+
+    // k-th smallest element. As in ARB_Tree, k starts from 1
+    const_iterator operator[] (size_type k) const
+    {
+        if (k == 0 || k > size_)
+            return end();
+
+        auto node = root_;
+        for (auto level = height_; level > 1; --level)
+        {
+            auto internal = static_cast<const Internal *>(node);
+
+            size_type i = 0;
+            while (k > internal->counts_[i])
+                k -= internal->counts_[i++];
+
+            node = internal->children_[i];
+        }
+
+        return const_iterator{static_cast<const Leaf *>(node), k - 1};
+    }
+
+    // The number of keys before it
+    size_type rank (const_iterator it) const { return it == end() ? size_ : n_less_than (*it); }
+
+    size_type n_less_than (const key_type &key) const
+    {
+        return count_prefix (key, [this](const Leaf *leaf, const key_type &key)
+        {
+            return leaf_lower_bound (leaf, key);
+        });
+    }
+
+    size_type n_less_equal (const key_type &key) const
+    {
+        return count_prefix (key, [this](const Leaf *leaf, const key_type &key)
+        {
+            return leaf_upper_bound (leaf, key);
+        });
+    }
+
+    size_type n_greater_than (const key_type &key) const { return size_ - n_less_equal (key); }
+
+    // Number of keys in [lo, hi)
+    size_type count_range (const key_type &lo, const key_type &hi) const
+    {
+        return comp_(lo, hi) ? n_less_than (hi) - n_less_than (lo) : 0;
+    }
+
+private:
+
+    Leaf *make_leaf ()
+    {
+        auto leaf = leaf_alloc_traits::allocate (leaf_alloc_, 1);
+        try
+        {
+            leaf_alloc_traits::construct (leaf_alloc_, leaf);
+        }
+        catch (...)
+        {
+            leaf_alloc_traits::deallocate (leaf_alloc_, leaf, 1);
+            throw;
+        }
+
+        return leaf;
+    }
+
+    Internal *make_internal ()
+    {
+        auto internal = internal_alloc_traits::allocate (internal_alloc_, 1);
+        try
+        {
+            internal_alloc_traits::construct (internal_alloc_, internal);
+        }
+        catch (...)
+        {
+            internal_alloc_traits::deallocate (internal_alloc_, internal, 1);
+            throw;
+        }
+
+        return internal;
+    }
+
+    void destroy_leaf (Leaf *leaf)
+    {
+        leaf_alloc_traits::destroy (leaf_alloc_, leaf);
+        leaf_alloc_traits::deallocate (leaf_alloc_, leaf, 1);
+    }
+
+    void destroy_internal (Internal *internal)
+    {
+        internal_alloc_traits::destroy (internal_alloc_, internal);
+        internal_alloc_traits::deallocate (internal_alloc_, internal, 1);
+    }
+
+    void destroy_subtree (Node *node, size_type level)
+    {
+        if (level == 1)
+        {
+            destroy_leaf (static_cast<Leaf *>(node));
+            return;
+        }
+
+        auto internal = static_cast<Internal *>(node);
+        for (size_type i = 0; i != internal->n_children_; ++i)
+            destroy_subtree (internal->children_[i], level - 1);
+
+        destroy_internal (internal);
+    }
+
+    // Leaves are cloned from left to right, so prev_leaf is the last cloned one
+    Node *clone_subtree (const Node *node, size_type level, Leaf *&prev_leaf)
+    {
+        if (level == 1)
+        {
+            auto source = static_cast<const Leaf *>(node);
+            auto leaf = make_leaf();
+
+            leaf->n_keys_ = source->n_keys_;
+            std::copy_n (source->keys_.begin(), source->n_keys_, leaf->keys_.begin());
+
+            leaf->prev_ = prev_leaf;
+            if (prev_leaf)
+                prev_leaf->next_ = leaf;
+            else
+                first_leaf_ = leaf;
+            prev_leaf = leaf;
+
+            return leaf;
+        }
+
+        auto source = static_cast<const Internal *>(node);
+        auto internal = make_internal();
+
+        internal->n_children_ = source->n_children_;
+        internal->separators_ = source->separators_;
+        internal->counts_ = source->counts_;
+
+        for (size_type i = 0; i != source->n_children_; ++i)
+            internal->children_[i] = clone_subtree (source->children_[i], level - 1, prev_leaf);
+
+        return internal;
+    }
+
+    // Index of the child which subtree may contain key
+    size_type child_index (const Internal *internal, const key_type &key) const
+    {
+        auto first = internal->separators_.begin();
+        return std::upper_bound (first, first + (internal->n_children_ - 1), key, comp_) - first;
+    }
+
+    size_type leaf_lower_bound (const Leaf *leaf, const key_type &key) const
+    {
+        auto first = leaf->keys_.begin();
+        return std::lower_bound (first, first + leaf->n_keys_, key, comp_) - first;
+    }
+
+    size_type leaf_upper_bound (const Leaf *leaf, const key_type &key) const
+    {
+        auto first = leaf->keys_.begin();
+        return std::upper_bound (first, first + leaf->n_keys_, key, comp_) - first;
+    }
+
+    const Leaf *find_leaf (const key_type &key) const
+    {
+        if (root_ == nullptr)
+            return nullptr;
+
+        auto node = root_;
+        for (auto level = height_; level > 1; --level)
+        {
+            auto internal = static_cast<const Internal *>(node);
+            node = internal->children_[child_index (internal, key)];
+        }
+
+        return static_cast<const Leaf *>(node);
+    }
+
+    // Number of keys in the subtrees left of the path to key plus the count in the leaf
+    template<typename Count_In_Leaf>
+    size_type count_prefix (const key_type &key, Count_In_Leaf count_in_leaf) const
+    {
+        if (root_ == nullptr)
+            return 0;
+
+        size_type count = 0;
+
+        auto node = root_;
+        for (auto level = height_; level > 1; --level)
+        {
+            auto internal = static_cast<const Internal *>(node);
+            auto i = child_index (internal, key);
+
+            for (size_type j = 0; j != i; ++j)
+                count += internal->counts_[j];
+
+            node = internal->children_[i];
+        }
+
+        return count + count_in_leaf (static_cast<const Leaf *>(node), key);
+    }
+
+    // Leaf that contains key or has to contain it and the position of key in it. Every internal
+    // node on the way is stored in path with the index of the child taken, by its level
+    std::pair<Leaf *, size_type> find_position_to_insert (const key_type &key, Path &path) const
+    {
+        if (root_ == nullptr)
+            return std::pair{nullptr, 0};
+
+        auto node = root_;
+        for (auto level = height_; level > 1; --level)
+        {
+            auto internal = static_cast<Internal *>(node);
+            auto i = child_index (internal, key);
+
+            path[level] = Step{internal, i};
+            node = internal->children_[i];
+        }
+
+        auto leaf = static_cast<Leaf *>(node);
+        return std::pair{leaf, leaf_lower_bound (leaf, key)};
+    }
+
+    /*
+     * Puts key at position pos of node. If node is full, its upper half is moved to a reserved
+     * leaf described by split which separator has already been copied. Returns the leaf and the
+     * position where key is after that
+     */
+    std::pair<Leaf *, size_type> insert_into_leaf (Leaf *node, size_type pos, key_type &&key,
+                                                   Split &split, Node_Reserve &reserve)
+    {
+        if (node->n_keys_ == Node_Capacity)
+        {
+            auto right = reserve.take_leaf();
+            auto n_left = Node_Capacity / 2;
+
+            std::move (node->keys_.begin() + n_left, node->keys_.end(), right->keys_.begin());
+            right->n_keys_ = Node_Capacity - n_left;
+            node->n_keys_ = n_left;
+
+            right->prev_ = node;
+            right->next_ = node->next_;
+            if (node->next_)
+                node->next_->prev_ = right;
+            else
+                last_leaf_ = right;
+            node->next_ = right;
+
+            if (pos > n_left)
+            {
+                node = right;
+                pos -= n_left;
+            }
+
+            split.right = right;
+            split.count = right->n_keys_ + (node == right);
+        }
+
+        auto first = node->keys_.begin();
+        std::move_backward (first + pos, first + node->n_keys_, first + node->n_keys_ + 1);
+        node->keys_[pos] = std::move (key);
+        ++node->n_keys_;
+
+        return std::pair{node, pos};
+    }
+
+    // Links child with its separator and count at position pos of internal splitting it into
+    // a reserved node if full
+    void insert_child (Internal *internal, size_type pos, Split &&child, Split &split,
+                       Node_Reserve &reserve)
+    {
+        if (internal->n_children_ == Node_Capacity)
+        {
+            auto right = reserve.take_internal();
+            auto n_left = Node_Capacity / 2;
+            auto n_right = Node_Capacity - n_left;
+
+            split.separator = std::move (internal->separators_[n_left - 1]);
+            std::move (internal->separators_.begin() + n_left, internal->separators_.end(),
+                       right->separators_.begin());
+            std::copy (internal->children_.begin() + n_left, internal->children_.end(),
+                       right->children_.begin());
+            std::copy (internal->counts_.begin() + n_left, internal->counts_.end(),
+                       right->counts_.begin());
+
+            right->n_children_ = n_right;
+            internal->n_children_ = n_left;
+
+            split.right = right;
+            if (pos > n_left)
+            {
+                internal = right;
+                pos -= n_left;
+            }
+        }
+
+        auto n = internal->n_children_;
+        auto separators = internal->separators_.begin();
+        auto children = internal->children_.begin();
+        auto counts = internal->counts_.begin();
+
+        std::move_backward (separators + (pos - 1), separators + (n - 1), separators + n);
+        std::copy_backward (children + pos, children + n, children + n + 1);
+        std::copy_backward (counts + pos, counts + n, counts + n + 1);
+
+        separators[pos - 1] = std::move (child.separator);
+        children[pos] = child.right;
+        counts[pos] = child.count;
+        ++internal->n_children_;
+
+        if (split.right)
+            split.count = subtree_size (static_cast<Internal *>(split.right));
+    }
+
+    static size_type subtree_size (const Internal *internal) noexcept
+    {
+        auto first = internal->counts_.begin();
+        return std::accumulate (first, first + internal->n_children_, size_type{0});
+    }
+
+    static size_type occupancy (const Node *node, size_type level) noexcept
+    {
+        return (level == 1) ? static_cast<const Leaf *>(node)->n_keys_
+                            : static_cast<const Internal *>(node)->n_children_;
+    }
+
+    // Erases key from the subtree of node. Children that become less than half full borrow
+    // from a sibling or are merged with it
+    bool erase_impl (Node *node, size_type level, const key_type &key)
+    {
+        if (level == 1)
+        {
+            auto leaf = static_cast<Leaf *>(node);
+
+            auto pos = leaf_lower_bound (leaf, key);
+            if (pos == leaf->n_keys_ || comp_(key, leaf->keys_[pos]))
+                return false;
+
+            auto first = leaf->keys_.begin();
+            std::move (first + pos + 1, first + leaf->n_keys_, first + pos);
+            --leaf->n_keys_;
+
+            return true;
+        }
+
+        auto internal = static_cast<Internal *>(node);
+        auto i = child_index (internal, key);
+
+        if (!erase_impl (internal->children_[i], level - 1, key))
+            return false;
+
+        --internal->counts_[i];
+        if (occupancy (internal->children_[i], level - 1) < min_occupancy)
+            fix_underflow (internal, i, level - 1);
+
+        return true;
+    }
+
+    void fix_underflow (Internal *parent, size_type i, size_type child_level)
+    {
+        auto &children = parent->children_;
+
+        if (i != 0 && occupancy (children[i - 1], child_level) > min_occupancy)
+            borrow_from_left (parent, i, child_level);
+        else if (i + 1 != parent->n_children_ &&
+                 occupancy (children[i + 1], child_level) > min_occupancy)
+            borrow_from_right (parent, i, child_level);
+        else
+            merge_children (parent, (i != 0) ? i - 1 : i, child_level);
+    }
+
+    // Moves the last key (or child) of child i - 1 to the front of child i
+    void borrow_from_left (Internal *parent, size_type i, size_type child_level)
+    {
+        if (child_level == 1)
+        {
+            auto left = static_cast<Leaf *>(parent->children_[i - 1]);
+            auto child = static_cast<Leaf *>(parent->children_[i]);
+
+            auto keys = child->keys_.begin();
+            std::move_backward (keys, keys + child->n_keys_, keys + child->n_keys_ + 1);
+            keys[0] = std::move (left->keys_[--left->n_keys_]);
+            ++child->n_keys_;
+
+            parent->separators_[i - 1] = keys[0];
+            --parent->counts_[i - 1];
+            ++parent->counts_[i];
+
+            return;
+        }
+
+        auto left = static_cast<Internal *>(parent->children_[i - 1]);
+        auto child = static_cast<Internal *>(parent->children_[i]);
+
+        auto n = child->n_children_;
+        auto separators = child->separators_.begin();
+        auto children = child->children_.begin();
+        auto counts = child->counts_.begin();
+
+        std::move_backward (separators, separators + (n - 1), separators + n);
+        std::copy_backward (children, children + n, children + n + 1);
+        std::copy_backward (counts, counts + n, counts + n + 1);
+
+        auto last = --left->n_children_;
+        separators[0] = std::move (parent->separators_[i - 1]);
+        children[0] = left->children_[last];
+        counts[0] = left->counts_[last];
+        parent->separators_[i - 1] = std::move (left->separators_[last - 1]);
+        ++child->n_children_;
+
+        parent->counts_[i - 1] -= counts[0];
+        parent->counts_[i] += counts[0];
+    }
+
+    // Moves the first key (or child) of child i + 1 to the back of child i
+    void borrow_from_right (Internal *parent, size_type i, size_type child_level)
+    {
+        if (child_level == 1)
+        {
+            auto child = static_cast<Leaf *>(parent->children_[i]);
+            auto right = static_cast<Leaf *>(parent->children_[i + 1]);
+
+            auto keys = right->keys_.begin();
+            child->keys_[child->n_keys_++] = std::move (keys[0]);
+            std::move (keys + 1, keys + right->n_keys_, keys);
+            --right->n_keys_;
+
+            parent->separators_[i] = keys[0];
+            ++parent->counts_[i];
+            --parent->counts_[i + 1];
+
+            return;
+        }
+
+        auto child = static_cast<Internal *>(parent->children_[i]);
+        auto right = static_cast<Internal *>(parent->children_[i + 1]);
+
+        auto n = child->n_children_++;
+        child->separators_[n - 1] = std::move (parent->separators_[i]);
+        child->children_[n] = right->children_[0];
+        child->counts_[n] = right->counts_[0];
+        parent->separators_[i] = std::move (right->separators_[0]);
+
+        auto n_right = right->n_children_--;
+        auto separators = right->separators_.begin();
+        auto children = right->children_.begin();
+        auto counts = right->counts_.begin();
+
+        std::move (separators + 1, separators + (n_right - 1), separators);
+        std::copy (children + 1, children + n_right, children);
+        std::copy (counts + 1, counts + n_right, counts);
+
+        parent->counts_[i] += child->counts_[n];
+        parent->counts_[i + 1] -= child->counts_[n];
+    }
+
+    // Moves all keys (or children) of child j + 1 to child j and removes child j + 1
+    void merge_children (Internal *parent, size_type j, size_type child_level)
+    {
+        if (child_level == 1)
+        {
+            auto left = static_cast<Leaf *>(parent->children_[j]);
+            auto right = static_cast<Leaf *>(parent->children_[j + 1]);
+
+            std::move (right->keys_.begin(), right->keys_.begin() + right->n_keys_,
+                       left->keys_.begin() + left->n_keys_);
+            left->n_keys_ += right->n_keys_;
+
+            left->next_ = right->next_;
+            if (right->next_)
+                right->next_->prev_ = left;
+            else
+                last_leaf_ = left;
+
+            destroy_leaf (right);
+        }
+        else
+        {
+            auto left = static_cast<Internal *>(parent->children_[j]);
+            auto right = static_cast<Internal *>(parent->children_[j + 1]);
+
+            auto n_left = left->n_children_;
+            auto n_right = right->n_children_;
+
+            left->separators_[n_left - 1] = std::move (parent->separators_[j]);
+            std::move (right->separators_.begin(), right->separators_.begin() + (n_right - 1),
+                       left->separators_.begin() + n_left);
+            std::copy_n (right->children_.begin(), n_right, left->children_.begin() + n_left);
+            std::copy_n (right->counts_.begin(), n_right, left->counts_.begin() + n_left);
+            left->n_children_ += n_right;
+
+            destroy_internal (right);
+        }
+
+        auto n = parent->n_children_--;
+        auto separators = parent->separators_.begin();
+        auto children = parent->children_.begin();
+        auto counts = parent->counts_.begin();
+
+        counts[j] += counts[j + 1];
+        std::move (separators + (j + 1), separators + (n - 1), separators + j);
+        std::copy (children + (j + 2), children + n, children + (j + 1));
+        std::copy (counts + (j + 2), counts + n, counts + (j + 1));
+    }
+
+    // An internal root with one child or an empty leaf root is removed
+    void shrink_root ()
+    {
+        if (height_ == 1 && static_cast<Leaf *>(root_)->n_keys_ == 0)
+        {
+            destroy_leaf (static_cast<Leaf *>(root_));
+
+            root_ = nullptr;
+            first_leaf_ = last_leaf_ = nullptr;
+            height_ = 0;
+        }
+        else if (height_ > 1 && static_cast<Internal *>(root_)->n_children_ == 1)
+        {
+            auto old_root = static_cast<Internal *>(root_);
+
+            root_ = old_root->children_[0];
+            destroy_internal (old_root);
+            --height_;
+        }
+    }
+
+    bool verifier () const
+    {
+        if (root_ == nullptr)
+            return height_ == 0 && size_ == 0 && !first_leaf_ && !last_leaf_;
+
+        const Leaf *prev_leaf = nullptr;
+        const key_type *prev_key = nullptr;
+        size_type count = 0;
+
+        if (!subtree_verifier (root_, height_, nullptr, nullptr, prev_leaf, prev_key, count))
+            return false;
+
+        return count == size_ && prev_leaf == last_leaf_ && last_leaf_->next_ == nullptr;
+    }
+
+    // Keys of the subtree have to be in [lo, hi). nullptr stands for no bound
+    bool subtree_verifier (const Node *node, size_type level, const key_type *lo,
+                           const key_type *hi, const Leaf *&prev_leaf, const key_type *&prev_key,
+                           size_type &count) const
+    {
+        auto min_size = (node != root_) ? min_occupancy : (level == 1) ? 1 : 2;
+        auto size = occupancy (node, level);
+
+        if (size < min_size || size > Node_Capacity)
+            return false;
+
+        if (level == 1)
+        {
+            auto leaf = static_cast<const Leaf *>(node);
+
+            if (leaf->prev_ != prev_leaf || (prev_leaf ? prev_leaf->next_ : first_leaf_) != leaf)
+                return false;
+            prev_leaf = leaf;
+
+            for (size_type i = 0; i != leaf->n_keys_; ++i)
+            {
+                auto &key = leaf->keys_[i];
+
+                if ((prev_key && !comp_(*prev_key, key)) ||
+                    (lo && comp_(key, *lo)) || (hi && !comp_(key, *hi)))
+                    return false;
+
+                prev_key = &key;
+            }
+
+            count += leaf->n_keys_;
+            return true;
+        }
+
+        auto internal = static_cast<const Internal *>(node);
+
+        for (size_type i = 0; i != internal->n_children_; ++i)
+        {
+            auto child_lo = (i != 0) ? &internal->separators_[i - 1] : lo;
+            auto child_hi = (i + 1 != internal->n_children_) ? &internal->separators_[i] : hi;
+            auto count_before = count;
+
+            if (!subtree_verifier (internal->children_[i], level - 1, child_lo, child_hi,
+                                   prev_leaf, prev_key, count))
+                return false;
+
+            if (internal->counts_[i] != count - count_before)
+                return false;
+        }
+
+        return true;
+    }
+};
+
+template<typename Key_T, typename Compare, typename Allocator, std::size_t Node_Capacity>
+bool operator== (const BPlus_Tree<Key_T, Compare, Allocator, Node_Capacity> &lhs,
+                 const BPlus_Tree<Key_T, Compare, Allocator, Node_Capacity> &rhs)
+{
+    return (lhs.size() == rhs.size()) &&
+           (std::equal (lhs.begin(), lhs.end(), rhs.begin()));
+}
+
+template<typename Key_T, typename Compare, typename Allocator, std::size_t Node_Capacity>
+auto operator<=> (const BPlus_Tree<Key_T, Compare, Allocator, Node_Capacity> &lhs,
+                  const BPlus_Tree<Key_T, Compare, Allocator, Node_Capacity> &rhs)
+-> decltype (std::compare_three_way{}(*lhs.begin(), *rhs.begin()))
+{
+    return std::lexicographical_compare_three_way (lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+}
+
+} // namespace yLab
+
+#endif // INCLUDE_BPLUS_TREE_HPP
@@ -0,0 +1,309 @@
+/*
+ * This header contains implementation of Frozen_ARB_Tree, a read-only contiguous copy of
+ * an ARB_Tree made by ARB_Tree::freeze().
+ *
+ * Keys are stored twice. The sorted array answers operator[] and iteration by indexing. The
+ * second array holds keys in Eytzinger (BFS) order: the children of slot j are slots 2j and
+ * 2j + 1 (counting from 1), so the top levels of the implicit tree share a few cache lines.
+ * Each slot knows the rank of its key, so a descent ends with a rank rather than a position.
+ *
+ * Descents are branchless: the next slot is computed from the result of a comparison, and the
+ * cache line with descendants of the current slot a few levels down is prefetched while it is
+ * compared. batch_rank() walks a group of keys level by level in lockstep, so loads of
+ * different keys overlap.
+ *
+ * Frozen_ARB_Tree has the lookup and rank API of ARB_Tree, so read paths may use either.
+ */
+
+#ifndef INCLUDE_FROZEN_TREE_HPP
+#define INCLUDE_FROZEN_TREE_HPP
+
+#include <cstddef>
+#include <cassert>
+#include <functional>
+#include <vector>
+#include <span>
+#include <array>
+#include <iterator>
+#include <utility>
+#include <algorithm>
+#include <bit>
+
+#include "arb_tree.hpp"
+
+namespace yLab
+{
+
+namespace detail
+{
+
+inline void prefetch (const void *address) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch (address);
+#else
+    (void)address;
+#endif
+}
+
+} // namespace detail
+
+template<typename Key_T, typename Compare>
+class Frozen_ARB_Tree final
+{
+public:
+
+    using key_type = Key_T;
+    using value_type = Key_T;
+    using key_compare = Compare;
+    using value_compare = Compare;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using const_reference = const value_type &;
+    using const_iterator = typename std::vector<key_type>::const_iterator;
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+private:
+
+    // Descendants of slot j log2(prefetch_stride) levels down start at slot j * prefetch_stride
+    // and fill one cache line
+    static constexpr size_type prefetch_stride =
+        std::bit_floor (std::max<size_type>(1, 64 / sizeof (key_type)));
+
+    // Keys in increasing order
+    std::vector<key_type> keys_;
+
+    // Keys in Eytzinger order and their ranks. Slot j (counting from 1) is stored at j - 1
+    std::vector<key_type> layout_;
+    std::vector<size_type> ranks_;
+
+    key_compare comp_;
+
+public:
+
+    Frozen_ARB_Tree () : Frozen_ARB_Tree{key_compare{}} {}
+
+    explicit Frozen_ARB_Tree (const key_compare &comp) : comp_{comp} {}
+
+    // [first, last) has to be sorted according to comp
+    template<std::input_iterator it>
+    Frozen_ARB_Tree (it first, it last, const key_compare &comp = key_compare{})
+                    : keys_(first, last), comp_{comp}
+    {
+        assert (std::is_sorted (keys_.begin(), keys_.end(), comp_));
+
+        ranks_.resize (keys_.size());
+        size_type next_rank = 0;
+        assign_ranks (1, next_rank);
+
+        layout_.reserve (keys_.size());
+        for (auto rank : ranks_)
+            layout_.push_back (keys_[rank]);
+    }
+
+    // Observers
+
+    const key_compare &key_comp () const { return comp_; }
+    const value_compare &value_comp () const { return comp_; }
+
+    // Capacity
+
+    size_type size () const noexcept { return keys_.size(); }
+    bool empty () const noexcept { return keys_.empty(); }
+
+    // Iterators
+
+    const_iterator begin () const noexcept { return keys_.begin(); }
+    const_iterator end () const noexcept { return keys_.end(); }
+    const_iterator cbegin () const noexcept { return begin(); }
+    const_iterator cend () const noexcept { return end(); }
+
+    const_reverse_iterator rbegin () const noexcept { return const_reverse_iterator{end()}; }
+    const_reverse_iterator rend () const noexcept { return const_reverse_iterator{begin()}; }
+
+    // Lookup
+
+    const_iterator find (const key_type &key) const { return find_impl (key); }
+    bool contains (const key_type &key) const { return find (key) != end(); }
+    size_type count (const key_type &key) const { return n_less_equal (key) - n_less_than (key); }
+
+    const_iterator lower_bound (const key_type &key) const { return begin() + n_less_than (key); }
+    const_iterator upper_bound (const key_type &key) const { return begin() + n_less_equal (key); }
+
+    std::pair<const_iterator, const_iterator> equal_range (const key_type &key) const
+    {
+        return std::pair{lower_bound (key), upper_bound (key)};
+    }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    const_iterator find (const K &key) const { return find_impl (key); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    bool contains (const K &key) const { return find (key) != end(); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    size_type count (const K &key) const { return n_less_equal (key) - n_less_than (key); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    const_iterator lower_bound (const K &key) const { return begin() + n_less_than (key); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    const_iterator upper_bound (const K &key) const { return begin() + n_less_equal (key); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    std::pair<const_iterator, const_iterator> equal_range (const K &key) const
+    {
+        return std::pair{lower_bound (key), upper_bound (key)};
+    }
+
+    // Order statistics
+
+    // k-th smallest element. As in ARB_Tree, k starts from 1
+    const_iterator operator[] (size_type k) const
+    {
+        return (k == 0 || k > size()) ? end() : begin() + (k - 1);
+    }
+
+    size_type rank (const_iterator it) const noexcept { return it - begin(); }
+
+    size_type n_less_than (const key_type &key) const { return n_less_than_impl (key); }
+    size_type n_less_equal (const key_type &key) const { return n_less_equal_impl (key); }
+    size_type n_greater_than (const key_type &key) const { return size() - n_less_equal (key); }
+
+    // Number of keys in [lo, hi)
+    size_type count_range (const key_type &lo, const key_type &hi) const
+    {
+        return comp_(lo, hi) ? n_less_than (hi) - n_less_than (lo) : 0;
+    }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    size_type n_less_than (const K &key) const { return n_less_than_impl (key); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    size_type n_less_equal (const K &key) const { return n_less_equal_impl (key); }
+
+    template<typename K> requires detail::transparent_compare<key_compare>
+    size_type n_greater_than (const K &key) const { return size() - n_less_equal (key); }
+
+    // Batched queries of the same meaning as in ARB_Tree
+
+    std::vector<const_iterator> batch_kth (std::span<const size_type> ks) const
+    {
+        std::vector<const_iterator> answers;
+        answers.reserve (ks.size());
+
+        for (auto k : ks)
+            answers.push_back ((*this)[k]);
+
+        return answers;
+    }
+
+    // n_less_than() for every key of keys
+    std::vector<size_type> batch_rank (std::span<const key_type> keys) const
+    {
+        constexpr size_type group_size = 8;
+
+        std::vector<size_type> answers (keys.size());
+        auto n = layout_.size();
+        // Levels that every descent passes
+        auto n_full_levels = static_cast<size_type>(std::bit_width (n + 1)) - 1;
+
+        for (size_type first = 0; first < keys.size(); first += group_size)
+        {
+            auto group = std::min (group_size, keys.size() - first);
+            std::array<size_type, group_size> slots;
+            slots.fill (1);
+
+            for (size_type level = 0; level != n_full_levels; ++level)
+            {
+                for (size_type i = 0; i != group; ++i)
+                {
+                    auto &slot = slots[i];
+                    detail::prefetch (layout_.data() + std::min (slot * prefetch_stride, n) - 1);
+                    slot = 2 * slot + comp_(layout_[slot - 1], keys[first + i]);
+                }
+            }
+
+            for (size_type i = 0; i != group; ++i)
+            {
+                auto slot = slots[i];
+                if (slot <= n)
+                    slot = 2 * slot + comp_(layout_[slot - 1], keys[first + i]);
+
+                answers[first + i] = rank_of_descent (slot);
+            }
+        }
+
+        return answers;
+    }
+
+    friend bool operator== (const Frozen_ARB_Tree &lhs, const Frozen_ARB_Tree &rhs)
+    {
+        return lhs.keys_ == rhs.keys_;
+    }
+
+private:
+
+    // In-order traversal of the implicit tree gives slots their ranks
+    void assign_ranks (size_type slot, size_type &next_rank)
+    {
+        if (slot > ranks_.size())
+            return;
+
+        assign_ranks (2 * slot, next_rank);
+        ranks_[slot - 1] = next_rank++;
+        assign_ranks (2 * slot + 1, next_rank);
+    }
+
+    /*
+     * A descent goes right from every slot whose key is in the prefix. The last slot where it
+     * has gone left is the first key out of the prefix: the trailing ones of the final slot
+     * are the right turns after it. Slot 0 means that all keys are in the prefix
+     */
+    size_type rank_of_descent (size_type slot) const noexcept
+    {
+        slot >>= std::countr_one (slot) + 1;
+        return slot ? ranks_[slot - 1] : size();
+    }
+
+    // Number of keys in the prefix defined by in_prefix
+    template<typename Predicate>
+    size_type count_prefix (Predicate in_prefix) const
+    {
+        auto n = layout_.size();
+        size_type slot = 1;
+
+        while (slot <= n)
+        {
+            detail::prefetch (layout_.data() + std::min (slot * prefetch_stride, n) - 1);
+            slot = 2 * slot + in_prefix (layout_[slot - 1]);
+        }
+
+        return rank_of_descent (slot);
+    }
+
+    template<typename K>
+    size_type n_less_than_impl (const K &key) const
+    {
+        return count_prefix ([&](const key_type &slot_key){ return comp_(slot_key, key); });
+    }
+
+    template<typename K>
+    size_type n_less_equal_impl (const K &key) const
+    {
+        return count_prefix ([&](const key_type &slot_key){ return !comp_(key, slot_key); });
+    }
+
+    template<typename K>
+    const_iterator find_impl (const K &key) const
+    {
+        auto it = begin() + n_less_than_impl (key);
+        return (it == end() || comp_(key, *it)) ? end() : it;
+    }
+};
+
+} // namespace yLab
+
+#endif // INCLUDE_FROZEN_TREE_HPP
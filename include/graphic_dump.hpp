@@ -28,7 +28,7 @@ void node_dump (std::ostream &os, Node_Ptr node)
     assert (node);
 
     os << "    node_" << node << " [shape = record, ";
-    if (node->color_ == color_type::black)
+    if (node->get_color() == color_type::black)
         os << "color = red, style = filled, fillcolor = black, fontcolor = white";
     else
         os << "color = black, style = filled, fillcolor = red, fontcolor = black";
@@ -0,0 +1,244 @@
+/*
+ * This header contains implementation of a slab pool for nodes of ARB_Tree and an allocator
+ * on top of it.
+ *
+ * Slab_Pool hands out blocks of the same size. Blocks are carved from large slabs and returned
+ * blocks are kept on an intrusive free list, so insert/erase churn at a steady size doesn't call
+ * the global allocator at all. Size of a block is fixed by the first single-object allocation;
+ * requests of any other size or alignment are forwarded to ::operator new. It's enough for
+ * ARB_Tree because it allocates nodes one by one and nothing else.
+ *
+ * Pool_Allocator shares a Slab_Pool between its copies (including rebound ones). Copy
+ * construction of a container gives the copy its own pool. If a tree is the only owner of its
+ * pool and its nodes (keys and aggregates alike) are trivially destructible, clear() gives all
+ * slabs back at once instead of freeing nodes one by one.
+ *
+ * Neither the pool nor the allocator are thread-safe.
+ */
+
+#ifndef INCLUDE_NODE_POOL_HPP
+#define INCLUDE_NODE_POOL_HPP
+
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <concepts>
+
+namespace yLab
+{
+
+struct Pool_Stats
+{
+    std::size_t n_slabs = 0;          // slabs allocated so far
+    std::size_t n_carved = 0;         // blocks carved from slabs
+    std::size_t n_reused = 0;         // blocks taken from the free list
+    std::size_t n_recycled = 0;       // blocks put on the free list
+    std::size_t n_bulk_releases = 0;  // times all slabs were given back at once
+
+    // Fraction of allocations served by the free list
+    double reuse_rate () const noexcept
+    {
+        auto total = n_carved + n_reused;
+        return total ? static_cast<double>(n_reused) / total : 0.0;
+    }
+};
+
+class Slab_Pool final
+{
+    struct Free_Block { Free_Block *next_; };
+    struct Slab_Header { Slab_Header *next_; };
+
+    std::size_t blocks_per_slab_;
+    std::size_t block_size_ = 0;
+    std::size_t block_align_ = 0;
+
+    Slab_Header *slabs_ = nullptr;
+    Free_Block *free_list_ = nullptr;
+    std::byte *current_ = nullptr;
+    std::byte *slab_end_ = nullptr;
+
+    Pool_Stats stats_;
+
+public:
+
+    static constexpr std::size_t default_blocks_per_slab = 1024;
+
+    explicit Slab_Pool (std::size_t blocks_per_slab = default_blocks_per_slab)
+                       : blocks_per_slab_{std::max<std::size_t>(blocks_per_slab, 1)} {}
+
+    Slab_Pool (const Slab_Pool &rhs) = delete;
+    Slab_Pool &operator= (const Slab_Pool &rhs) = delete;
+
+    ~Slab_Pool () { release(); }
+
+    void *allocate (std::size_t size, std::size_t align)
+    {
+        if (block_size_ == 0)
+            set_block_layout (size, align);
+
+        if (!is_pooled (size, align))
+            return ::operator new (size, std::align_val_t{align});
+
+        if (free_list_)
+        {
+            stats_.n_reused++;
+            return std::exchange (free_list_, free_list_->next_);
+        }
+
+        if (current_ == slab_end_)
+            add_slab();
+
+        stats_.n_carved++;
+        return std::exchange (current_, current_ + block_size_);
+    }
+
+    void deallocate (void *ptr, std::size_t size, std::size_t align) noexcept
+    {
+        if (!is_pooled (size, align))
+            return ::operator delete (ptr, size, std::align_val_t{align});
+
+        stats_.n_recycled++;
+        free_list_ = ::new (ptr) Free_Block{free_list_};
+    }
+
+    // Gives all slabs back. Every block handed out by the pool becomes invalid
+    void release () noexcept
+    {
+        if (slabs_ == nullptr)
+            return;
+
+        while (slabs_)
+        {
+            auto slab = std::exchange (slabs_, slabs_->next_);
+            ::operator delete (slab, slab_size(), std::align_val_t{block_align_});
+        }
+
+        free_list_ = nullptr;
+        current_ = slab_end_ = nullptr;
+        stats_.n_bulk_releases++;
+    }
+
+    const Pool_Stats &stats () const noexcept { return stats_; }
+    std::size_t block_size () const noexcept { return block_size_; }
+
+private:
+
+    void set_block_layout (std::size_t size, std::size_t align) noexcept
+    {
+        block_align_ = std::max (align, alignof (Free_Block));
+
+        auto size_ = std::max (size, sizeof (Free_Block));
+        block_size_ = (size_ + block_align_ - 1) / block_align_ * block_align_;
+    }
+
+    bool is_pooled (std::size_t size, std::size_t align) const noexcept
+    {
+        return align <= block_align_ &&
+               (std::max (size, sizeof (Free_Block)) + block_align_ - 1) / block_align_ *
+               block_align_ == block_size_;
+    }
+
+    std::size_t header_size () const noexcept
+    {
+        return (sizeof (Slab_Header) + block_align_ - 1) / block_align_ * block_align_;
+    }
+
+    std::size_t slab_size () const noexcept
+    {
+        return header_size() + blocks_per_slab_ * block_size_;
+    }
+
+    void add_slab ()
+    {
+        auto raw = static_cast<std::byte *>(::operator new (slab_size(),
+                                                            std::align_val_t{block_align_}));
+        slabs_ = ::new (raw) Slab_Header{slabs_};
+
+        current_ = raw + header_size();
+        slab_end_ = raw + slab_size();
+
+        stats_.n_slabs++;
+    }
+};
+
+template<typename T>
+class Pool_Allocator
+{
+    std::shared_ptr<Slab_Pool> pool_;
+
+    template<typename U> friend class Pool_Allocator;
+
+public:
+
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    Pool_Allocator () : pool_{std::make_shared<Slab_Pool>()} {}
+
+    explicit Pool_Allocator (std::size_t blocks_per_slab)
+                            : pool_{std::make_shared<Slab_Pool>(blocks_per_slab)} {}
+
+    // Moving an allocator mustn't change the source, so there is no move constructor
+    Pool_Allocator (const Pool_Allocator &rhs) noexcept = default;
+    Pool_Allocator &operator= (const Pool_Allocator &rhs) noexcept = default;
+
+    template<typename U>
+    Pool_Allocator (const Pool_Allocator<U> &rhs) noexcept : pool_{rhs.pool_} {}
+
+    T *allocate (std::size_t n)
+    {
+        if (n != 1)
+        {
+            auto ptr = ::operator new (n * sizeof (T), std::align_val_t{alignof (T)});
+            return static_cast<T *>(ptr);
+        }
+
+        return static_cast<T *>(pool_->allocate (sizeof (T), alignof (T)));
+    }
+
+    void deallocate (T *ptr, std::size_t n) noexcept
+    {
+        if (n != 1)
+            ::operator delete (ptr, n * sizeof (T), std::align_val_t{alignof (T)});
+        else
+            pool_->deallocate (ptr, sizeof (T), alignof (T));
+    }
+
+    // A container gets a pool of its own on copy construction
+    Pool_Allocator select_on_container_copy_construction () const { return Pool_Allocator{}; }
+
+    // Gives all slabs back if nobody else uses the pool. Returns true on success
+    bool release_exclusive () noexcept
+    {
+        if (pool_.use_count() != 1)
+            return false;
+
+        pool_->release();
+        return true;
+    }
+
+    const Pool_Stats &stats () const noexcept { return pool_->stats(); }
+
+    template<typename U>
+    bool operator== (const Pool_Allocator<U> &rhs) const noexcept { return pool_ == rhs.pool_; }
+};
+
+namespace detail
+{
+
+template<typename Allocator>
+concept bulk_releasable = requires (Allocator &alloc)
+{
+    { alloc.release_exclusive() } -> std::same_as<bool>;
+};
+
+} // namespace detail
+
+} // namespace yLab
+
+#endif // INCLUDE_NODE_POOL_HPP
@@ -1,20 +1,26 @@
 /*
  * This header contains implementation of two types of nodes and some basic functions on them.
  *
- * There are 2 types of nodes: End_Node and ARB_Node. The first one has only one pointer to the
- * left child. ARB_Node is an ordinary node of a red-black tree. It also contains the number of
+ * There are 2 types of nodes: End_Node and ARB_Node. The first one has a pointer to the left
+ * child and a word that ARB_Node uses as a pointer to its parent. ARB_Node is an ordinary node
+ * of a red-black tree. It also contains the number of
  * nodes in its subtree to make range-based queries work in O(log(n)) time. ARB_Node is inherited
- * from End_Node (CRTP is used).
+ * from End_Node (CRTP is used). Compact_ARB_Node is a denser layout of ARB_Node.
  *
- * End_Node is supposed to represent underlying node of end-iterator.
+ * End_Node is supposed to represent underlying node of end-iterator. The end node of a tree has
+ * no parent, so it keeps a pointer to the greatest node of the tree (rightmost) in the parent
+ * word and marks itself with end_tag. It makes decrement of end-iterator O(1).
  *
  * Parent of an ARB_Node can be got by means of get_parent() or parent_unsafe(). The first
  * function returns a pointer to the base class (to End_Node part of a node). The second one
  * performs downcast to a pointer to ARB_Node. It is so because in some cases we are certain
  * that a node's parent is of type ARB_Node and in other cases we are not.
  *
- * Functions that perform rotation (left_rotate() and right_rotate()) also recalculate sizes
- * of subtrees.
+ * Both node types take an augmentation policy (see augmentation.hpp) and keep an aggregate of
+ * their subtree besides its size. update_aggregate() recomputes it from the key and aggregates of
+ * children. Functions that perform rotation (left_rotate() and right_rotate()) also recalculate
+ * sizes and aggregates of subtrees. If COUNT_ROTATIONS macro is defined, they also count
+ * rotations made by the current thread in detail::n_rotations.
  *
  * Successor and predecessor functions are designed the following way. Let root_ be the root
  * of a tree and end_node_ == root->parent_, then (successor (maximum (root_)) == end_node_).
@@ -25,12 +31,17 @@
 
 #include <type_traits>
 #include <utility>
+#include <cstddef>
+#include <cstdint>
 #include <cassert>
+#include <algorithm>
+
+#include "augmentation.hpp"
 
 namespace yLab
 {
 
-template<typename Node_T>
+template<typename Node_T, typename Size_T = std::size_t>
 class End_Node
 {
     using node_ptr = Node_T *;
@@ -38,9 +49,20 @@ class End_Node
 
     node_ptr left_ = nullptr;
 
+protected:
+
+    // Pointer to the parent for ARB_Node; pointer to rightmost for the end node of a tree.
+    // Two lowest bits are flags: derived nodes may use bit 0, bit 1 is end_tag
+    std::uintptr_t parent_word_ = 0;
+
+    static constexpr std::uintptr_t end_tag = 0b10;
+    static constexpr std::uintptr_t flags_mask = 0b11;
+
+    static_assert (alignof (Node_T *) > flags_mask, "Two lowest bits of a pointer are needed");
+
 public:
 
-    using size_type = std::size_t;
+    using size_type = Size_T;
 
     size_type subtree_size_{1};
 
@@ -51,12 +73,16 @@ public:
     End_Node (const End_Node &rhs) = delete;
     End_Node &operator= (const End_Node &rhs) = delete;
 
+    // Flags stay with the moved-from node
     End_Node (End_Node &&rhs) : left_{std::exchange (rhs.left_, nullptr)},
+                                parent_word_{std::exchange (rhs.parent_word_,
+                                                            rhs.parent_word_ & flags_mask)},
                                 subtree_size_{std::exchange (rhs.subtree_size_, 1)} {}
 
     End_Node &operator= (End_Node &&rhs) noexcept
     {
         std::swap (left_, rhs.left_);
+        std::swap (parent_word_, rhs.parent_word_);
         std::swap (subtree_size_, rhs.subtree_size_);
         return *this;
     }
@@ -66,41 +92,80 @@ public:
 
     void set_left (node_ptr left) noexcept { left_ = left; }
 
-    virtual ~End_Node() = default;
+    bool is_end_node () const noexcept { return parent_word_ & end_tag; }
+
+    const_node_ptr get_rightmost () const noexcept
+    {
+        assert (is_end_node());
+        return reinterpret_cast<const_node_ptr>(parent_word_ & ~flags_mask);
+    }
+
+    node_ptr get_rightmost () noexcept
+    {
+        assert (is_end_node());
+        return reinterpret_cast<node_ptr>(parent_word_ & ~flags_mask);
+    }
+
+    // Makes this node the end node of a tree which greatest node is rightmost
+    void set_rightmost (node_ptr rightmost) noexcept
+    {
+        parent_word_ = reinterpret_cast<std::uintptr_t>(rightmost) | end_tag;
+    }
+
+    // Nodes are always destroyed through pointers to their most derived type
+    ~End_Node() = default;
+};
+
+enum class RB_Color
+{
+    red,
+    black
 };
 
 // ARB_Node - augmented red-black node
-template<typename Key_T>
-class ARB_Node : public End_Node<ARB_Node<Key_T>>
+template<typename Key_T, typename Size_T = std::size_t, typename Augment_T = No_Augmentation>
+class ARB_Node : public End_Node<ARB_Node<Key_T, Size_T, Augment_T>, Size_T>
 {
     using node_ptr = ARB_Node *;
     using const_node_ptr = const ARB_Node *;
-    using base_ = End_Node<ARB_Node>;
+    using base_ = End_Node<ARB_Node, Size_T>;
     using end_node_ptr = base_ *;
     using const_end_node_ptr = const base_ *;
 
     node_ptr right_ = nullptr;
-    end_node_ptr parent_ = nullptr;
 
     Key_T key_;
 
 public:
 
-    using size_type = std::size_t;
+    using size_type = Size_T;
     using key_type = Key_T;
-
-    enum class RB_Color
-    {
-        red,
-        black
-    };
-
+    using end_node_type = base_;
+    using RB_Color = yLab::RB_Color;
     using color_type = RB_Color;
+    using augmentation_type = Augment_T;
+    using aggregate_type = typename Augment_T::value_type;
+
+    static constexpr bool is_augmented = !std::is_same_v<Augment_T, No_Augmentation>;
 
     color_type color_;
 
-    ARB_Node (const key_type &key, color_type color) : color_{color}, key_{key} {}
-    ARB_Node (key_type &&key, color_type color) : color_{color}, key_{std::move (key)} {}
+private:
+
+    [[no_unique_address]] aggregate_type aggregate_;
+
+public:
+
+    ARB_Node (const key_type &key, color_type color)
+             : key_{key}, color_{color}, aggregate_{Augment_T::make (key_)} {}
+    ARB_Node (key_type &&key, color_type color)
+             : key_{std::move (key)}, color_{color}, aggregate_{Augment_T::make (key_)} {}
+
+    // Constructs the key from args
+    template<typename... Args>
+    ARB_Node (std::in_place_t, color_type color, Args &&... args)
+             : key_(std::forward<Args>(args)...), color_{color},
+               aggregate_{Augment_T::make (key_)} {}
 
     ARB_Node (const ARB_Node &rhs) = delete;
     ARB_Node &operator= (const ARB_Node &rhs) = delete;
@@ -108,17 +173,17 @@ public:
     ARB_Node (ARB_Node &&rhs)
             : base_{std::move (rhs)},
               right_{std::exchange (rhs.right_, nullptr)},
-              parent_{std::exchange (rhs.parent_, nullptr)},
+              key_{std::move (rhs.key_)},
               color_{std::move (rhs.color_)},
-              key_{std::move (rhs.key_)} {}
+              aggregate_{std::move (rhs.aggregate_)} {}
 
     ARB_Node &operator= (ARB_Node &&rhs) noexcept (std::is_nothrow_swappable_v<key_type>)
     {
         std::swap (static_cast<base_ &>(*this), static_cast<base_ &>(rhs));
         std::swap (right_, rhs.right_);
-        std::swap (parent_, rhs.parent_);
         std::swap (color_, rhs.color_);
         std::swap (key_, rhs.key_);
+        std::swap (aggregate_, rhs.aggregate_);
 
         return *this;
     }
@@ -127,26 +192,204 @@ public:
     node_ptr get_right () noexcept { return right_; }
     void set_right (node_ptr right) noexcept { right_ = right; }
 
-    const_end_node_ptr get_parent () const noexcept { return parent_; }
-    end_node_ptr get_parent () noexcept { return parent_; }
-    void set_parent (end_node_ptr parent) noexcept { parent_ = parent; }
+    const_end_node_ptr get_parent () const noexcept
+    {
+        return reinterpret_cast<const_end_node_ptr>(this->parent_word_);
+    }
+
+    end_node_ptr get_parent () noexcept
+    {
+        return reinterpret_cast<end_node_ptr>(this->parent_word_);
+    }
+
+    void set_parent (end_node_ptr parent) noexcept
+    {
+        this->parent_word_ = reinterpret_cast<std::uintptr_t>(parent);
+    }
+
+    const_node_ptr parent_unsafe () const noexcept
+    {
+        return static_cast<const_node_ptr>(get_parent());
+    }
+
+    node_ptr parent_unsafe () noexcept { return static_cast<node_ptr>(get_parent()); }
 
-    const_node_ptr parent_unsafe () const noexcept { return static_cast<const_node_ptr>(parent_); }
-    node_ptr parent_unsafe () noexcept { return static_cast<node_ptr>(parent_); }
+    color_type get_color () const noexcept { return color_; }
+    void set_color (color_type color) noexcept { color_ = color; }
 
     const key_type &key () const { return key_; }
+    key_type &key () { return key_; }
     static size_type size (const_node_ptr node) noexcept { return node ? node->subtree_size_ : 0; }
+
+    // Aggregate of the keys of the subtree of this node
+    const aggregate_type &aggregate () const noexcept { return aggregate_; }
+
+    // Children have to be up to date
+    void update_aggregate () noexcept
+    {
+        if constexpr (is_augmented)
+        {
+            aggregate_ = Augment_T::make (key_);
+            if (auto left = this->get_left())
+                aggregate_ = Augment_T::combine (left->aggregate_, aggregate_);
+            if (right_)
+                aggregate_ = Augment_T::combine (aggregate_, right_->aggregate_);
+        }
+    }
+};
+
+/*
+ * Compact_ARB_Node is a drop-in replacement for ARB_Node that keeps its color in the lowest bit
+ * of the pointer to its parent. The key is placed right after the base subobject, so with 32-bit
+ * subtree sizes a small key occupies the tail padding of End_Node. For example, on x86-64
+ * Compact_ARB_Node<int> takes 32 bytes against 40 of ARB_Node<int>.
+ *
+ * Size_T limits the number of nodes in a tree: it must hold the size of the whole tree plus 1.
+ */
+template<typename Key_T, typename Size_T = std::uint32_t, typename Augment_T = No_Augmentation>
+class Compact_ARB_Node : public End_Node<Compact_ARB_Node<Key_T, Size_T, Augment_T>, Size_T>
+{
+    using node_ptr = Compact_ARB_Node *;
+    using const_node_ptr = const Compact_ARB_Node *;
+    using base_ = End_Node<Compact_ARB_Node, Size_T>;
+    using end_node_ptr = base_ *;
+    using const_end_node_ptr = const base_ *;
+
+    static constexpr std::uintptr_t red_bit = 1;
+
+    Key_T key_;
+
+    node_ptr right_ = nullptr;
+
+public:
+
+    using size_type = Size_T;
+    using key_type = Key_T;
+    using end_node_type = base_;
+    using RB_Color = yLab::RB_Color;
+    using color_type = RB_Color;
+    using augmentation_type = Augment_T;
+    using aggregate_type = typename Augment_T::value_type;
+
+    static constexpr bool is_augmented = !std::is_same_v<Augment_T, No_Augmentation>;
+
+private:
+
+    [[no_unique_address]] aggregate_type aggregate_;
+
+public:
+
+    Compact_ARB_Node (const key_type &key, color_type color)
+                     : key_{key}, aggregate_{Augment_T::make (key_)}
+    {
+        set_color (color);
+    }
+
+    Compact_ARB_Node (key_type &&key, color_type color)
+                     : key_{std::move (key)}, aggregate_{Augment_T::make (key_)}
+    {
+        set_color (color);
+    }
+
+    template<typename... Args>
+    Compact_ARB_Node (std::in_place_t, color_type color, Args &&... args)
+                     : key_(std::forward<Args>(args)...), aggregate_{Augment_T::make (key_)}
+    {
+        set_color (color);
+    }
+
+    Compact_ARB_Node (const Compact_ARB_Node &rhs) = delete;
+    Compact_ARB_Node &operator= (const Compact_ARB_Node &rhs) = delete;
+
+    Compact_ARB_Node (Compact_ARB_Node &&rhs)
+                     : base_{std::move (rhs)},
+                       key_{std::move (rhs.key_)},
+                       right_{std::exchange (rhs.right_, nullptr)},
+                       aggregate_{std::move (rhs.aggregate_)} {}
+
+    Compact_ARB_Node &operator= (Compact_ARB_Node &&rhs)
+    noexcept (std::is_nothrow_swappable_v<key_type>)
+    {
+        std::swap (static_cast<base_ &>(*this), static_cast<base_ &>(rhs));
+        std::swap (right_, rhs.right_);
+        std::swap (key_, rhs.key_);
+        std::swap (aggregate_, rhs.aggregate_);
+
+        return *this;
+    }
+
+    const_node_ptr get_right () const noexcept { return right_; }
+    node_ptr get_right () noexcept { return right_; }
+    void set_right (node_ptr right) noexcept { right_ = right; }
+
+    const_end_node_ptr get_parent () const noexcept
+    {
+        return reinterpret_cast<const_end_node_ptr>(this->parent_word_ & ~red_bit);
+    }
+
+    end_node_ptr get_parent () noexcept
+    {
+        return reinterpret_cast<end_node_ptr>(this->parent_word_ & ~red_bit);
+    }
+
+    void set_parent (end_node_ptr parent) noexcept
+    {
+        this->parent_word_ = reinterpret_cast<std::uintptr_t>(parent) |
+                             (this->parent_word_ & red_bit);
+    }
+
+    const_node_ptr parent_unsafe () const noexcept
+    {
+        return static_cast<const_node_ptr>(get_parent());
+    }
+
+    node_ptr parent_unsafe () noexcept { return static_cast<node_ptr>(get_parent()); }
+
+    color_type get_color () const noexcept
+    {
+        return (this->parent_word_ & red_bit) ? color_type::red : color_type::black;
+    }
+
+    void set_color (color_type color) noexcept
+    {
+        if (color == color_type::red)
+            this->parent_word_ |= red_bit;
+        else
+            this->parent_word_ &= ~red_bit;
+    }
+
+    const key_type &key () const { return key_; }
+    key_type &key () { return key_; }
+    static size_type size (const_node_ptr node) noexcept { return node ? node->subtree_size_ : 0; }
+
+    // Aggregate of the keys of the subtree of this node
+    const aggregate_type &aggregate () const noexcept { return aggregate_; }
+
+    // Children have to be up to date
+    void update_aggregate () noexcept
+    {
+        if constexpr (is_augmented)
+        {
+            aggregate_ = Augment_T::make (key_);
+            if (auto left = this->get_left())
+                aggregate_ = Augment_T::combine (left->aggregate_, aggregate_);
+            if (right_)
+                aggregate_ = Augment_T::combine (aggregate_, right_->aggregate_);
+        }
+    }
 };
 
 namespace detail
 {
 
+#ifdef COUNT_ROTATIONS
+inline thread_local std::size_t n_rotations = 0;
+#endif // COUNT_ROTATIONS
+
 template<typename Node_Ptr>
 bool is_red (Node_Ptr node) noexcept
 {
-    using color_type = typename std::remove_pointer_t<Node_Ptr>::color_type;
-
-    return (node && node->color_ == color_type::red);
+    return (node && node->get_color() == RB_Color::red);
 }
 
 template<typename Node_Ptr>
@@ -201,6 +444,9 @@ auto predecessor (End_Node_Ptr node) noexcept -> decltype (node->get_left())
 
     assert (node);
 
+    if (node->is_end_node())
+        return node->get_rightmost();
+
     if (node->get_left())
         return maximum (node->get_left());
 
@@ -227,6 +473,10 @@ void left_rotate (Node_Ptr x) noexcept
     assert (x);
     assert (x->get_right());
 
+    #ifdef COUNT_ROTATIONS
+    n_rotations++;
+    #endif // COUNT_ROTATIONS
+
     auto y = x->get_right();
 
     auto b = y->get_left();
@@ -245,6 +495,9 @@ void left_rotate (Node_Ptr x) noexcept
 
     x->subtree_size_ = 1 + node_type::size (x->get_left()) + node_type::size (b);
     y->subtree_size_ = 1 + x->subtree_size_ + node_type::size (y->get_right());
+
+    x->update_aggregate();
+    y->update_aggregate();
 }
 
 /*
@@ -263,6 +516,10 @@ void right_rotate (Node_Ptr x) noexcept
     assert (x);
     assert (x->get_left());
 
+    #ifdef COUNT_ROTATIONS
+    n_rotations++;
+    #endif // COUNT_ROTATIONS
+
     auto y = x->get_left();
 
     auto b = y->get_right();
@@ -281,6 +538,19 @@ void right_rotate (Node_Ptr x) noexcept
 
     x->subtree_size_ = 1 + node_type::size (x->get_right()) + node_type::size (b);
     y->subtree_size_ = 1 + x->subtree_size_ + node_type::size (y->get_left());
+
+    x->update_aggregate();
+    y->update_aggregate();
+}
+
+// The number of nodes on the longest path from root down
+template<typename Node_Ptr>
+std::size_t height (Node_Ptr root) noexcept
+{
+    if (root == nullptr)
+        return 0;
+
+    return 1 + std::max (height (root->get_left()), height (root->get_right()));
 }
 
 template<typename Node_Ptr>
@@ -313,26 +583,94 @@ Node_Ptr kth_smallest (Node_Ptr root, std::size_t k) noexcept
     return root;
 }
 
+/*
+ * Returns the node that is n positions after node in the in-order traversal or the end node
+ * if there are fewer nodes after it. Takes O(log n) time: it climbs up only until the subtree
+ * of the target is found and then descends by subtree sizes.
+ */
+template<typename Node_Ptr>
+auto advance (Node_Ptr node, std::size_t n) noexcept -> decltype (node->get_parent())
+{
+    using node_type = std::remove_pointer_t<Node_Ptr>;
+
+    assert (node);
+
+    while (n != 0)
+    {
+        auto right_size = node_type::size (node->get_right());
+        if (n <= right_size)
+            return kth_smallest (node->get_right(), n);
+
+        n -= right_size;
+
+        // The next node after the subtree of node is the parent of its first left-child ancestor
+        while (!is_left_child (node))
+            node = node->parent_unsafe();
+
+        auto parent = node->get_parent();
+        if (parent->is_end_node())
+            return parent;
+
+        node = static_cast<Node_Ptr>(parent);
+        n--;
+    }
+
+    return node;
+}
+
+// Symmetric to advance(). Returns nullptr if there are fewer than n nodes before node
+template<typename Node_Ptr>
+Node_Ptr retreat (Node_Ptr node, std::size_t n) noexcept
+{
+    using node_type = std::remove_pointer_t<Node_Ptr>;
+
+    assert (node);
+
+    while (n != 0)
+    {
+        auto left_size = node_type::size (node->get_left());
+        if (n <= left_size)
+            return kth_smallest (node->get_left(), left_size - n + 1);
+
+        n -= left_size;
+
+        // The node before the subtree of node is the parent of its first right-child ancestor
+        while (is_left_child (node))
+        {
+            if (node->get_parent()->is_end_node())
+                return nullptr;
+
+            node = node->parent_unsafe();
+        }
+
+        node = node->parent_unsafe();
+        n--;
+    }
+
+    return node;
+}
+
+// The number of nodes before node in its tree. The rank of the end node is the size of the tree
 template<typename End_Node_Ptr>
-auto n_less_than (End_Node_Ptr root, End_Node_Ptr node) noexcept ->
-typename std::remove_pointer_t<End_Node_Ptr>::size_type
+auto rank (End_Node_Ptr node) noexcept -> typename std::remove_pointer_t<End_Node_Ptr>::size_type
 {
     using node_ptr = decltype (node->get_left());
     using node_type = std::remove_pointer_t<node_ptr>;
 
     assert (node);
 
-    auto rank = node_type::size (node->get_left());
+    if (node->is_end_node())
+        return node->subtree_size_ - 1;
 
-    while (node != root)
-    {
-        auto node_ = static_cast<node_ptr>(node);
-        auto parent = node_->get_parent();
+    auto node_ = static_cast<node_ptr>(node);
+    auto rank = node_type::size (node_->get_left());
 
+    for (auto parent = node_->get_parent(); !parent->is_end_node(); parent = node_->get_parent())
+    {
         if (!is_left_child (node_))
             rank += 1 + node_type::size (parent->get_left());
 
-        node = parent;
+        node_ = static_cast<node_ptr>(parent);
     }
 
     return rank;
@@ -353,7 +691,7 @@ std::size_t red_black_verifier (Node_Ptr root) noexcept
         (right && right->get_parent() != root))
         return 0;
 
-    auto is_root_red = (root->color_ == color_type::red);
+    auto is_root_red = (root->get_color() == color_type::red);
     if (is_root_red)
     {
         if (is_red (left) || is_red (right))
@@ -0,0 +1,320 @@
+/*
+ * This header contains implementation of Optimistic_ARB_Tree, a tree with one writer and any
+ * number of readers that don't block each other.
+ *
+ * The writer modifies a Persistent_ARB_Tree and publishes the root of every new version through
+ * an atomic pointer. Published nodes are never changed, so a reader doesn't need to validate what
+ * it has read and never retries: it loads the root and walks the tree without touching reference
+ * counts or any other shared cache line.
+ *
+ * Nodes left behind by a new version are reclaimed with epochs. The version counter is the
+ * global epoch. A reader announces the epoch it has seen in its own Reader_Slot before loading
+ * the root and clears the slot when it is done. The writer retires the previous version tagged
+ * with the epoch it was published in and frees retired versions older than every announced
+ * epoch.
+ *
+ * Readers access the tree through Reader handles. Each handle owns one of Max_Readers slots.
+ */
+
+#ifndef INCLUDE_OPTIMISTIC_TREE_HPP
+#define INCLUDE_OPTIMISTIC_TREE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <array>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <initializer_list>
+
+#include "persistent_tree.hpp"
+
+namespace yLab
+{
+
+template<typename Key_T, typename Compare = std::less<Key_T>,
+         typename Allocator = std::allocator<Key_T>, std::size_t Max_Readers = 64>
+class Optimistic_ARB_Tree final
+{
+    using persistent_tree_type = Persistent_ARB_Tree<Key_T, Compare, Allocator>;
+    using node_type = detail::Persistent_Node<Key_T>;
+    using const_node_ptr = const node_type *;
+    using epoch_type = std::uint64_t;
+
+    static constexpr std::size_t cache_line_size = 64;
+
+    // Slots of different readers never share a cache line
+    struct alignas (cache_line_size) Reader_Slot
+    {
+        std::atomic<epoch_type> epoch_{0}; // 0 if the reader is outside of a read
+        std::atomic<bool> is_taken_{false};
+    };
+
+public:
+
+    using key_type = Key_T;
+    using value_type = Key_T;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+    using snapshot_type = typename persistent_tree_type::snapshot_type;
+
+    class Reader;
+
+private:
+
+    alignas (cache_line_size) std::atomic<const_node_ptr> root_{nullptr};
+    std::atomic<epoch_type> epoch_{1};
+    std::atomic<size_type> size_{0};
+
+    mutable std::array<Reader_Slot, Max_Readers> slots_;
+
+    // Writer's state
+    alignas (cache_line_size) std::mutex write_mutex_;
+    persistent_tree_type tree_;
+    snapshot_type current_;
+    std::vector<std::pair<epoch_type, snapshot_type>> retired_;
+
+public:
+
+    Optimistic_ARB_Tree () : Optimistic_ARB_Tree{key_compare{}} {}
+
+    explicit Optimistic_ARB_Tree (const key_compare &comp,
+                                  const allocator_type &alloc = allocator_type{})
+                                 : tree_{comp, alloc}, current_{tree_.snapshot()} {}
+
+    Optimistic_ARB_Tree (std::initializer_list<value_type> ilist,
+                         const key_compare &comp = key_compare{},
+                         const allocator_type &alloc = allocator_type{})
+                        : tree_{ilist, comp, alloc}, current_{tree_.snapshot()}
+    {
+        root_.store (current_.root_.get());
+        size_.store (current_.size());
+    }
+
+    // Readers hold pointers to the slots
+    Optimistic_ARB_Tree (const Optimistic_ARB_Tree &rhs) = delete;
+    Optimistic_ARB_Tree &operator= (const Optimistic_ARB_Tree &rhs) = delete;
+
+    ~Optimistic_ARB_Tree ()
+    {
+        assert (std::none_of (slots_.begin(), slots_.end(), [](const Reader_Slot &slot)
+        {
+            return slot.is_taken_.load();
+        }));
+    }
+
+    const key_compare &key_comp () const { return tree_.key_comp(); }
+
+    // Number of published versions. May be called by any thread
+    epoch_type version () const noexcept { return epoch_.load(); }
+
+    // May be called by any thread
+    size_type size () const noexcept { return size_.load (std::memory_order_relaxed); }
+    bool empty () const noexcept { return size() == 0; }
+
+    // Owning version of the tree for long reads and iteration. May be called by any thread
+    snapshot_type snapshot ()
+    {
+        std::lock_guard lock{write_mutex_};
+        return current_;
+    }
+
+    // Modifiers may be called by any thread; they are serialized
+
+    bool insert (const key_type &key)
+    {
+        std::lock_guard lock{write_mutex_};
+
+        if (!tree_.insert (key))
+            return false;
+
+        publish();
+        return true;
+    }
+
+    size_type erase (const key_type &key)
+    {
+        std::lock_guard lock{write_mutex_};
+
+        if (tree_.erase (key) == 0)
+            return 0;
+
+        publish();
+        return 1;
+    }
+
+    void clear ()
+    {
+        std::lock_guard lock{write_mutex_};
+
+        tree_.clear();
+        publish();
+    }
+
+    /*
+     * A reader thread's handle. Its member functions may be called by the thread that owns
+     * the handle only. They return copies of keys, because nodes may be freed after a read
+     */
+    class Reader final
+    {
+        const Optimistic_ARB_Tree *tree_;
+        Reader_Slot *slot_;
+
+    public:
+
+        explicit Reader (const Optimistic_ARB_Tree &tree) : tree_{&tree}, slot_{nullptr}
+        {
+            for (auto &slot : tree.slots_)
+            {
+                if (!slot.is_taken_.load (std::memory_order_relaxed)
+                    && !slot.is_taken_.exchange (true, std::memory_order_acquire))
+                {
+                    slot_ = &slot;
+                    return;
+                }
+            }
+
+            throw std::length_error{"Optimistic_ARB_Tree: too many readers"};
+        }
+
+        Reader (const Reader &rhs) = delete;
+        Reader &operator= (const Reader &rhs) = delete;
+
+        Reader (Reader &&rhs) noexcept
+               : tree_{rhs.tree_}, slot_{std::exchange (rhs.slot_, nullptr)} {}
+
+        Reader &operator= (Reader &&rhs) noexcept
+        {
+            std::swap (tree_, rhs.tree_);
+            std::swap (slot_, rhs.slot_);
+
+            return *this;
+        }
+
+        ~Reader ()
+        {
+            if (slot_)
+                slot_->is_taken_.store (false, std::memory_order_release);
+        }
+
+        /*
+         * Calls action with the root of the latest version. Nodes reachable from the root
+         * stay alive until action returns. action mustn't let pointers to them escape
+         */
+        template<typename F>
+        auto read (F action) const
+        {
+            /*
+             * action may read through the same handle again. The nested read keeps the epoch
+             * announced by the outer one: versions published since then are retired with later
+             * epochs, so the root it loads stays alive as well
+             */
+            auto outer_epoch = slot_->epoch_.load (std::memory_order_relaxed);
+
+            // Both are sequentially consistent: the writer must see the slot filled before
+            // the root is loaded
+            if (outer_epoch == 0)
+                slot_->epoch_.store (tree_->epoch_.load());
+            auto root = tree_->root_.load();
+
+            struct Slot_Guard
+            {
+                Reader_Slot *slot_;
+                epoch_type outer_epoch_;
+
+                ~Slot_Guard () { slot_->epoch_.store (outer_epoch_, std::memory_order_release); }
+            } guard{slot_, outer_epoch};
+
+            return action (root);
+        }
+
+        size_type size () const
+        {
+            return read ([](const_node_ptr root){ return node_type::size (root); });
+        }
+
+        bool contains (const key_type &key) const
+        {
+            return read ([&](const_node_ptr root)
+            {
+                return detail::find_persistent_node (root, key, tree_->tree_.key_comp()) != nullptr;
+            });
+        }
+
+        // k-th smallest key. As in ARB_Tree, k starts from 1
+        std::optional<key_type> operator[] (size_type k) const
+        {
+            return read ([&](const_node_ptr root)
+            {
+                auto node = detail::kth_persistent_node (root, k);
+                return node ? std::optional<key_type>{node->key_} : std::nullopt;
+            });
+        }
+
+        size_type n_less_than (const key_type &key) const
+        {
+            auto &comp = tree_->tree_.key_comp();
+            return read ([&](const_node_ptr root)
+            {
+                return detail::count_persistent_prefix (root, [&](const key_type &node_key)
+                {
+                    return comp (node_key, key);
+                });
+            });
+        }
+
+        size_type n_less_equal (const key_type &key) const
+        {
+            auto &comp = tree_->tree_.key_comp();
+            return read ([&](const_node_ptr root)
+            {
+                return detail::count_persistent_prefix (root, [&](const key_type &node_key)
+                {
+                    return !comp (key, node_key);
+                });
+            });
+        }
+    };
+
+    Reader reader () const { return Reader{*this}; }
+
+private:
+
+    void publish ()
+    {
+        auto previous = std::exchange (current_, tree_.snapshot());
+        root_.store (current_.root_.get());
+        size_.store (current_.size(), std::memory_order_relaxed);
+
+        // Readers that have announced this epoch or an earlier one may still use previous
+        retired_.emplace_back (epoch_.fetch_add (1), std::move (previous));
+        reclaim();
+    }
+
+    void reclaim ()
+    {
+        auto oldest = std::numeric_limits<epoch_type>::max();
+
+        for (auto &slot : slots_)
+        {
+            if (auto epoch = slot.epoch_.load(); epoch != 0)
+                oldest = std::min (oldest, epoch);
+        }
+
+        // Dropping a snapshot frees the nodes that no newer version shares
+        std::erase_if (retired_, [oldest](const auto &retired){ return retired.first < oldest; });
+    }
+};
+
+} // namespace yLab
+
+#endif // INCLUDE_OPTIMISTIC_TREE_HPP
@@ -0,0 +1,650 @@
+/*
+ * This header contains implementation of persistent augmented red-black tree
+ * (Persistent_ARB_Tree) and its read-only snapshots (ARB_Snapshot).
+ *
+ * Nodes of ARB_Tree point to their parents, so they can't be shared between versions of a tree.
+ * Nodes of Persistent_ARB_Tree have no parent pointers and are never changed after construction:
+ * insert() and erase() build new nodes on the path from the root to the modified position
+ * (rotations and recolorings included) and share all other subtrees with the previous version
+ * through reference counting. Every node knows the size of its subtree, so snapshots answer
+ * rank queries in O(log n) time.
+ *
+ * Rebalancing follows the functional red-black trees of Okasaki (insertion) and Kahrs (erasure).
+ *
+ * snapshot() takes O(1) time and may be called by any thread while one writer modifies the tree.
+ * A snapshot is an immutable version of the tree: any number of threads may query it without
+ * locks. A node is freed by the thread that drops the last reference to it, so the allocator has
+ * to be thread-safe.
+ */
+
+#ifndef INCLUDE_PERSISTENT_TREE_HPP
+#define INCLUDE_PERSISTENT_TREE_HPP
+
+#include <cstddef>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <utility>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <initializer_list>
+
+#include "nodes.hpp"
+
+namespace yLab
+{
+
+namespace detail
+{
+
+template<typename Key_T>
+struct Persistent_Node
+{
+    using node_ptr = std::shared_ptr<const Persistent_Node>;
+    using size_type = std::size_t;
+    using color_type = RB_Color;
+
+    node_ptr left_;
+    node_ptr right_;
+    Key_T key_;
+    size_type subtree_size_;
+    color_type color_;
+
+    template<typename K>
+    Persistent_Node (color_type color, node_ptr left, K &&key, node_ptr right)
+                    : left_{std::move (left)}, right_{std::move (right)},
+                      key_(std::forward<K>(key)),
+                      subtree_size_{1 + size (left_.get()) + size (right_.get())},
+                      color_{color} {}
+
+    static size_type size (const Persistent_Node *node) noexcept
+    {
+        return node ? node->subtree_size_ : 0;
+    }
+};
+
+template<typename Key_T, typename Compare>
+const Persistent_Node<Key_T> *find_persistent_node (const Persistent_Node<Key_T> *node,
+                                                    const Key_T &key, const Compare &comp)
+{
+    while (node)
+    {
+        if (comp (key, node->key_))
+            node = node->left_.get();
+        else if (comp (node->key_, key))
+            node = node->right_.get();
+        else
+            break;
+    }
+
+    return node;
+}
+
+// k-th smallest key in the subtree of node (k starts from 1) or nullptr
+template<typename Key_T>
+const Persistent_Node<Key_T> *kth_persistent_node (const Persistent_Node<Key_T> *node,
+                                                   std::size_t k)
+{
+    using node_type = Persistent_Node<Key_T>;
+
+    if (k == 0 || k > node_type::size (node))
+        return nullptr;
+
+    for (;;)
+    {
+        auto left_size = node_type::size (node->left_.get());
+
+        if (k <= left_size)
+            node = node->left_.get();
+        else if (k == left_size + 1)
+            return node;
+        else
+        {
+            k -= left_size + 1;
+            node = node->right_.get();
+        }
+    }
+}
+
+// Number of keys in the subtree of node that form a prefix defined by in_prefix
+template<typename Key_T, typename Predicate>
+std::size_t count_persistent_prefix (const Persistent_Node<Key_T> *node, Predicate in_prefix)
+{
+    std::size_t count = 0;
+
+    while (node)
+    {
+        if (in_prefix (node->key_))
+        {
+            count += Persistent_Node<Key_T>::size (node->left_.get()) + 1;
+            node = node->right_.get();
+        }
+        else
+            node = node->left_.get();
+    }
+
+    return count;
+}
+
+} // namespace detail
+
+template<typename Key_T, typename Compare, typename Allocator, std::size_t Max_Readers>
+class Optimistic_ARB_Tree;
+
+// Immutable version of a Persistent_ARB_Tree
+template<typename Key_T, typename Compare = std::less<Key_T>>
+class ARB_Snapshot final
+{
+    using node_type = detail::Persistent_Node<Key_T>;
+    using node_ptr = typename node_type::node_ptr;
+    using const_node_ptr = const node_type *;
+
+    node_ptr root_;
+    Compare comp_;
+
+    template<typename K, typename C, typename A, std::size_t M>
+    friend class Optimistic_ARB_Tree;
+
+public:
+
+    using key_type = Key_T;
+    using value_type = Key_T;
+    using key_compare = Compare;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    /*
+     * Nodes have no parent pointers, so an iterator keeps its path from the root: the current
+     * node on top and the ancestors it is in the left subtree of below it. Iterators are valid
+     * as long as the snapshot is alive
+     */
+    class const_iterator final
+    {
+        std::vector<const_node_ptr> path_;
+
+        friend class ARB_Snapshot;
+
+        void push_left_spine (const_node_ptr node)
+        {
+            for (; node; node = node->left_.get())
+                path_.push_back (node);
+        }
+
+    public:
+
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = Key_T;
+        using reference = const value_type &;
+        using pointer = const value_type *;
+
+        const_iterator () = default;
+
+        reference operator* () const { return path_.back()->key_; }
+        pointer operator-> () const { return &path_.back()->key_; }
+
+        const_iterator &operator++ ()
+        {
+            auto node = path_.back();
+            path_.pop_back();
+            push_left_spine (node->right_.get());
+
+            return *this;
+        }
+
+        const_iterator operator++ (int)
+        {
+            auto tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        bool operator== (const const_iterator &rhs) const noexcept
+        {
+            if (path_.empty() || rhs.path_.empty())
+                return path_.empty() == rhs.path_.empty();
+
+            return path_.back() == rhs.path_.back();
+        }
+    };
+
+    using iterator = const_iterator;
+
+    ARB_Snapshot () = default;
+    ARB_Snapshot (node_ptr root, const key_compare &comp) : root_{std::move (root)}, comp_{comp} {}
+
+    size_type size () const noexcept { return node_type::size (root_.get()); }
+    bool empty () const noexcept { return root_ == nullptr; }
+
+    const_iterator begin () const
+    {
+        const_iterator it;
+        it.push_left_spine (root_.get());
+        return it;
+    }
+
+    const_iterator end () const noexcept { return const_iterator{}; }
+
+    // k-th smallest key or end(). As in ARB_Tree, k starts from 1
+    const_iterator operator[] (size_type k) const
+    {
+        const_iterator it;
+        if (k == 0 || k > size())
+            return it;
+
+        for (auto node = root_.get(); node;)
+        {
+            auto left_size = node_type::size (node->left_.get());
+
+            if (k <= left_size)
+            {
+                it.path_.push_back (node);
+                node = node->left_.get();
+            }
+            else if (k == left_size + 1)
+            {
+                it.path_.push_back (node);
+                break;
+            }
+            else
+            {
+                k -= left_size + 1;
+                node = node->right_.get();
+            }
+        }
+
+        return it;
+    }
+
+    // First key that is not less than key
+    const_iterator lower_bound (const key_type &key) const
+    {
+        const_iterator it;
+
+        for (auto node = root_.get(); node;)
+        {
+            if (!comp_(node->key_, key)) // key <= node->key_
+            {
+                it.path_.push_back (node);
+                node = node->left_.get();
+            }
+            else
+                node = node->right_.get();
+        }
+
+        return it;
+    }
+
+    const_iterator find (const key_type &key) const
+    {
+        auto it = lower_bound (key);
+        return (it == end() || comp_(key, *it)) ? end() : it;
+    }
+
+    bool contains (const key_type &key) const
+    {
+        return detail::find_persistent_node (root_.get(), key, comp_) != nullptr;
+    }
+
+    size_type n_less_than (const key_type &key) const
+    {
+        return detail::count_persistent_prefix (root_.get(), [&](const key_type &node_key)
+        {
+            return comp_(node_key, key);
+        });
+    }
+
+    size_type n_less_equal (const key_type &key) const
+    {
+        return detail::count_persistent_prefix (root_.get(), [&](const key_type &node_key)
+        {
+            return !comp_(key, node_key);
+        });
+    }
+
+    size_type n_greater_than (const key_type &key) const { return size() - n_less_equal (key); }
+
+    // Number of keys in [lo, hi)
+    size_type count_range (const key_type &lo, const key_type &hi) const
+    {
+        return comp_(lo, hi) ? n_less_than (hi) - n_less_than (lo) : 0;
+    }
+
+    friend bool operator== (const ARB_Snapshot &lhs, const ARB_Snapshot &rhs)
+    {
+        return lhs.size() == rhs.size() && std::equal (lhs.begin(), lhs.end(), rhs.begin());
+    }
+};
+
+/*
+ * A tree with one writer at a time. snapshot() is the only member function that may be called
+ * concurrently with a modification
+ */
+template<typename Key_T, typename Compare = std::less<Key_T>,
+         typename Allocator = std::allocator<Key_T>>
+class Persistent_ARB_Tree final
+{
+    using node_type = detail::Persistent_Node<Key_T>;
+    using node_ptr = typename node_type::node_ptr;
+    using const_node_ptr = const node_type *;
+    using color_type = typename node_type::color_type;
+
+    std::atomic<node_ptr> root_;
+    [[no_unique_address]] Allocator alloc_;
+    Compare comp_;
+
+public:
+
+    using key_type = Key_T;
+    using value_type = Key_T;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+    using snapshot_type = ARB_Snapshot<Key_T, Compare>;
+
+    Persistent_ARB_Tree () : Persistent_ARB_Tree{key_compare{}} {}
+
+    explicit Persistent_ARB_Tree (const key_compare &comp,
+                                  const allocator_type &alloc = allocator_type{})
+                                 : alloc_{alloc}, comp_{comp} {}
+
+    Persistent_ARB_Tree (std::initializer_list<value_type> ilist,
+                         const key_compare &comp = key_compare{},
+                         const allocator_type &alloc = allocator_type{})
+                        : Persistent_ARB_Tree{comp, alloc}
+    {
+        for (auto &key : ilist)
+            insert (key);
+    }
+
+    // Copies share all nodes, so they take O(1) time
+    Persistent_ARB_Tree (const Persistent_ARB_Tree &rhs)
+                        : root_{rhs.root_.load()}, alloc_{rhs.alloc_}, comp_{rhs.comp_} {}
+
+    Persistent_ARB_Tree &operator= (const Persistent_ARB_Tree &rhs)
+    {
+        root_.store (rhs.root_.load());
+        comp_ = rhs.comp_;
+
+        return *this;
+    }
+
+    allocator_type get_allocator () const { return alloc_; }
+    const key_compare &key_comp () const { return comp_; }
+
+    // O(1). Nodes of the snapshot are kept alive until it is destroyed
+    snapshot_type snapshot () const { return snapshot_type{root_.load(), comp_}; }
+
+    size_type size () const { return node_type::size (root_.load().get()); }
+    bool empty () const { return size() == 0; }
+
+    void clear () { root_.store (nullptr); }
+
+    // Copies O(log n) nodes. Returns false if the key is already in the tree
+    bool insert (const key_type &key)
+    {
+        auto root = root_.load();
+        if (detail::find_persistent_node (root.get(), key, comp_))
+            return false;
+
+        root_.store (blacken (insert_impl (root, key)));
+
+        assert (verifier());
+        return true;
+    }
+
+    // Copies O(log n) nodes. Returns the number of erased keys
+    size_type erase (const key_type &key)
+    {
+        auto root = root_.load();
+        if (detail::find_persistent_node (root.get(), key, comp_) == nullptr)
+            return 0;
+
+        root_.store (blacken (erase_impl (root, key)));
+
+        assert (verifier());
+        return 1;
+    }
+
+private:
+
+    template<typename K>
+    node_ptr make (color_type color, node_ptr left, K &&key, node_ptr right) const
+    {
+        return std::allocate_shared<node_type>(alloc_, color, std::move (left),
+                                               std::forward<K>(key), std::move (right));
+    }
+
+    static bool is_red (const node_ptr &node) noexcept
+    {
+        return node && node->color_ == color_type::red;
+    }
+
+    static bool is_black_node (const node_ptr &node) noexcept
+    {
+        return node && node->color_ == color_type::black;
+    }
+
+    node_ptr with_color (const node_ptr &node, color_type color) const
+    {
+        assert (node);
+
+        if (node->color_ == color)
+            return node;
+
+        return make (color, node->left_, node->key_, node->right_);
+    }
+
+    node_ptr blacken (const node_ptr &node) const
+    {
+        return node ? with_color (node, color_type::black) : nullptr;
+    }
+
+    /*
+     * Builds a black node (left, key, right) and removes a red node with a red child if there is
+     * one among children of the node. Both children red are recolored black as well
+     */
+    node_ptr balance (const node_ptr &left, const key_type &key, const node_ptr &right) const
+    {
+        constexpr auto red = color_type::red;
+        constexpr auto black = color_type::black;
+
+        if (is_red (left) && is_red (right))
+            return make (red, with_color (left, black), key, with_color (right, black));
+
+        if (is_red (left))
+        {
+            if (is_red (left->left_))
+                return make (red, with_color (left->left_, black), left->key_,
+                             make (black, left->right_, key, right));
+
+            if (is_red (left->right_))
+            {
+                auto &middle = left->right_;
+                return make (red, make (black, left->left_, left->key_, middle->left_),
+                             middle->key_, make (black, middle->right_, key, right));
+            }
+        }
+
+        if (is_red (right))
+        {
+            if (is_red (right->right_))
+                return make (red, make (black, left, key, right->left_), right->key_,
+                             with_color (right->right_, black));
+
+            if (is_red (right->left_))
+            {
+                auto &middle = right->left_;
+                return make (red, make (black, left, key, middle->left_), middle->key_,
+                             make (black, middle->right_, right->key_, right->right_));
+            }
+        }
+
+        return make (black, left, key, right);
+    }
+
+    // key isn't in the subtree of node
+    node_ptr insert_impl (const node_ptr &node, const key_type &key) const
+    {
+        if (node == nullptr)
+            return make (color_type::red, nullptr, key, nullptr);
+
+        auto is_less = comp_(key, node->key_);
+        auto left = is_less ? insert_impl (node->left_, key) : node->left_;
+        auto right = is_less ? node->right_ : insert_impl (node->right_, key);
+
+        if (node->color_ == color_type::black)
+            return balance (left, node->key_, right);
+        else
+            return make (color_type::red, std::move (left), node->key_, std::move (right));
+    }
+
+    // The left subtree has lost a black node
+    node_ptr balance_left (const node_ptr &left, const key_type &key, const node_ptr &right) const
+    {
+        constexpr auto red = color_type::red;
+        constexpr auto black = color_type::black;
+
+        if (is_red (left))
+            return make (red, with_color (left, black), key, right);
+
+        if (is_black_node (right))
+            return balance (left, key, with_color (right, red));
+
+        assert (is_red (right) && is_black_node (right->left_));
+
+        auto &middle = right->left_;
+        return make (red, make (black, left, key, middle->left_), middle->key_,
+                     balance (middle->right_, right->key_, with_color (right->right_, red)));
+    }
+
+    // The right subtree has lost a black node
+    node_ptr balance_right (const node_ptr &left, const key_type &key, const node_ptr &right) const
+    {
+        constexpr auto red = color_type::red;
+        constexpr auto black = color_type::black;
+
+        if (is_red (right))
+            return make (red, left, key, with_color (right, black));
+
+        if (is_black_node (left))
+            return balance (with_color (left, red), key, right);
+
+        assert (is_red (left) && is_black_node (left->right_));
+
+        auto &middle = left->right_;
+        return make (red, balance (with_color (left->left_, red), left->key_, middle->left_),
+                     middle->key_, make (black, middle->right_, key, right));
+    }
+
+    // Concatenates subtrees of a removed node
+    node_ptr fuse (const node_ptr &left, const node_ptr &right) const
+    {
+        constexpr auto red = color_type::red;
+        constexpr auto black = color_type::black;
+
+        if (left == nullptr)
+            return right;
+        if (right == nullptr)
+            return left;
+
+        if (is_red (left) && is_red (right))
+        {
+            auto middle = fuse (left->right_, right->left_);
+            if (is_red (middle))
+                return make (red, make (red, left->left_, left->key_, middle->left_),
+                             middle->key_,
+                             make (red, middle->right_, right->key_, right->right_));
+
+            return make (red, left->left_, left->key_,
+                         make (red, std::move (middle), right->key_, right->right_));
+        }
+
+        if (!is_red (left) && !is_red (right))
+        {
+            auto middle = fuse (left->right_, right->left_);
+            if (is_red (middle))
+                return make (red, make (black, left->left_, left->key_, middle->left_),
+                             middle->key_,
+                             make (black, middle->right_, right->key_, right->right_));
+
+            return balance_left (left->left_, left->key_,
+                                 make (black, std::move (middle), right->key_, right->right_));
+        }
+
+        if (is_red (right))
+            return make (red, fuse (left, right->left_), right->key_, right->right_);
+
+        return make (red, left->left_, left->key_, fuse (left->right_, right));
+    }
+
+    // key is in the subtree of node. Black height of the result is one less if node is black
+    node_ptr erase_impl (const node_ptr &node, const key_type &key) const
+    {
+        assert (node);
+
+        if (comp_(key, node->key_))
+        {
+            auto left = erase_impl (node->left_, key);
+            if (is_black_node (node->left_))
+                return balance_left (left, node->key_, node->right_);
+
+            return make (color_type::red, std::move (left), node->key_, node->right_);
+        }
+
+        if (comp_(node->key_, key))
+        {
+            auto right = erase_impl (node->right_, key);
+            if (is_black_node (node->right_))
+                return balance_right (node->left_, node->key_, right);
+
+            return make (color_type::red, node->left_, node->key_, std::move (right));
+        }
+
+        return fuse (node->left_, node->right_);
+    }
+
+    bool verifier () const
+    {
+        auto root = root_.load();
+        if (is_red (root))
+            return false;
+
+        const key_type *prev = nullptr;
+        return subtree_verifier (root.get(), prev) != 0;
+    }
+
+    // Returns black height of the subtree or 0 if it is broken
+    std::size_t subtree_verifier (const_node_ptr node, const key_type *&prev) const
+    {
+        if (node == nullptr)
+            return 1;
+
+        auto is_node_red = (node->color_ == color_type::red);
+        if (is_node_red && (is_red (node->left_) || is_red (node->right_)))
+            return 0;
+
+        auto expected_size = 1 + node_type::size (node->left_.get())
+                               + node_type::size (node->right_.get());
+        if (node->subtree_size_ != expected_size)
+            return 0;
+
+        auto left_height = subtree_verifier (node->left_.get(), prev);
+
+        if (prev && !comp_(*prev, node->key_))
+            return 0;
+        prev = &node->key_;
+
+        auto right_height = subtree_verifier (node->right_.get(), prev);
+        if (left_height == 0 || left_height != right_height)
+            return 0;
+
+        return left_height + !is_node_red;
+    }
+};
+
+} // namespace yLab
+
+#endif // INCLUDE_PERSISTENT_TREE_HPP
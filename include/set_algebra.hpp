@@ -0,0 +1,237 @@
+/*
+ * This header contains union, intersection and difference of ARB_Trees.
+ *
+ * The operations are built on split and join. One tree is exposed as (left, root, right), the
+ * other one is split by the key of that root, the operation is applied to the pairs of lesser and
+ * greater parts and the results are joined back. Both halves are independent, so the upper levels
+ * of recursion run them in parallel: one half is handed to std::async and the other one is
+ * processed by the current thread. Small subproblems are always processed serially.
+ *
+ * The operations take their arguments by value and reuse their nodes, so moving trees in makes
+ * no allocations at all. Nodes that don't get into the result are destroyed by the calling thread
+ * after all tasks are done, so the allocator doesn't have to be thread-safe. The comparator is
+ * called concurrently and mustn't throw.
+ */
+
+#ifndef INCLUDE_SET_ALGEBRA_HPP
+#define INCLUDE_SET_ALGEBRA_HPP
+
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <bit>
+
+#include "arb_tree.hpp"
+
+namespace yLab
+{
+
+namespace detail
+{
+
+enum class Set_Operation { union_, intersection, difference };
+
+struct Set_Algebra
+{
+    // Subproblems with fewer keys than that are never split between threads
+    static constexpr std::size_t parallel_grain = 1 << 12;
+
+    /*
+     * Roots of dropped subtrees are linked through their parent pointers which are meaningless
+     * for detached subtrees anyway
+     */
+    template<typename Node_T>
+    struct Dropped_List
+    {
+        Node_T *head = nullptr;
+        Node_T *tail = nullptr;
+
+        void push (Node_T *root) noexcept
+        {
+            if (root == nullptr)
+                return;
+
+            root->set_parent (head);
+            head = root;
+            if (tail == nullptr)
+                tail = root;
+        }
+
+        void splice (Dropped_List other) noexcept
+        {
+            if (other.head == nullptr)
+                return;
+
+            if (head == nullptr)
+                head = other.head;
+            else
+                tail->set_parent (other.head);
+
+            tail = other.tail;
+        }
+    };
+
+    template<typename Node_T, typename Balance_T>
+    struct Result
+    {
+        Subtree<Node_T, Balance_T> tree;
+        Dropped_List<Node_T> dropped;
+    };
+
+    template<Set_Operation Op, typename Tree>
+    static Tree run (Tree lhs, Tree rhs)
+    {
+        // Nodes of rhs are adopted by lhs, so they have to come from an equal allocator
+        Tree other{std::move (rhs), lhs.get_allocator()};
+
+        // hardware_concurrency() is 0 if it's unknown
+        auto n_threads = std::max (std::thread::hardware_concurrency(), 1u);
+        auto depth = static_cast<std::size_t>(std::bit_width (n_threads));
+        auto [tree, dropped] = apply<Op>(lhs.detach_subtree(), other.detach_subtree(), lhs.comp_,
+                                         depth);
+
+        for (auto root = dropped.head; root != nullptr;)
+        {
+            auto next = root->parent_unsafe();
+            lhs.top_node_.destroy_subtree (root);
+            root = next;
+        }
+
+        lhs.adopt_subtree (tree);
+
+        return lhs;
+    }
+
+    template<Set_Operation Op, typename Node_T, typename Balance_T, typename Compare>
+    static Result<Node_T, Balance_T> apply (Subtree<Node_T, Balance_T> lhs,
+                                            Subtree<Node_T, Balance_T> rhs,
+                                            const Compare &comp, std::size_t depth)
+    {
+        if (lhs.root == nullptr || rhs.root == nullptr)
+            return trivial_case<Op>(lhs, rhs);
+
+        auto n_keys = Node_T::size (lhs.root) + Node_T::size (rhs.root);
+
+        auto pivot = lhs.root;
+        auto left = detach_child (lhs, pivot->get_left());
+        auto right = detach_child (lhs, pivot->get_right());
+
+        pivot->set_left (nullptr);
+        pivot->set_right (nullptr);
+        pivot->subtree_size_ = 1;
+
+        auto [less, equal, greater] = split (rhs, pivot->key(), comp);
+
+        // Subproblems below the last level of forking are solved by the thread that reaches them
+        auto child_depth = (depth != 0) ? depth - 1 : 0;
+        auto [lesser, greater_result] = fork (
+            depth != 0 && n_keys >= parallel_grain,
+            [&]{ return apply<Op>(left, less, comp, child_depth); },
+            [&]{ return apply<Op>(right, greater, comp, child_depth); });
+
+        Result<Node_T, Balance_T> result;
+        result.dropped.splice (lesser.dropped);
+        result.dropped.splice (greater_result.dropped);
+        result.dropped.push (equal);
+
+        auto keep_pivot = (Op == Set_Operation::union_) ||
+                          ((Op == Set_Operation::intersection) == (equal != nullptr));
+        if (keep_pivot)
+            result.tree = join (lesser.tree, pivot, greater_result.tree);
+        else
+        {
+            result.dropped.push (pivot);
+            result.tree = join (lesser.tree, greater_result.tree);
+        }
+
+        return result;
+    }
+
+    // At least one of the subtrees is empty
+    template<Set_Operation Op, typename Node_T, typename Balance_T>
+    static Result<Node_T, Balance_T> trivial_case (Subtree<Node_T, Balance_T> lhs,
+                                                   Subtree<Node_T, Balance_T> rhs) noexcept
+    {
+        Result<Node_T, Balance_T> result;
+
+        if constexpr (Op == Set_Operation::union_)
+            result.tree = lhs.root ? lhs : rhs;
+        else if constexpr (Op == Set_Operation::intersection)
+        {
+            result.dropped.push (lhs.root);
+            result.dropped.push (rhs.root);
+        }
+        else
+        {
+            result.tree = lhs;
+            result.dropped.push (rhs.root);
+        }
+
+        return result;
+    }
+
+    // Runs the first task on another thread if parallel is true and std::async succeeds
+    template<typename First_Task, typename Second_Task>
+    static auto fork (bool parallel, First_Task first_task, Second_Task second_task)
+    {
+        std::future<decltype (first_task())> first;
+
+        if (parallel)
+        {
+            try
+            {
+                first = std::async (std::launch::async, first_task);
+            }
+            // Neither a thread nor the shared state may be available. Both trees are detached
+            // at this point, so the task is run by this thread rather than lose them
+            catch (...) {}
+        }
+
+        if (first.valid())
+        {
+            auto second = second_task();
+            return std::pair{first.get(), std::move (second)};
+        }
+
+        auto first_result = first_task();
+        return std::pair{std::move (first_result), second_task()};
+    }
+};
+
+} // namespace detail
+
+// Keys that are in lhs or in rhs
+template<typename Key_T, typename Compare, typename Allocator, typename Node_T, typename Balance_T>
+ARB_Tree<Key_T, Compare, Allocator, Node_T, true, Balance_T> set_union (
+    ARB_Tree<Key_T, Compare, Allocator, Node_T, true, Balance_T> lhs,
+    ARB_Tree<Key_T, Compare, Allocator, Node_T, true, Balance_T> rhs)
+{
+    using detail::Set_Operation;
+    return detail::Set_Algebra::run<Set_Operation::union_>(std::move (lhs), std::move (rhs));
+}
+
+// Keys that are both in lhs and in rhs
+template<typename Key_T, typename Compare, typename Allocator, typename Node_T, typename Balance_T>
+ARB_Tree<Key_T, Compare, Allocator, Node_T, true, Balance_T> set_intersection (
+    ARB_Tree<Key_T, Compare, Allocator, Node_T, true, Balance_T> lhs,
+    ARB_Tree<Key_T, Compare, Allocator, Node_T, true, Balance_T> rhs)
+{
+    using detail::Set_Operation;
+    return detail::Set_Algebra::run<Set_Operation::intersection>(std::move (lhs), std::move (rhs));
+}
+
+// Keys that are in lhs but not in rhs
+template<typename Key_T, typename Compare, typename Allocator, typename Node_T, typename Balance_T>
+ARB_Tree<Key_T, Compare, Allocator, Node_T, true, Balance_T> set_difference (
+    ARB_Tree<Key_T, Compare, Allocator, Node_T, true, Balance_T> lhs,
+    ARB_Tree<Key_T, Compare, Allocator, Node_T, true, Balance_T> rhs)
+{
+    using detail::Set_Operation;
+    return detail::Set_Algebra::run<Set_Operation::difference>(std::move (lhs), std::move (rhs));
+}
+
+} // namespace yLab
+
+#endif // INCLUDE_SET_ALGEBRA_HPP
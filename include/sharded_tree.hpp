@@ -0,0 +1,510 @@
+/*
+ * This header contains implementation of Sharded_ARB_Tree, a concurrent order-statistic set
+ * built from ARB_Tree instances.
+ *
+ * Every shard owns a range of keys and has its own mutex, so modifications of different shards
+ * don't wait for each other. Sizes of the shards are kept in a Fenwick tree of atomic counters:
+ * the global rank of a key is the number of keys in the preceding shards plus the rank of the
+ * key in its shard, and the k-th key is looked up in the shard that the Fenwick tree points to.
+ *
+ * The directory of shards (their bounds and the Fenwick tree) is guarded by a shared mutex.
+ * Lookups and modifications hold it shared. rebalance() holds it exclusively and splits large
+ * shards and joins small neighbours. Both operations take O(log n) time, so the directory is
+ * locked briefly. Rebalancing plans new shards and allocates them before it moves any key, so a
+ * failure leaves the tree as it was. A writer that has made its shard too large rebalances the
+ * tree if no one else holds the directory. After start_background_rebalancing() the writer
+ * only wakes up a background thread that does it.
+ *
+ * Queries lock one shard at a time. A query sees every shard as it was at some moment during
+ * the call, which is not necessarily the same moment for all shards.
+ */
+
+#ifndef INCLUDE_SHARDED_TREE_HPP
+#define INCLUDE_SHARDED_TREE_HPP
+
+#include <cstddef>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include <span>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <bit>
+
+#include "arb_tree.hpp"
+
+namespace yLab
+{
+
+namespace detail
+{
+
+// Fenwick tree of counters that any number of threads may update and query at once
+class Atomic_Fenwick_Tree final
+{
+    std::vector<std::atomic<std::size_t>> tree_; // tree_[0] is not used
+
+public:
+
+    explicit Atomic_Fenwick_Tree (std::size_t n = 0) : tree_(n + 1) {}
+
+    std::size_t size () const noexcept { return tree_.size() - 1; }
+
+    // Not thread-safe
+    void assign (std::span<const std::size_t> values)
+    {
+        tree_ = std::vector<std::atomic<std::size_t>>(values.size() + 1);
+
+        for (std::size_t i = 0; i != values.size(); ++i)
+            add (i, values[i]);
+    }
+
+    // Counters wrap around, so a negative delta converted to std::size_t decrements a counter
+    void add (std::size_t i, std::size_t delta) noexcept
+    {
+        for (++i; i < tree_.size(); i += i & (~i + 1))
+            tree_[i].fetch_add (delta, std::memory_order_relaxed);
+    }
+
+    // Sum of the first i counters. Every concurrent add() is either counted or not as a whole,
+    // because the sum reads exactly one node that the add() has updated
+    std::size_t prefix (std::size_t i) const noexcept
+    {
+        std::size_t sum = 0;
+
+        for (; i; i &= i - 1)
+            sum += tree_[i].load (std::memory_order_relaxed);
+
+        return sum;
+    }
+
+    // Index of the counter that holds the k-th unit (k starts from 1) and the sum of the
+    // preceding counters. The index is size() if k exceeds the sum of all counters
+    std::pair<std::size_t, std::size_t> find (std::size_t k) const noexcept
+    {
+        std::size_t pos = 0;
+        std::size_t sum = 0;
+
+        for (auto step = std::bit_floor (size()); step; step >>= 1)
+        {
+            if (pos + step > size())
+                continue;
+
+            if (auto node_sum = tree_[pos + step].load (std::memory_order_relaxed);
+                sum + node_sum < k)
+            {
+                pos += step;
+                sum += node_sum;
+            }
+        }
+
+        return {pos, sum};
+    }
+};
+
+} // namespace detail
+
+template<typename Key_T, typename Compare = std::less<Key_T>,
+         typename Allocator = std::allocator<Key_T>>
+class Sharded_ARB_Tree final
+{
+public:
+
+    using key_type = Key_T;
+    using value_type = Key_T;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+    using shard_type = ARB_Tree<Key_T, Compare, Allocator>;
+
+    static constexpr size_type default_max_shard_size = size_type{1} << 16;
+
+private:
+
+    struct Shard
+    {
+        mutable std::mutex mutex_;
+        shard_type tree_;
+
+        explicit Shard (shard_type &&tree) : tree_{std::move (tree)} {}
+    };
+
+    mutable std::shared_mutex directory_mutex_;
+
+    // Shard i holds keys in [bounds_[i - 1], bounds_[i])
+    std::vector<key_type> bounds_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    detail::Atomic_Fenwick_Tree sizes_;
+
+    key_compare comp_;
+    allocator_type alloc_;
+    size_type max_shard_size_;
+
+    enum class Rebalancer_State { idle, requested, stopped };
+
+    std::atomic<Rebalancer_State> rebalancer_state_ = Rebalancer_State::idle;
+    std::thread rebalancer_;
+
+public:
+
+    Sharded_ARB_Tree () : Sharded_ARB_Tree{key_compare{}} {}
+
+    explicit Sharded_ARB_Tree (const key_compare &comp,
+                               const allocator_type &alloc = allocator_type{},
+                               size_type max_shard_size = default_max_shard_size)
+                              : Sharded_ARB_Tree{{}, comp, alloc, max_shard_size} {}
+
+    // Starts with shards split at bounds that have to be sorted in increasing order
+    explicit Sharded_ARB_Tree (std::vector<key_type> bounds,
+                               const key_compare &comp = key_compare{},
+                               const allocator_type &alloc = allocator_type{},
+                               size_type max_shard_size = default_max_shard_size)
+                              : bounds_{std::move (bounds)}, sizes_{bounds_.size() + 1},
+                                comp_{comp}, alloc_{alloc}, max_shard_size_{max_shard_size}
+    {
+        assert (max_shard_size_ != 0);
+        assert (std::adjacent_find (bounds_.begin(), bounds_.end(),
+                                    [this](const key_type &lhs, const key_type &rhs)
+                                    {
+                                        return !comp_(lhs, rhs);
+                                    }) == bounds_.end());
+
+        for (std::size_t i = 0; i <= bounds_.size(); ++i)
+            shards_.push_back (std::make_unique<Shard>(shard_type{comp_, alloc_}));
+    }
+
+    ~Sharded_ARB_Tree ()
+    {
+        if (rebalancer_.joinable())
+        {
+            rebalancer_state_.store (Rebalancer_State::stopped);
+            rebalancer_state_.notify_one();
+            rebalancer_.join();
+        }
+    }
+
+    // Shards hold mutexes
+    Sharded_ARB_Tree (const Sharded_ARB_Tree &rhs) = delete;
+    Sharded_ARB_Tree &operator= (const Sharded_ARB_Tree &rhs) = delete;
+
+    allocator_type get_allocator () const { return alloc_; }
+    const key_compare &key_comp () const { return comp_; }
+
+    size_type size () const
+    {
+        std::shared_lock directory_lock{directory_mutex_};
+        return sizes_.prefix (sizes_.size());
+    }
+
+    bool empty () const { return size() == 0; }
+
+    size_type n_shards () const
+    {
+        std::shared_lock directory_lock{directory_mutex_};
+        return shards_.size();
+    }
+
+    // Modifiers
+
+    bool insert (const key_type &key)
+    {
+        bool inserted;
+        bool is_overfull;
+
+        {
+            std::shared_lock directory_lock{directory_mutex_};
+
+            auto i = shard_index (key);
+            std::lock_guard shard_lock{shards_[i]->mutex_};
+            auto &tree = shards_[i]->tree_;
+
+            inserted = tree.insert (key).second;
+            if (inserted)
+                sizes_.add (i, 1);
+
+            is_overfull = (tree.size() > 2 * max_shard_size_);
+        }
+
+        if (is_overfull)
+            request_rebalance();
+
+        return inserted;
+    }
+
+    size_type erase (const key_type &key)
+    {
+        std::shared_lock directory_lock{directory_mutex_};
+
+        auto i = shard_index (key);
+        std::lock_guard shard_lock{shards_[i]->mutex_};
+
+        auto n_erased = shards_[i]->tree_.erase (key);
+        if (n_erased)
+            sizes_.add (i, size_type(0) - n_erased);
+
+        return n_erased;
+    }
+
+    // Splits shards larger than the maximum shard size and joins neighbours while their total
+    // size is no more than a half of the maximum. Blocks all other operations
+    void rebalance ()
+    {
+        std::unique_lock directory_lock{directory_mutex_};
+        rebalance_impl();
+    }
+
+    /*
+     * Starts a thread that rebalances the tree when a writer asks it to, so writers don't run
+     * rebalancing themselves. Has to be called before the tree is shared between threads
+     */
+    void start_background_rebalancing ()
+    {
+        assert (!rebalancer_.joinable());
+
+        rebalancer_ = std::thread{[this]
+        {
+            for (;;)
+            {
+                rebalancer_state_.wait (Rebalancer_State::idle);
+
+                // Requests made while rebalancing is running are served by the next round
+                auto state = Rebalancer_State::requested;
+                if (!rebalancer_state_.compare_exchange_strong (state, Rebalancer_State::idle))
+                    return; // stopped
+
+                // The tree stays as it was if rebalancing fails; the next request retries
+                try { rebalance(); } catch (...) {}
+            }
+        }};
+    }
+
+    // Lookup
+
+    bool contains (const key_type &key) const
+    {
+        std::shared_lock directory_lock{directory_mutex_};
+
+        auto i = shard_index (key);
+        std::lock_guard shard_lock{shards_[i]->mutex_};
+
+        return shards_[i]->tree_.contains (key);
+    }
+
+    // Order statistics
+
+    // k-th smallest key. As in ARB_Tree, k starts from 1
+    std::optional<key_type> operator[] (size_type k) const
+    {
+        if (k == 0)
+            return std::nullopt;
+
+        std::shared_lock directory_lock{directory_mutex_};
+
+        // Retries if the shard has changed after the Fenwick tree was read
+        for (;;)
+        {
+            auto [i, n_before] = sizes_.find (k);
+            if (i == shards_.size())
+                return std::nullopt;
+
+            std::lock_guard shard_lock{shards_[i]->mutex_};
+            auto &tree = shards_[i]->tree_;
+
+            if (auto local_k = k - n_before; local_k <= tree.size())
+                return *tree[local_k];
+        }
+    }
+
+    size_type n_less_than (const key_type &key) const
+    {
+        return global_rank (key, [&key](const shard_type &tree){ return tree.n_less_than (key); });
+    }
+
+    size_type n_less_equal (const key_type &key) const
+    {
+        return global_rank (key, [&key](const shard_type &tree){ return tree.n_less_equal (key); });
+    }
+
+    // Calls action for every key in increasing order. Locks one shard at a time
+    template<typename F>
+    void for_each (F action) const
+    {
+        std::shared_lock directory_lock{directory_mutex_};
+
+        for (auto &shard : shards_)
+        {
+            std::lock_guard shard_lock{shard->mutex_};
+
+            for (auto &key : shard->tree_)
+                action (key);
+        }
+    }
+
+private:
+
+    size_type shard_index (const key_type &key) const
+    {
+        return std::upper_bound (bounds_.begin(), bounds_.end(), key, comp_) - bounds_.begin();
+    }
+
+    template<typename Rank_In_Shard>
+    size_type global_rank (const key_type &key, Rank_In_Shard rank_in_shard) const
+    {
+        std::shared_lock directory_lock{directory_mutex_};
+
+        auto i = shard_index (key);
+        std::lock_guard shard_lock{shards_[i]->mutex_};
+
+        return sizes_.prefix (i) + rank_in_shard (shards_[i]->tree_);
+    }
+
+    void request_rebalance ()
+    {
+        if (rebalancer_.joinable())
+        {
+            auto state = Rebalancer_State::idle;
+            if (rebalancer_state_.compare_exchange_strong (state, Rebalancer_State::requested))
+                rebalancer_state_.notify_one();
+        }
+        else if (std::unique_lock directory_lock{directory_mutex_, std::try_to_lock})
+            rebalance_impl();
+    }
+
+    /*
+     * Decides how shards are rebalanced by their sizes. Calls join (i) if shard i is appended to
+     * the last new shard, push (i) if shard i starts a new one and cut (rank) if the last new
+     * shard is split in two at rank. Runs of small neighbours are joined, and a large shard is
+     * cut into pieces of equal size that fit
+     */
+    template<typename Join, typename Push, typename Cut>
+    void plan_rebalancing (Join join, Push push, Cut cut) const
+    {
+        size_type last_size = 0;
+
+        for (std::size_t i = 0; i != shards_.size(); ++i)
+        {
+            auto size = shards_[i]->tree_.size();
+
+            if (i != 0 && last_size + size <= max_shard_size_ / 2)
+            {
+                join (i);
+                last_size += size;
+                continue;
+            }
+
+            push (i);
+            last_size = size;
+
+            while (last_size > max_shard_size_)
+            {
+                auto n_pieces = (last_size + max_shard_size_ - 1) / max_shard_size_;
+                auto rank = last_size / n_pieces;
+
+                cut (rank);
+                last_size -= rank;
+            }
+        }
+    }
+
+    /*
+     * The directory has to be locked exclusively, so no shard is locked by anyone. Bounds, sizes
+     * and shards of the new directory are made first. Only moves, joins and splits of trees,
+     * which don't throw, are left after that
+     */
+    void rebalance_impl ()
+    {
+        std::vector<key_type> bounds;
+        std::vector<size_type> sizes;
+        std::size_t last_pushed = 0;
+        size_type n_cut = 0; // keys of the last pushed shard that are in previous pieces
+
+        plan_rebalancing (
+            [&](std::size_t i){ sizes.back() += shards_[i]->tree_.size(); },
+            [&](std::size_t i)
+            {
+                if (i != 0)
+                    bounds.push_back (bounds_[i - 1]);
+                sizes.push_back (shards_[i]->tree_.size());
+
+                last_pushed = i;
+                n_cut = 0;
+            },
+            [&](size_type rank)
+            {
+                auto rest = sizes.back() - rank;
+                sizes.back() = rank;
+                sizes.push_back (rest);
+
+                n_cut += rank;
+                bounds.push_back (*shards_[last_pushed]->tree_[n_cut + 1]);
+            });
+
+        std::vector<std::unique_ptr<Shard>> shards;
+        shards.reserve (sizes.size());
+        for (std::size_t j = 0; j != sizes.size(); ++j)
+            shards.push_back (std::make_unique<Shard>(shard_type{comp_, alloc_}));
+
+        detail::Atomic_Fenwick_Tree new_sizes;
+        new_sizes.assign (sizes);
+
+        std::size_t n_shards = 0;
+        plan_rebalancing (
+            [&](std::size_t i)
+            {
+                auto &last = shards[n_shards - 1]->tree_;
+                last = shard_type::join (std::move (last), std::move (shards_[i]->tree_));
+            },
+            [&](std::size_t i){ shards[n_shards++]->tree_ = std::move (shards_[i]->tree_); },
+            [&](size_type rank)
+            {
+                auto &last = shards[n_shards - 1]->tree_;
+                auto [less, greater] = last.split_at_rank (rank);
+
+                last = std::move (less);
+                shards[n_shards++]->tree_ = std::move (greater);
+            });
+
+        assert (n_shards == shards.size());
+
+        shards_.swap (shards);
+        bounds_.swap (bounds);
+        sizes_ = std::move (new_sizes);
+
+        assert (verifier());
+    }
+
+    bool verifier () const
+    {
+        if (shards_.size() != bounds_.size() + 1 || sizes_.size() != shards_.size())
+            return false;
+
+        for (std::size_t i = 0; i != shards_.size(); ++i)
+        {
+            auto &tree = shards_[i]->tree_;
+
+            if (sizes_.prefix (i + 1) - sizes_.prefix (i) != tree.size())
+                return false;
+
+            if (tree.empty())
+                continue;
+
+            if (i != 0 && comp_(*tree.begin(), bounds_[i - 1]))
+                return false;
+
+            if (i != bounds_.size() && !comp_(*std::prev (tree.end()), bounds_[i]))
+                return false;
+        }
+
+        return true;
+    }
+};
+
+} // namespace yLab
+
+#endif // INCLUDE_SHARDED_TREE_HPP
@@ -16,7 +16,7 @@ template <typename Node_T>
 class tree_iterator final
 {
     using const_node_ptr = const Node_T *;
-    using const_end_node_ptr = const End_Node<Node_T> *;
+    using const_end_node_ptr = const typename Node_T::end_node_type *;
 
     const_end_node_ptr node_;
 
@@ -62,7 +62,17 @@ public:
 
     bool operator== (const tree_iterator &rhs) const noexcept { return node_ == rhs.node_; }
 
-    template<typename key_t, typename compare> friend class ARB_Tree;
+    // Takes O(log n) time: positions of both nodes are computed from subtree sizes. It makes
+    // tree_iterator a sized sentinel for itself, so std::ranges::distance is fast
+    friend difference_type operator- (const tree_iterator &lhs, const tree_iterator &rhs) noexcept
+    {
+        return static_cast<difference_type>(detail::rank (lhs.node_)) -
+               static_cast<difference_type>(detail::rank (rhs.node_));
+    }
+
+    template<typename key_t, typename compare, typename allocator, typename node_t,
+             bool unique_keys, typename balance_t>
+    friend class ARB_Tree;
 };
 
 } // namespace yLab
@@ -4,6 +4,8 @@
 # argv[2]: weight of "insert" query
 # argv[3]: weight of "kth smallest" query
 # argv[4]: weight of "n less than" query
+#
+# TEST_DRIVER selects the tested executable, e.g. TEST_DRIVER=bplus_driver
 
 green="\033[1;32m"
 red="\033[1;31m"
@@ -15,7 +17,7 @@ data="data/"
 bin_dir="bin/"
 
 test_generator="generator"
-test_driver="driver"
+test_driver="${TEST_DRIVER:-driver}"
 ans_generator="ans_generator"
 
 function build_from_sources
@@ -3,10 +3,22 @@
 #include <fstream>
 #include <chrono>
 
+#ifdef COUNT_ROTATIONS
+#include <vector>
+#include <algorithm>
+#include <random>
+#endif
+
 #ifdef STD_SET
 #include <set>
+#elif defined(BPLUS_TREE)
+#include "bplus_tree.hpp"
 #else
 #include "arb_tree.hpp"
+
+#ifndef BALANCE_POLICY
+#define BALANCE_POLICY Red_Black_Balance
+#endif
 #endif
 
 #include "common.hpp"
@@ -15,8 +27,11 @@ int main ()
 {
     #ifdef STD_SET
     std::set<int> tree;
+    #elif defined(BPLUS_TREE)
+    yLab::BPlus_Tree<int> tree;
     #else
-    yLab::ARB_Tree<int> tree;
+    yLab::ARB_Tree<int, std::less<int>, std::allocator<int>, yLab::ARB_Node<int>, true,
+                   yLab::BALANCE_POLICY> tree;
     #endif
 
     #ifdef STD_SET
@@ -25,6 +40,7 @@ int main ()
     std::ofstream file{"driver.info"};
     #endif
     auto start = std::chrono::high_resolution_clock::now();
+    [[maybe_unused]] std::size_t n_inserts = 0;
 
     while (!std::cin.eof())
     {
@@ -40,6 +56,7 @@ int main ()
         {
             case end_to_end::Queries::key:
                 tree.insert (key_);
+                n_inserts++;
                 break;
 
             case end_to_end::Queries::kth_smallest:
@@ -72,5 +89,25 @@ int main ()
     auto finish = std::chrono::high_resolution_clock::now();
     file << duration_cast<std::chrono::milliseconds>(finish - start).count() << std::endl;
 
+    #if defined(COUNT_ROTATIONS) && !defined(STD_SET) && !defined(BPLUS_TREE)
+    // Shape of the tree and rotations per operation for comparison of balancing policies
+    file << "height: " << tree.height() << std::endl;
+    file << "rotations per insert: "
+         << (n_inserts ? static_cast<double>(yLab::detail::n_rotations) / n_inserts : 0.0)
+         << std::endl;
+
+    // There are no erase queries, so all keys are erased afterwards in a fixed random order
+    std::vector<int> keys (tree.begin(), tree.end());
+    std::shuffle (keys.begin(), keys.end(), std::mt19937{42});
+
+    yLab::detail::n_rotations = 0;
+    for (auto key : keys)
+        tree.erase (key);
+
+    file << "rotations per erase: "
+         << (keys.empty() ? 0.0 : static_cast<double>(yLab::detail::n_rotations) / keys.size())
+         << std::endl;
+    #endif
+
     return 0;
 }
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include <memory_resource>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include <set>
+
+#include "arb_tree.hpp"
+
+namespace
+{
+
+struct Allocation_Stats
+{
+    std::size_t n_allocations = 0;
+    std::size_t n_deallocations = 0;
+};
+
+template<typename T>
+struct Counting_Allocator
+{
+    using value_type = T;
+
+    Allocation_Stats *stats_;
+
+    explicit Counting_Allocator (Allocation_Stats *stats) noexcept : stats_{stats} {}
+
+    template<typename U>
+    Counting_Allocator (const Counting_Allocator<U> &rhs) noexcept : stats_{rhs.stats_} {}
+
+    T *allocate (std::size_t n)
+    {
+        stats_->n_allocations += n;
+        return std::allocator<T>{}.allocate (n);
+    }
+
+    void deallocate (T *ptr, std::size_t n) noexcept
+    {
+        stats_->n_deallocations += n;
+        std::allocator<T>{}.deallocate (ptr, n);
+    }
+
+    template<typename U>
+    bool operator== (const Counting_Allocator<U> &rhs) const noexcept
+    {
+        return stats_ == rhs.stats_;
+    }
+};
+
+} // unnamed namespace
+
+TEST (Allocators, Nodes_Go_Through_Allocator)
+{
+    Allocation_Stats stats;
+
+    {
+        using allocator_type = Counting_Allocator<int>;
+        yLab::ARB_Tree<int, std::less<int>, allocator_type> tree{allocator_type{&stats}};
+
+        for (auto key : {5, 3, 8, 1, 4, 7, 9, 3, 5})
+            tree.insert (key);
+
+        EXPECT_EQ (stats.n_allocations, tree.size());
+
+        tree.erase (8);
+        EXPECT_EQ (stats.n_deallocations, 1);
+
+        tree.clear();
+        EXPECT_EQ (stats.n_deallocations, stats.n_allocations);
+
+        tree.insert ({1, 2, 3});
+    }
+
+    EXPECT_EQ (stats.n_deallocations, stats.n_allocations);
+}
+
+TEST (Allocators, Polymorphic_Allocator)
+{
+    std::vector<std::byte> buffer(1 << 16);
+    std::pmr::monotonic_buffer_resource resource{buffer.data(), buffer.size(),
+                                                 std::pmr::null_memory_resource()};
+
+    yLab::pmr::ARB_Tree<int> tree{&resource};
+
+    std::vector<int> keys(500);
+    std::iota (keys.begin(), keys.end(), 0);
+    std::reverse (keys.begin(), keys.end());
+
+    for (auto key : keys)
+        tree.insert (key);
+
+    EXPECT_EQ (tree.get_allocator().resource(), &resource);
+    EXPECT_EQ (tree.size(), keys.size());
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), keys.rbegin(), keys.rend()));
+
+    auto copy = tree;
+    EXPECT_EQ (copy.get_allocator().resource(), std::pmr::get_default_resource());
+    EXPECT_EQ (copy, tree);
+}
+
+TEST (Allocators, Move_Assignment_With_Unequal_Resources)
+{
+    std::pmr::unsynchronized_pool_resource resource_1;
+    std::pmr::unsynchronized_pool_resource resource_2;
+
+    yLab::pmr::ARB_Tree<int> tree_1{{1, 2, 3, 4, 5}, &resource_1};
+    yLab::pmr::ARB_Tree<int> tree_2{{6, 7}, &resource_2};
+
+    tree_2 = std::move (tree_1);
+
+    EXPECT_EQ (tree_2.get_allocator().resource(), &resource_2);
+    EXPECT_EQ (tree_2, (yLab::pmr::ARB_Tree<int>{1, 2, 3, 4, 5}));
+    EXPECT_TRUE (tree_1.empty());
+
+    tree_1.insert (10);
+    EXPECT_EQ (*tree_1.begin(), 10);
+}
+
+TEST (Allocators, Swap)
+{
+    std::pmr::unsynchronized_pool_resource resource;
+
+    yLab::pmr::ARB_Tree<int> tree_1{{1, 2, 3}, &resource};
+    yLab::pmr::ARB_Tree<int> tree_2{&resource};
+
+    tree_1.swap (tree_2);
+
+    EXPECT_TRUE (tree_1.empty());
+    EXPECT_EQ (tree_1.begin(), tree_1.end());
+    EXPECT_EQ (tree_2.size(), 3);
+
+    tree_1.insert (4);
+    tree_2.insert (0);
+
+    std::set model = {0, 1, 2, 3};
+    EXPECT_TRUE (std::equal (tree_2.begin(), tree_2.end(), model.begin(), model.end()));
+    EXPECT_EQ (*tree_1.begin(), 4);
+}
+
+TEST (Allocators, Copy_Assignment_Reuses_Nodes)
+{
+    Allocation_Stats stats;
+    using allocator_type = Counting_Allocator<int>;
+    using tree_type = yLab::ARB_Tree<int, std::less<int>, allocator_type>;
+
+    tree_type tree_1{{1, 2, 3, 4, 5, 6, 7, 8}, allocator_type{&stats}};
+    tree_type tree_2{{10, 20, 30, 40, 50}, allocator_type{&stats}};
+    tree_type tree_3{{-1, -2}, allocator_type{&stats}};
+
+    auto n_allocations = stats.n_allocations;
+
+    tree_1 = tree_2;
+    EXPECT_EQ (tree_1, tree_2);
+    EXPECT_EQ (stats.n_allocations, n_allocations);
+    EXPECT_EQ (stats.n_deallocations, 3);
+
+    tree_3 = tree_2;
+    EXPECT_EQ (tree_3, tree_2);
+    EXPECT_EQ (stats.n_allocations, n_allocations + 3);
+
+    for (auto k = 1; k <= 5; ++k)
+    {
+        EXPECT_EQ (*tree_1[k], 10 * k);
+        EXPECT_EQ (tree_3.n_less_than (10 * k), k - 1);
+    }
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+#include <set>
+
+#include "arb_tree.hpp"
+
+namespace
+{
+
+struct Widen
+{
+    long long operator() (int key) const noexcept { return key; }
+};
+
+// Not commutative: the first and the last keys of a range
+struct First_Last
+{
+    using value_type = std::pair<int, int>;
+
+    static value_type make (int key) noexcept { return {key, key}; }
+
+    static value_type combine (const value_type &lhs, const value_type &rhs) noexcept
+    {
+        return {lhs.first, rhs.second};
+    }
+};
+
+using Sum_Tree = yLab::Augmented_ARB_Tree<int, yLab::Sum_Augmentation<int, Widen>>;
+
+long long model_sum (const std::set<int> &model, int lo, int hi)
+{
+    return std::accumulate (model.lower_bound (lo), model.lower_bound (hi), 0LL);
+}
+
+} // unnamed namespace
+
+TEST (Augmentation, Sum_Range)
+{
+    Sum_Tree tree;
+    std::set<int> model;
+
+    std::mt19937 gen{15};
+    std::uniform_int_distribution<int> key_dist{0, 2000};
+
+    for (auto i = 0; i != 3000; ++i)
+    {
+        auto key = key_dist (gen);
+        if (i % 3 == 2)
+        {
+            tree.erase (key);
+            model.erase (key);
+        }
+        else
+        {
+            tree.insert (key);
+            model.insert (key);
+        }
+
+        if (i % 50 == 0)
+        {
+            auto lo = key_dist (gen);
+            auto hi = key_dist (gen);
+            auto sum = tree.aggregate_range (lo, hi);
+
+            if (hi <= lo || model.lower_bound (lo) == model.lower_bound (hi))
+                EXPECT_FALSE (sum.has_value());
+            else
+                EXPECT_EQ (sum, model_sum (model, lo, hi));
+        }
+    }
+
+    EXPECT_EQ (tree.aggregate(), model_sum (model, 0, 2001));
+
+    tree.clear();
+    EXPECT_FALSE (tree.aggregate().has_value());
+}
+
+TEST (Augmentation, Order_Of_Combination)
+{
+    yLab::Augmented_ARB_Tree<int, First_Last> tree;
+    for (auto key = 100; key != 0; --key)
+        tree.insert (key);
+
+    EXPECT_EQ (tree.aggregate_range (10, 90), (std::pair{10, 89}));
+    EXPECT_EQ (tree.aggregate_range (0, 1000), (std::pair{1, 100}));
+    EXPECT_EQ (tree.aggregate_range (50, 51), (std::pair{50, 50}));
+    EXPECT_FALSE (tree.aggregate_range (200, 300).has_value());
+
+    for (auto key = 2; key <= 100; key += 2)
+        tree.erase (key);
+
+    EXPECT_EQ (tree.aggregate(), (std::pair{1, 99}));
+    EXPECT_EQ (tree.aggregate_range (10, 90), (std::pair{11, 89}));
+
+    using min_max_tree = yLab::Augmented_ARB_Tree<int, yLab::Min_Augmentation<int>>;
+    min_max_tree min_tree = {5, -3, 8, 12};
+    EXPECT_EQ (min_tree.aggregate(), -3);
+    EXPECT_EQ (min_tree.aggregate_range (0, 10), 5);
+}
+
+TEST (Augmentation, Weighted_Kth)
+{
+    // The weight of a key is the key itself
+    Sum_Tree tree;
+    std::vector<int> keys(200);
+    std::iota (keys.begin(), keys.end(), 1);
+    std::shuffle (keys.begin(), keys.end(), std::mt19937{3});
+
+    for (auto key : keys)
+        tree.insert (key);
+
+    for (long long weight : {1LL, 2LL, 3LL, 4LL, 100LL, 5050LL, 20100LL})
+    {
+        auto it = tree.lower_bound_by_aggregate ([weight](long long sum){ return sum >= weight; });
+
+        // 1 + 2 + ... + k >= weight
+        auto k = 1;
+        while (k * (k + 1) / 2 < weight)
+            ++k;
+
+        ASSERT_NE (it, tree.end());
+        EXPECT_EQ (*it, k);
+    }
+
+    EXPECT_EQ (tree.lower_bound_by_aggregate ([](long long sum){ return sum > 20100; }),
+               tree.end());
+}
+
+TEST (Augmentation, Structural_Operations)
+{
+    std::vector<int> keys(1000);
+    std::iota (keys.begin(), keys.end(), 0);
+
+    Sum_Tree tree{keys.begin(), keys.end()};
+    EXPECT_EQ (tree.aggregate(), 999 * 1000 / 2);
+
+    auto copy = tree;
+    EXPECT_EQ (copy.aggregate_range (100, 200), 14950);
+
+    auto [less, greater] = copy.split (500);
+    EXPECT_EQ (less.aggregate(), 499 * 500 / 2);
+    EXPECT_EQ (greater.aggregate(), 999 * 1000 / 2 - 499 * 500 / 2);
+
+    auto joined = Sum_Tree::join (std::move (less), std::move (greater));
+    EXPECT_EQ (joined.aggregate(), 999 * 1000 / 2);
+    EXPECT_EQ (joined.aggregate_range (400, 600), 99900);
+
+    auto [head, tail] = tree.split_at_rank (10);
+    EXPECT_EQ (head.aggregate(), 45);
+
+    auto handle = tail.extract (tail.begin());
+    handle.value() = -100;
+    head.insert (std::move (handle));
+    EXPECT_EQ (head.aggregate(), -55);
+    EXPECT_EQ (head.aggregate_range (-1000, 0), -100);
+
+    auto whole = Sum_Tree::join (std::move (head), std::move (tail));
+    EXPECT_EQ (whole.aggregate(), 999 * 1000 / 2 - 10 - 100);
+}
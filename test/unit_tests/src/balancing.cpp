@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <set>
+
+#include "set_algebra.hpp"
+
+// Tests specific to balancing policies. Modifiers check invariants of the policy in debug
+// builds. The Engine suite and others run the rest of the set API against every policy
+
+template<typename Balance_T>
+using Tree = yLab::ARB_Tree<int, std::less<int>, std::allocator<int>, yLab::ARB_Node<int>, true,
+                            Balance_T>;
+
+template<typename Balance_T>
+class Balancing : public testing::Test {};
+
+using Policies = testing::Types<yLab::Red_Black_Balance, yLab::AVL_Balance, yLab::WAVL_Balance,
+                                yLab::Treap_Balance>;
+TYPED_TEST_SUITE (Balancing, Policies);
+
+TYPED_TEST (Balancing, Sorted_Insertion)
+{
+    Tree<TypeParam> tree;
+    for (auto key = 0; key != 4096; ++key)
+        tree.insert (key);
+
+    // Sorted keys are the worst case of an unbalanced tree. Treaps are only balanced in
+    // expectation, so their bound is loose
+    EXPECT_LE (tree.height(), 40);
+
+    for (auto key = 0; key < 4096; key += 2)
+        tree.erase (key);
+
+    EXPECT_EQ (tree.size(), 2048);
+    EXPECT_EQ (*tree[1], 1);
+    EXPECT_LE (tree.height(), 40);
+}
+
+TYPED_TEST (Balancing, Copy_And_Build)
+{
+    std::vector<int> keys(1000);
+    std::iota (keys.begin(), keys.end(), 0);
+
+    for (auto n : {0, 1, 2, 3, 7, 8, 100, 1000})
+    {
+        Tree<TypeParam> tree (keys.begin(), keys.begin() + n);
+        EXPECT_EQ (tree.size(), n);
+
+        auto copy = tree;
+        EXPECT_EQ (copy, tree);
+
+        copy.insert (-1);
+        copy.erase (n / 2);
+        EXPECT_EQ (copy.size(), n + (n == 0 ? 1 : 0));
+    }
+}
+
+TYPED_TEST (Balancing, Split_Join)
+{
+    std::mt19937 gen{24};
+
+    for (auto n_left : {0, 1, 3, 64, 500})
+        for (auto n_right : {0, 1, 2, 31, 700})
+        {
+            std::vector<int> keys(n_left + n_right);
+            std::iota (keys.begin(), keys.end(), 0);
+
+            auto left_keys = std::vector(keys.begin(), keys.begin() + n_left);
+            auto right_keys = std::vector(keys.begin() + n_left, keys.end());
+            std::shuffle (left_keys.begin(), left_keys.end(), gen);
+            std::shuffle (right_keys.begin(), right_keys.end(), gen);
+
+            Tree<TypeParam> left{left_keys.begin(), left_keys.end()};
+            Tree<TypeParam> right{right_keys.begin(), right_keys.end()};
+
+            auto tree = Tree<TypeParam>::join (std::move (left), std::move (right));
+            ASSERT_EQ (tree.size(), keys.size());
+            EXPECT_TRUE (std::equal (tree.begin(), tree.end(), keys.begin(), keys.end()));
+
+            auto [less, greater] = tree.split (n_left / 2);
+            EXPECT_EQ (less.size(), n_left / 2);
+            EXPECT_EQ (greater.size(), keys.size() - n_left / 2);
+
+            greater.insert (-5);
+            EXPECT_EQ (*greater.begin(), -5);
+        }
+}
+
+TYPED_TEST (Balancing, Set_Algebra)
+{
+    std::mt19937 gen{25};
+    std::uniform_int_distribution<int> key_dist{0, 3000};
+
+    Tree<TypeParam> lhs, rhs;
+    std::set<int> lhs_model, rhs_model;
+    for (auto i = 0; i != 1000; ++i)
+    {
+        auto key = key_dist (gen);
+        lhs.insert (key);
+        lhs_model.insert (key);
+
+        key = key_dist (gen);
+        rhs.insert (key);
+        rhs_model.insert (key);
+    }
+
+    std::vector<int> expected;
+    std::set_union (lhs_model.begin(), lhs_model.end(), rhs_model.begin(), rhs_model.end(),
+                    std::back_inserter (expected));
+
+    auto result = yLab::set_union (std::move (lhs), std::move (rhs));
+    ASSERT_EQ (result.size(), expected.size());
+    EXPECT_TRUE (std::equal (result.begin(), result.end(), expected.begin(), expected.end()));
+}
+
+TYPED_TEST (Balancing, Multiset)
+{
+    yLab::ARB_Tree<int, std::less<int>, std::allocator<int>, yLab::Compact_ARB_Node<int>, false,
+                   TypeParam> tree;
+    std::multiset<int> model;
+
+    std::mt19937 gen{26};
+    std::uniform_int_distribution<int> key_dist{0, 50};
+
+    for (auto i = 0; i != 3000; ++i)
+    {
+        auto key = key_dist (gen);
+        if (gen() % 3 == 0)
+        {
+            if (auto it = model.find (key); it != model.end())
+                model.erase (it);
+            if (auto it = tree.find (key); it != tree.end())
+                tree.erase (it);
+        }
+        else
+        {
+            tree.insert (key);
+            model.insert (key);
+        }
+    }
+
+    ASSERT_EQ (tree.size(), model.size());
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+    EXPECT_EQ (tree.count (25), model.count (25));
+}
+
+TEST (Balancing, AVL_Is_Not_Higher_Than_Red_Black)
+{
+    std::mt19937 gen{27};
+
+    Tree<yLab::Red_Black_Balance> red_black;
+    Tree<yLab::AVL_Balance> avl;
+    Tree<yLab::WAVL_Balance> wavl;
+
+    for (auto i = 0; i != 20000; ++i)
+    {
+        auto key = static_cast<int>(gen() % 100000);
+        red_black.insert (key);
+        avl.insert (key);
+        wavl.insert (key);
+    }
+
+    // Without erasures a WAVL tree is an AVL tree
+    EXPECT_LE (avl.height(), red_black.height());
+    EXPECT_EQ (wavl.height(), avl.height());
+
+    // 1.44 * log2 (n + 2) bounds the height of an AVL tree
+    EXPECT_LE (avl.height(), 21);
+}
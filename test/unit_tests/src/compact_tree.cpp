@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+
+#include "arb_tree.hpp"
+
+TEST (Compact_Tree, Same_Behaviour_As_ARB_Tree)
+{
+    yLab::Compact_ARB_Tree<int> tree;
+    std::set<int> model;
+
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> dist{0, 300};
+
+    for (auto i = 0; i != 1000; ++i)
+    {
+        auto key = dist (gen);
+
+        if (i % 3 == 2)
+            EXPECT_EQ (tree.erase (key), model.erase (key));
+        else
+            EXPECT_EQ (tree.insert (key).second, model.insert (key).second);
+    }
+
+    ASSERT_EQ (tree.size(), model.size());
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+
+    auto k = 1;
+    for (auto key : model)
+    {
+        EXPECT_EQ (*tree[k], key);
+        EXPECT_EQ (tree.n_less_than (key), k - 1);
+        ++k;
+    }
+}
+
+TEST (Compact_Tree, Max_Size)
+{
+    yLab::Compact_ARB_Tree<int> tree;
+    EXPECT_LE (tree.max_size(), std::numeric_limits<std::uint32_t>::max() - 1);
+}
@@ -1,11 +1,21 @@
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <numeric>
+#include <memory>
+#include <vector>
+#include <set>
 
 #include "arb_tree.hpp"
+#include "engines.hpp"
 
-TEST (Constructors, Default_Constructor)
+template<typename Tree>
+class Constructors : public testing::Test {};
+
+TYPED_TEST_SUITE (Constructors, Engines);
+
+TYPED_TEST (Constructors, Default_Constructor)
 {
-    const yLab::ARB_Tree<int> tree;
+    const TypeParam tree;
     EXPECT_EQ (tree.size(), 0);
     EXPECT_TRUE (tree.empty());
     EXPECT_EQ (tree.begin(), tree.end());
@@ -13,20 +23,93 @@ TEST (Constructors, Default_Constructor)
     EXPECT_EQ (tree.upper_bound(1), tree.end());
 }
 
-TEST (Constructors, Copy_Constructor)
+TYPED_TEST (Constructors, Copy_Constructor)
 {
-    yLab::ARB_Tree<int> tree {1, 2, 3, 4, 5};
+    TypeParam tree {1, 2, 3, 4, 5};
 
     auto tree_2 {tree};
     EXPECT_EQ (tree, tree_2);
 }
 
-TEST (Constructors, Move_Constructor)
+TYPED_TEST (Constructors, Move_Constructor)
 {
-    yLab::ARB_Tree tree = {3, 2, 1, 4, 5};
+    TypeParam tree = {3, 2, 1, 4, 5};
     std::vector vec = {1, 2, 3, 4, 5};
 
     auto tree_2 = std::move (tree);
     EXPECT_EQ (tree_2.size(), 5);
     EXPECT_TRUE (std::equal (tree.begin(), tree.end(), vec.begin()));
 }
+
+TEST (ARB_Constructors, From_Sorted)
+{
+    for (auto n = 0; n != 70; ++n)
+    {
+        std::vector<int> vec(n);
+        std::iota (vec.begin(), vec.end(), 0);
+
+        auto tree = yLab::ARB_Tree<int>::from_sorted (vec.begin(), vec.end());
+
+        ASSERT_EQ (tree.size(), n);
+        EXPECT_TRUE (std::equal (tree.begin(), tree.end(), vec.begin(), vec.end()));
+
+        for (auto k = 1; k <= n; ++k)
+        {
+            EXPECT_EQ (*tree[k], k - 1);
+            EXPECT_EQ (tree.n_less_than (k - 1), k - 1);
+        }
+
+        // The tree stays valid after modifications
+        tree.insert (-1);
+        tree.insert (n);
+        tree.erase (n / 2);
+        EXPECT_EQ (tree.size(), n + 1);
+    }
+}
+
+TYPED_TEST (Constructors, Sorted_Range_With_Duplicates)
+{
+    std::vector vec = {1, 1, 2, 3, 3, 3, 4, 5, 5, 8, 13, 13};
+    std::set model(vec.begin(), vec.end());
+
+    TypeParam tree{vec.begin(), vec.end()};
+
+    EXPECT_EQ (tree.size(), model.size());
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+}
+
+TEST (ARB_Constructors, Sorted_Range_Of_Move_Only_Keys)
+{
+    std::vector<std::unique_ptr<int>> vec;
+    for (auto i = 0; i != 10; ++i)
+        vec.push_back (std::make_unique<int>(i));
+
+    std::sort (vec.begin(), vec.end());
+    std::vector<int *> ptrs;
+    for (auto &&ptr : vec)
+        ptrs.push_back (ptr.get());
+
+    yLab::ARB_Tree<std::unique_ptr<int>> tree{std::make_move_iterator (vec.begin()),
+                                              std::make_move_iterator (vec.end())};
+
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), ptrs.begin(), ptrs.end(),
+                             [](auto &&lhs, auto *rhs){ return lhs.get() == rhs; }));
+}
+
+TYPED_TEST (Constructors, Copy_Preserves_Structure)
+{
+    TypeParam tree;
+    for (auto key : {8, 3, 10, 1, 6, 14, 4, 7, 13, 2, 5})
+        tree.insert (key);
+    tree.erase (10);
+
+    auto copy = tree;
+
+    EXPECT_EQ (copy, tree);
+    for (std::size_t k = 1; k <= tree.size(); ++k)
+        EXPECT_EQ (*copy[k], *tree[k]);
+
+    copy.insert (0);
+    copy.erase (6);
+    EXPECT_EQ (copy, (TypeParam{0, 1, 2, 3, 4, 5, 7, 8, 13, 14}));
+}
@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <vector>
+#include <set>
+#include <memory>
+#include <new>
+
+#include "engines.hpp"
+
+template<typename Tree>
+class Engine : public testing::Test {};
+
+TYPED_TEST_SUITE (Engine, Engines);
+
+TYPED_TEST (Engine, Same_As_Std_Set)
+{
+    TypeParam tree;
+    std::set<int> model;
+
+    std::mt19937 gen{22};
+    std::uniform_int_distribution<int> key_dist{0, 2000};
+
+    for (auto i = 0; i != 6000; ++i)
+    {
+        auto key = key_dist (gen);
+
+        // Insertions win in the first half and erasures in the second one
+        if (gen() % 3 == (i < 3000 ? 0 : 1))
+            EXPECT_EQ (tree.erase (key), model.erase (key));
+        else
+        {
+            auto [it, inserted] = tree.insert (key);
+            EXPECT_EQ (inserted, model.insert (key).second);
+            EXPECT_EQ (*it, key);
+        }
+
+        if (i % 500 == 0)
+        {
+            ASSERT_EQ (tree.size(), model.size());
+            EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+        }
+    }
+
+    ASSERT_EQ (tree.size(), model.size());
+
+    auto model_it = model.begin();
+    for (std::size_t k = 1; k <= model.size(); ++k, ++model_it)
+    {
+        EXPECT_EQ (*tree[k], *model_it);
+        EXPECT_EQ (tree.rank (tree[k]), k - 1);
+    }
+    EXPECT_EQ (tree[0], tree.end());
+    EXPECT_EQ (tree[model.size() + 1], tree.end());
+
+    for (auto key = -1; key <= 2001; ++key)
+    {
+        auto lower = model.lower_bound (key);
+        auto upper = model.upper_bound (key);
+
+        EXPECT_EQ (tree.contains (key), model.contains (key));
+        EXPECT_EQ (tree.n_less_than (key), std::distance (model.begin(), lower));
+        EXPECT_EQ (tree.n_less_equal (key), std::distance (model.begin(), upper));
+        EXPECT_EQ (tree.n_greater_than (key), std::distance (upper, model.end()));
+
+        auto it = tree.lower_bound (key);
+        EXPECT_EQ (it == tree.end(), lower == model.end());
+        if (it != tree.end())
+        {
+            EXPECT_EQ (*it, *lower);
+        }
+    }
+
+    EXPECT_EQ (tree.count_range (100, 1500),
+               std::distance (model.lower_bound (100), model.lower_bound (1500)));
+}
+
+TYPED_TEST (Engine, Iterators)
+{
+    TypeParam tree;
+    for (auto key = 100; key != 0; --key)
+        tree.insert (key);
+
+    std::vector<int> forward (tree.begin(), tree.end());
+    std::vector<int> backward (tree.rbegin(), tree.rend());
+
+    ASSERT_EQ (forward.size(), 100);
+    EXPECT_TRUE (std::is_sorted (forward.begin(), forward.end()));
+    EXPECT_TRUE (std::equal (forward.begin(), forward.end(), backward.rbegin()));
+
+    auto it = tree.find (50);
+    EXPECT_EQ (*std::prev (it), 49);
+    EXPECT_EQ (*std::next (it), 51);
+    EXPECT_EQ (*std::prev (tree.end()), 100);
+
+    // Erasure by iterator returns the next key
+    it = tree.erase (tree.find (50));
+    EXPECT_EQ (*it, 51);
+    it = tree.erase (tree.find (100));
+    EXPECT_EQ (it, tree.end());
+}
+
+TYPED_TEST (Engine, Copy_And_Move)
+{
+    TypeParam tree;
+    for (auto key = 0; key != 300; ++key)
+        tree.insert (key * 7 % 300);
+
+    auto copy = tree;
+    EXPECT_EQ (copy, tree);
+
+    copy.erase (0);
+    EXPECT_NE (copy, tree);
+    EXPECT_LT (tree, copy);
+
+    auto moved = std::move (copy);
+    EXPECT_EQ (moved.size(), 299);
+    EXPECT_EQ (*moved[1], 1);
+
+    moved = tree;
+    EXPECT_EQ (moved, tree);
+
+    tree.clear();
+    EXPECT_TRUE (tree.empty());
+    EXPECT_EQ (tree.begin(), tree.end());
+    EXPECT_EQ (tree.n_less_than (5), 0);
+
+    TypeParam small = {3, 1, 2, 3};
+    EXPECT_EQ (small.size(), 3);
+    EXPECT_EQ (*small[2], 2);
+}
+
+TEST (BPlus_Tree, Height)
+{
+    yLab::BPlus_Tree<int, std::less<int>, std::allocator<int>, 4> tree;
+    EXPECT_EQ (tree.height(), 0);
+
+    for (auto key = 0; key != 1000; ++key)
+        tree.insert (key);
+
+    // Every node but the root has at least 2 children
+    EXPECT_LE (tree.height(), 10);
+
+    for (auto key = 0; key != 1000; ++key)
+        tree.erase (key);
+
+    EXPECT_EQ (tree.height(), 0);
+    EXPECT_TRUE (tree.empty());
+}
+
+namespace
+{
+
+// Shared by all rebound Throwing_Allocators
+int allocations_left = -1;
+
+// Throws when the given number of allocations runs out
+template<typename T>
+struct Throwing_Allocator
+{
+    using value_type = T;
+
+    Throwing_Allocator () = default;
+
+    template<typename U>
+    Throwing_Allocator (const Throwing_Allocator<U> &) noexcept {}
+
+    T *allocate (std::size_t n)
+    {
+        if (allocations_left == 0)
+            throw std::bad_alloc{};
+        if (allocations_left > 0)
+            --allocations_left;
+
+        return std::allocator<T>{}.allocate (n);
+    }
+
+    void deallocate (T *ptr, std::size_t n) noexcept { std::allocator<T>{}.deallocate (ptr, n); }
+
+    template<typename U>
+    bool operator== (const Throwing_Allocator<U> &) const noexcept { return true; }
+};
+
+} // unnamed namespace
+
+TEST (BPlus_Tree, Failed_Insert)
+{
+    using allocator_type = Throwing_Allocator<int>;
+    yLab::BPlus_Tree<int, std::less<int>, allocator_type, 4> tree;
+    std::set<int> model;
+
+    allocations_left = 0;
+    EXPECT_THROW (tree.insert (0), std::bad_alloc);
+    EXPECT_TRUE (tree.empty());
+    EXPECT_EQ (tree.height(), 0);
+
+    std::mt19937 gen{7};
+    std::uniform_int_distribution<int> key_dist{0, 10000};
+
+    // Splits cascade up to the root sooner or later, needing as many as height + 1 nodes
+    for (auto i = 0; i != 2000; ++i)
+    {
+        auto key = key_dist (gen);
+
+        allocations_left = i % 4;
+        try
+        {
+            tree.insert (key);
+            model.insert (key);
+        }
+        catch (const std::bad_alloc &)
+        {
+            EXPECT_FALSE (tree.contains (key));
+        }
+    }
+    allocations_left = -1;
+
+    ASSERT_EQ (tree.size(), model.size());
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+    EXPECT_TRUE (std::equal (tree.rbegin(), tree.rend(), model.rbegin(), model.rend()));
+
+    std::vector<int> keys (model.begin(), model.end());
+    for (std::size_t k = 1; k <= keys.size(); k += 37)
+    {
+        EXPECT_EQ (*tree[k], keys[k - 1]);
+        EXPECT_EQ (tree.n_less_than (keys[k - 1]), k - 1);
+    }
+
+    // Every successful insert checks the structure of the tree
+    for (auto key = -100; key != 0; ++key)
+        tree.insert (key);
+    EXPECT_EQ (tree.size(), model.size() + 100);
+}
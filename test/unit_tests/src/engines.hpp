@@ -0,0 +1,28 @@
+/*
+ * Engines with the set API of ARB_Tree: ARB_Tree with every balancing policy and B+-trees. Typed
+ * suites of unit tests run against every one of them.
+ */
+
+#ifndef TEST_UNIT_TESTS_ENGINES_HPP
+#define TEST_UNIT_TESTS_ENGINES_HPP
+
+#include <gtest/gtest.h>
+#include <functional>
+#include <memory>
+
+#include "arb_tree.hpp"
+#include "balancing.hpp"
+#include "bplus_tree.hpp"
+
+template<typename Balance_T>
+using Balanced_Tree = yLab::ARB_Tree<int, std::less<int>, std::allocator<int>,
+                                     yLab::ARB_Node<int>, true, Balance_T>;
+
+using Engines = testing::Types<yLab::ARB_Tree<int>,
+                               Balanced_Tree<yLab::AVL_Balance>,
+                               Balanced_Tree<yLab::WAVL_Balance>,
+                               Balanced_Tree<yLab::Treap_Balance>,
+                               yLab::BPlus_Tree<int>,
+                               yLab::BPlus_Tree<int, std::less<int>, std::allocator<int>, 4>>;
+
+#endif // TEST_UNIT_TESTS_ENGINES_HPP
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "frozen_tree.hpp"
+
+TEST (Frozen_Tree, Same_Answers_As_Tree)
+{
+    std::mt19937 gen{21};
+    std::uniform_int_distribution<int> key_dist{0, 5000};
+
+    // Sizes around powers of two make the last level of the implicit tree full or almost empty
+    for (auto size : {0, 1, 2, 3, 7, 8, 9, 255, 256, 1000})
+    {
+        yLab::ARB_Tree<int> tree;
+        while (tree.size() != static_cast<std::size_t>(size))
+            tree.insert (key_dist (gen));
+
+        auto frozen = tree.freeze();
+        ASSERT_EQ (frozen.size(), tree.size());
+        EXPECT_TRUE (std::equal (frozen.begin(), frozen.end(), tree.begin(), tree.end()));
+
+        std::vector<int> keys;
+        for (auto key = -1; key <= 5001; key += 3)
+        {
+            keys.push_back (key);
+
+            EXPECT_EQ (frozen.n_less_than (key), tree.n_less_than (key));
+            EXPECT_EQ (frozen.n_less_equal (key), tree.n_less_equal (key));
+            EXPECT_EQ (frozen.contains (key), tree.contains (key));
+            EXPECT_EQ (frozen.rank (frozen.lower_bound (key)), tree.rank (tree.lower_bound (key)));
+            EXPECT_EQ (frozen.rank (frozen.upper_bound (key)), tree.rank (tree.upper_bound (key)));
+        }
+
+        EXPECT_EQ (frozen.batch_rank (keys), tree.batch_rank (keys));
+
+        for (std::size_t k = 0; k <= tree.size() + 1; ++k)
+        {
+            if (auto it = tree[k]; it == tree.end())
+                EXPECT_EQ (frozen[k], frozen.end());
+            else
+                EXPECT_EQ (*frozen[k], *it);
+        }
+
+        EXPECT_EQ (frozen.count_range (100, 3000), tree.count_range (100, 3000));
+    }
+}
+
+TEST (Frozen_Tree, Multiset)
+{
+    yLab::ARB_Multiset<int> tree = {5, 1, 5, 3, 5, 1, 7};
+    auto frozen = tree.freeze();
+
+    EXPECT_EQ (frozen.count (5), 3);
+    EXPECT_EQ (frozen.count (4), 0);
+    EXPECT_EQ (frozen.n_less_than (5), 3);
+    EXPECT_EQ (frozen.n_greater_than (1), 5);
+
+    auto [first, last] = frozen.equal_range (1);
+    EXPECT_EQ (last - first, 2);
+    EXPECT_EQ (frozen.find (3), frozen.begin() + 2);
+    EXPECT_EQ (frozen.find (4), frozen.end());
+}
+
+TEST (Frozen_Tree, Transparent_Compare)
+{
+    yLab::ARB_Tree<std::string, std::less<>> tree = {"kiwi", "apple", "plum", "fig"};
+    auto frozen = tree.freeze();
+
+    EXPECT_EQ (frozen.n_less_than ("grape"), 2);
+    EXPECT_TRUE (frozen.contains ("plum"));
+    EXPECT_EQ (*frozen.lower_bound ("g"), "kiwi");
+    EXPECT_EQ (std::vector<std::string>(frozen.rbegin(), frozen.rend()),
+               (std::vector<std::string>{"plum", "kiwi", "fig", "apple"}));
+}
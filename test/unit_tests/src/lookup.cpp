@@ -1,36 +1,47 @@
 #include <gtest/gtest.h>
 #include <iterator>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <random>
+#include <vector>
 
 #include "arb_tree.hpp"
+#include "engines.hpp"
 
-TEST (Lookup, Find)
+template<typename Tree>
+class Lookup : public testing::Test {};
+
+TYPED_TEST_SUITE (Lookup, Engines);
+
+TYPED_TEST (Lookup, Find)
 {
-    yLab::ARB_Tree tree = {1, 2, 3, 4, 5, 6};
+    TypeParam tree = {1, 2, 3, 4, 5, 6};
 
     auto key = 1;
     for (auto it = tree.begin(), ite = tree.end(); it != ite; ++it, ++key)
         EXPECT_EQ (it, tree.find (key));
 
-    yLab::ARB_Tree<int> empty_tree;
+    TypeParam empty_tree;
     EXPECT_EQ (empty_tree.find(0), empty_tree.end());
 }
 
-TEST (Lookup, Contains)
+TYPED_TEST (Lookup, Contains)
 {
-    yLab::ARB_Tree tree = {1, 2, 3, 4, 5, 6};
+    TypeParam tree = {1, 2, 3, 4, 5, 6};
 
     EXPECT_FALSE (tree.contains (0));
     EXPECT_FALSE (tree.contains (7));
     EXPECT_TRUE (std::all_of (tree.begin(), tree.end(),
                               [&tree](auto &&key){ return tree.contains(key); }));
 
-    yLab::ARB_Tree<int> empty_tree;
+    TypeParam empty_tree;
     EXPECT_FALSE (empty_tree.contains(0));
 }
 
-TEST (Lookup, Lower_Bound)
+TYPED_TEST (Lookup, Lower_Bound)
 {
-    yLab::ARB_Tree tree = {1, 3};
+    TypeParam tree = {1, 3};
 
     EXPECT_EQ (tree.lower_bound (0), tree.find (1));
     EXPECT_EQ (tree.lower_bound (1), tree.find (1));
@@ -38,13 +49,13 @@ TEST (Lookup, Lower_Bound)
     EXPECT_EQ (tree.lower_bound (3), tree.find (3));
     EXPECT_EQ (tree.lower_bound (4), tree.end());
 
-    yLab::ARB_Tree<int> empty_tree;
+    TypeParam empty_tree;
     EXPECT_EQ (empty_tree.lower_bound (0), empty_tree.end());
 }
 
-TEST (Lookup, Upper_Bound)
+TYPED_TEST (Lookup, Upper_Bound)
 {
-    yLab::ARB_Tree tree = {1, 3};
+    TypeParam tree = {1, 3};
 
     EXPECT_EQ (tree.upper_bound (0), tree.find (1));
     EXPECT_EQ (tree.upper_bound (1), tree.find (3));
@@ -52,27 +63,27 @@ TEST (Lookup, Upper_Bound)
     EXPECT_EQ (tree.upper_bound (3), tree.end());
     EXPECT_EQ (tree.upper_bound (4), tree.end());
 
-    yLab::ARB_Tree<int> empty_tree;
+    TypeParam empty_tree;
     EXPECT_EQ (empty_tree.upper_bound (0), empty_tree.end());
 }
 
-TEST (Lookup, Kth_Smallest)
+TYPED_TEST (Lookup, Kth_Smallest)
 {
-    yLab::ARB_Tree tree = {0, 2, 4, 6, 8, 10, 12};
+    TypeParam tree = {0, 2, 4, 6, 8, 10, 12};
 
-    for (auto k = 1; k != tree.size() + 1; ++k)
+    for (std::size_t k = 1; k != tree.size() + 1; ++k)
         EXPECT_EQ (tree[k], std::next (tree.begin(), k - 1));
 
     EXPECT_EQ (tree[0], tree.end());
     EXPECT_EQ (tree[tree.size() + 1], tree.end());
 
-    yLab::ARB_Tree<int> empty_tree;
+    TypeParam empty_tree;
     EXPECT_EQ (empty_tree[1], empty_tree.end());
 }
 
-TEST (Lookup, N_Less_Than)
+TYPED_TEST (Lookup, N_Less_Than)
 {
-    yLab::ARB_Tree tree = {0, 2, 4, 6, 8, 10, 12};
+    TypeParam tree = {0, 2, 4, 6, 8, 10, 12};
 
     auto n = 0;
     for (auto it = tree.begin(), ite = tree.end(); it != ite; ++it, ++n)
@@ -82,3 +93,165 @@ TEST (Lookup, N_Less_Than)
     EXPECT_EQ (tree.n_less_than (5), 3);
     EXPECT_EQ (tree.n_less_than (14), tree.size());
 }
+
+namespace
+{
+
+// Counts keys constructed from string_view to catch temporaries
+struct Counted_String
+{
+    static inline int n_constructed = 0;
+
+    std::string str;
+
+    Counted_String (std::string_view sv) : str{sv} { n_constructed++; }
+};
+
+struct Counted_String_Less
+{
+    using is_transparent = void;
+
+    static std::string_view view (const Counted_String &key) { return key.str; }
+    static std::string_view view (std::string_view sv) { return sv; }
+
+    template<typename T, typename U>
+    bool operator() (const T &lhs, const U &rhs) const { return view (lhs) < view (rhs); }
+};
+
+} // unnamed namespace
+
+TEST (ARB_Lookup, Transparent_Comparator)
+{
+    yLab::ARB_Tree<Counted_String, Counted_String_Less> tree;
+    for (std::string_view key : {"delta", "alpha", "echo", "charlie", "bravo"})
+        tree.emplace (key);
+
+    Counted_String::n_constructed = 0;
+
+    std::string_view alpha = "alpha";
+    EXPECT_EQ (tree.find (alpha), tree.begin());
+    EXPECT_EQ (tree.find (std::string_view{"foxtrot"}), tree.end());
+    EXPECT_TRUE (tree.contains (std::string_view{"echo"}));
+    EXPECT_EQ (tree.lower_bound (std::string_view{"c"})->str, "charlie");
+    EXPECT_EQ (tree.upper_bound (std::string_view{"charlie"})->str, "delta");
+    EXPECT_EQ (tree.n_less_than (std::string_view{"d"}), 3);
+    EXPECT_EQ (tree.erase (std::string_view{"bravo"}), 1);
+    EXPECT_EQ (tree.erase (std::string_view{"bravo"}), 0);
+
+    EXPECT_EQ (Counted_String::n_constructed, 0);
+    EXPECT_EQ (tree.size(), 4);
+}
+
+TYPED_TEST (Lookup, Rank_Queries)
+{
+    std::mt19937 gen{5};
+    std::uniform_int_distribution<int> dist{0, 500};
+
+    TypeParam tree;
+    for (auto i = 0; i != 200; ++i)
+        tree.insert (dist (gen));
+
+    std::vector<int> keys(tree.begin(), tree.end());
+
+    for (auto key = -1; key <= 501; ++key)
+    {
+        auto n_less = std::lower_bound (keys.begin(), keys.end(), key) - keys.begin();
+        auto n_less_equal = std::upper_bound (keys.begin(), keys.end(), key) - keys.begin();
+
+        EXPECT_EQ (tree.n_less_than (key), n_less);
+        EXPECT_EQ (tree.n_less_equal (key), n_less_equal);
+        EXPECT_EQ (tree.n_greater_than (key), keys.size() - n_less_equal);
+    }
+}
+
+TYPED_TEST (Lookup, Count_Range)
+{
+    TypeParam tree;
+    for (auto key = 0; key < 100; key += 3)
+        tree.insert (key);
+
+    std::vector<int> keys(tree.begin(), tree.end());
+
+    for (auto lo = -5; lo <= 105; lo += 2)
+        for (auto hi = -5; hi <= 105; hi += 7)
+        {
+            auto expected = std::count_if (keys.begin(), keys.end(),
+                                           [&](int key){ return lo <= key && key < hi; });
+            EXPECT_EQ (tree.count_range (lo, hi), expected);
+        }
+
+    EXPECT_EQ (TypeParam{}.count_range (0, 10), 0);
+}
+
+TEST (ARB_Lookup, Kth_In_Range)
+{
+    yLab::ARB_Tree<int> tree;
+    for (auto key = 0; key != 1000; key += 2)
+        tree.insert (key);
+
+    for (auto lo : {-10, 0, 1, 37, 500, 997, 998, 999})
+        for (std::size_t k = 0; k < 600; k += 13)
+        {
+            auto first = std::max (lo + (lo % 2 != 0), 0);
+            auto key = first + 2 * (static_cast<int>(k) - 1);
+
+            auto it = tree.kth_in_range (lo, k);
+            if (k == 0 || key >= 1000)
+                EXPECT_EQ (it, tree.end());
+            else
+            {
+                ASSERT_NE (it, tree.end());
+                EXPECT_EQ (*it, key);
+            }
+        }
+}
+
+TEST (ARB_Lookup, Batch_Kth)
+{
+    yLab::ARB_Tree<int> tree;
+    for (auto key = 0; key < 3000; key += 3)
+        tree.insert (key);
+
+    std::mt19937 gen{11};
+    std::uniform_int_distribution<std::size_t> dist{0, tree.size() + 5};
+
+    // Small batches are answered by a descent, large ones by a pass through the tree
+    for (auto batch_size : {1, 10, 50, 2000})
+    {
+        std::vector<std::size_t> ks(batch_size);
+        for (auto &k : ks)
+            k = dist (gen);
+
+        auto answers = tree.batch_kth (ks);
+
+        ASSERT_EQ (answers.size(), ks.size());
+        for (std::size_t i = 0; i != ks.size(); ++i)
+            EXPECT_EQ (answers[i], tree[ks[i]]);
+    }
+}
+
+TEST (ARB_Lookup, Batch_Rank)
+{
+    yLab::ARB_Tree<int> tree;
+    for (auto key = 0; key < 3000; key += 3)
+        tree.insert (key);
+
+    std::mt19937 gen{12};
+    std::uniform_int_distribution<int> dist{-10, 3010};
+
+    for (auto batch_size : {1, 10, 50, 2000})
+    {
+        std::vector<int> keys(batch_size);
+        for (auto &key : keys)
+            key = dist (gen);
+
+        auto answers = tree.batch_rank (keys);
+
+        ASSERT_EQ (answers.size(), keys.size());
+        for (std::size_t i = 0; i != keys.size(); ++i)
+            EXPECT_EQ (answers[i], tree.n_less_than (keys[i]));
+    }
+
+    auto empty_answers = yLab::ARB_Tree<int>{}.batch_rank (std::vector{1, 2});
+    EXPECT_EQ (empty_answers, (std::vector<std::size_t>{0, 0}));
+}
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <map>
+#include <compare>
+
+#include "arb_map.hpp"
+
+TEST (Map, Element_Access)
+{
+    yLab::ARB_Map<std::string, int> map;
+
+    map["b"] = 2;
+    map["a"] = 1;
+    map["c"];
+    ++map["b"];
+
+    EXPECT_EQ (map.size(), 3);
+    EXPECT_EQ (map.at ("b"), 3);
+    EXPECT_EQ (map.at ("c"), 0);
+    EXPECT_THROW (map.at ("d"), std::out_of_range);
+
+    for (auto &[key, value] : map)
+        value *= 10;
+
+    EXPECT_EQ (map, (yLab::ARB_Map<std::string, int>{{"a", 10}, {"b", 30}, {"c", 0}}));
+
+    auto [it, inserted] = map.insert_or_assign ("a", 7);
+    EXPECT_FALSE (inserted);
+    EXPECT_EQ (it->second, 7);
+
+    EXPECT_TRUE (map.insert ({"d", 4}).second);
+    EXPECT_FALSE (map.emplace ("d", 5).second);
+    EXPECT_EQ (map.find ("d")->second, 4);
+
+    EXPECT_EQ (map.erase ("b"), 1);
+    EXPECT_FALSE (map.contains ("b"));
+    EXPECT_EQ (map.erase (map.begin())->first, "c");
+}
+
+TEST (Map, Try_Emplace_Keeps_Arguments)
+{
+    yLab::ARB_Map<int, std::unique_ptr<int>> map;
+
+    auto value = std::make_unique<int>(1);
+    EXPECT_TRUE (map.try_emplace (1, std::move (value)).second);
+    EXPECT_EQ (value, nullptr);
+
+    value = std::make_unique<int>(2);
+    auto [it, inserted] = map.try_emplace (1, std::move (value));
+    EXPECT_FALSE (inserted);
+    EXPECT_NE (value, nullptr);
+    EXPECT_EQ (*it->second, 1);
+
+    map.insert_or_assign (1, std::move (value));
+    EXPECT_EQ (*map.at (1), 2);
+}
+
+TEST (Map, Order_Statistics)
+{
+    yLab::ARB_Map<int, int> map;
+    std::map<int, int> model;
+
+    std::mt19937 gen{17};
+    std::uniform_int_distribution<int> key_dist{0, 1000};
+
+    for (auto i = 0; i != 2000; ++i)
+    {
+        auto key = key_dist (gen);
+        if (i % 4 == 3)
+        {
+            EXPECT_EQ (map.erase (key), model.erase (key));
+        }
+        else
+        {
+            map[key] += i;
+            model[key] += i;
+        }
+    }
+
+    ASSERT_EQ (map.size(), model.size());
+    EXPECT_TRUE (std::equal (map.begin(), map.end(), model.begin(), model.end()));
+
+    auto model_it = model.begin();
+    for (std::size_t k = 1; k <= model.size(); ++k, ++model_it)
+    {
+        auto it = map.nth (k);
+        EXPECT_EQ (*it, *model_it);
+        EXPECT_EQ (map.rank (it), k - 1);
+        EXPECT_EQ (map.n_less_than (model_it->first), k - 1);
+    }
+
+    EXPECT_EQ (map.nth (model.size() + 1), map.end());
+    EXPECT_EQ (map.count_range (100, 200),
+               std::distance (model.lower_bound (100), model.lower_bound (200)));
+
+    map.nth (1)->second = -1;
+    EXPECT_EQ (map.begin()->second, -1);
+}
+
+namespace
+{
+
+struct Payload
+{
+    int x;
+};
+
+// Throws from its constructor when asked to
+struct Throwing_Value
+{
+    int value;
+
+    explicit Throwing_Value (int v) : value{v}
+    {
+        if (v < 0)
+            throw std::runtime_error{"negative value"};
+    }
+};
+
+} // unnamed namespace
+
+TEST (Map, Mapped_Type_Without_Comparison)
+{
+    yLab::ARB_Map<int, Payload> map;
+
+    map[2].x = 20;
+    map.try_emplace (1, Payload{10});
+
+    EXPECT_EQ (map.size(), 2);
+    EXPECT_EQ (map.at (1).x, 10);
+    EXPECT_EQ (map.nth (2)->second.x, 20);
+    EXPECT_EQ (map.rank (map.find (2)), 1);
+
+    static_assert (!std::three_way_comparable<yLab::ARB_Map<int, Payload>>);
+    static_assert (std::three_way_comparable<yLab::ARB_Map<int, int>>);
+}
+
+TEST (Map, Sizes_After_Failed_Try_Emplace)
+{
+    yLab::ARB_Map<int, Throwing_Value> map;
+    for (auto key = 0; key != 20; key += 2)
+        map.try_emplace (key, key);
+
+    // Appending past the rightmost key doesn't count sizes on the way down
+    EXPECT_THROW (map.try_emplace (100, -1), std::runtime_error);
+    // Inserting in the middle does
+    EXPECT_THROW (map.try_emplace (7, -1), std::runtime_error);
+
+    EXPECT_EQ (map.size(), 10);
+    EXPECT_FALSE (map.contains (100));
+    EXPECT_FALSE (map.contains (7));
+
+    EXPECT_TRUE (map.try_emplace (50, 50).second);
+    EXPECT_TRUE (map.try_emplace (7, 7).second);
+
+    EXPECT_EQ (map.size(), 12);
+    EXPECT_EQ (map.n_less_than (8), 5);
+    EXPECT_EQ (map.nth (12)->first, 50);
+    EXPECT_EQ (map.count_range (0, 100), 12);
+}
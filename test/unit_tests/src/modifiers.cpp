@@ -1,22 +1,32 @@
 #include <gtest/gtest.h>
 #include <numeric>
+#include <random>
 #include <vector>
+#include <memory>
+#include <string>
+#include <stdexcept>
 #include <set>
 
 #include "arb_tree.hpp"
+#include "engines.hpp"
 
-TEST (Modifiers, Clear)
+template<typename Tree>
+class Modifiers : public testing::Test {};
+
+TYPED_TEST_SUITE (Modifiers, Engines);
+
+TYPED_TEST (Modifiers, Clear)
 {
-    yLab::ARB_Tree tree = {1, 2, 3, 4, 5, 6};
-    yLab::ARB_Tree<int> empty_tree;
+    TypeParam tree = {1, 2, 3, 4, 5, 6};
+    TypeParam empty_tree;
     tree.clear();
 
     EXPECT_EQ (tree, empty_tree);
 }
 
-TEST (Modifiers, Insert_By_Key)
+TYPED_TEST (Modifiers, Insert_By_Key)
 {
-    yLab::ARB_Tree<int> tree;
+    TypeParam tree;
 
     auto [it, flag] = tree.insert (1);
 
@@ -35,29 +45,29 @@ TEST (Modifiers, Insert_By_Key)
     EXPECT_EQ (++it2, tree.end());
 }
 
-TEST (Modifiers, Insert_Range)
+TYPED_TEST (Modifiers, Insert_Range)
 {
     std::set model = {1, 6, 3, 7, 1, 8, 5, 3, 8, 35162, -46, 35};
 
-    yLab::ARB_Tree<int> tree;
+    TypeParam tree;
     tree.insert (model.begin(), model.end());
 
     EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
 }
 
-TEST (Modifiers, Insert_By_Initializer_List)
+TYPED_TEST (Modifiers, Insert_By_Initializer_List)
 {
     std::set model = {1, 6, 3, 7, 1, 8, 5, 3, 8, 35162, -46, 35};
 
-    yLab::ARB_Tree<int> tree;
+    TypeParam tree;
     tree.insert ({1, 6, 3, 7, 1, 8, 5, 3, 8, 35162, -46, 35});
 
     EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
 }
 
-TEST (Modifiers, Erase_By_Iterator)
+TYPED_TEST (Modifiers, Erase_By_Iterator)
 {
-    yLab::ARB_Tree tree = {15, 2, 1, 8, 3, 5, 7, 9, 4, 11};
+    TypeParam tree = {15, 2, 1, 8, 3, 5, 7, 9, 4, 11};
     std::set<int> model{tree.begin(), tree.end()};
 
     auto it = tree.find (15);
@@ -67,14 +77,17 @@ TEST (Modifiers, Erase_By_Iterator)
     EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
 }
 
-TEST (Modifiers, Erase_By_Key)
+TYPED_TEST (Modifiers, Erase_By_Key)
 {
     std::vector<int> vec(1000);
     std::iota (vec.begin(), vec.end(), 1);
 
+    // B+-trees are built by insertions, so every tree is a copy of one built in advance
+    const TypeParam full_tree{vec.begin(), vec.end()};
+
     for (auto key : vec)
     {
-        yLab::ARB_Tree<int> tree{vec.begin(), vec.end()};
+        auto tree = full_tree;
         std::set<int> model{vec.begin(), vec.end()};
 
         auto is_erased = tree.erase (key);
@@ -88,9 +101,216 @@ TEST (Modifiers, Erase_By_Key)
         EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
     }
 
-    yLab::ARB_Tree tree = {1};
-    yLab::ARB_Tree<int> empty_tree;
+    TypeParam tree = {1};
+    TypeParam empty_tree;
 
     tree.erase (1);
     EXPECT_EQ (tree, empty_tree);
 }
+
+TYPED_TEST (Modifiers, Erase_Random)
+{
+    TypeParam tree;
+    std::set<int> model;
+
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> dist{0, 300};
+
+    for (auto i = 0; i != 1000; ++i)
+    {
+        auto key = dist (gen);
+
+        if (i % 3 == 2)
+            EXPECT_EQ (tree.erase (key), model.erase (key));
+        else
+            tree.insert (key), model.insert (key);
+    }
+
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+}
+
+TEST (ARB_Modifiers, Insert_With_Hint)
+{
+    yLab::ARB_Tree<int> tree;
+    std::set<int> model;
+
+    // Every hint is adjacent to the position of the key
+    for (auto key = 0; key != 100; key += 2)
+        tree.insert (tree.end(), key);
+    for (auto key = 99; key > 0; key -= 2)
+        tree.insert (tree.find (key + 1), key);
+    for (auto key = 100; key != 120; ++key)
+        tree.insert (std::prev (tree.end()), key);
+
+    std::vector<int> expected(120);
+    std::iota (expected.begin(), expected.end(), 0);
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), expected.begin(), expected.end()));
+    EXPECT_EQ (*tree.rbegin(), 119);
+
+    // Hints far from the position and duplicates
+    std::mt19937 gen{1};
+    std::uniform_int_distribution<int> dist{-50, 200};
+
+    for (auto i = 0; i != 500; ++i)
+    {
+        auto key = dist (gen);
+        auto hint = tree[dist (gen) % tree.size() + 1];
+
+        auto it = tree.insert (hint, key);
+        EXPECT_EQ (*it, key);
+    }
+
+    for (auto key = -50; key <= 200; ++key)
+        if (tree.contains (key))
+            model.insert (key);
+
+    EXPECT_EQ (tree.size(), model.size());
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+    EXPECT_TRUE (std::equal (tree.rbegin(), tree.rend(), model.rbegin(), model.rend()));
+}
+
+TYPED_TEST (Modifiers, Rightmost_After_Erase)
+{
+    TypeParam tree = {1, 2, 3, 4, 5};
+
+    for (auto key = 5; key > 0; --key)
+    {
+        EXPECT_EQ (*tree.rbegin(), key);
+        EXPECT_EQ (*std::prev (tree.end()), key);
+        tree.erase (key);
+    }
+
+    EXPECT_EQ (tree.rbegin(), tree.rend());
+
+    tree.insert (7);
+    EXPECT_EQ (*tree.rbegin(), 7);
+}
+
+TEST (ARB_Modifiers, Emplace)
+{
+    yLab::ARB_Tree<std::string> tree;
+
+    auto [it, inserted] = tree.emplace (3, 'b');
+    EXPECT_TRUE (inserted);
+    EXPECT_EQ (*it, "bbb");
+
+    std::tie (it, inserted) = tree.emplace ("bbb");
+    EXPECT_FALSE (inserted);
+    EXPECT_EQ (tree.size(), 1);
+
+    it = tree.emplace_hint (tree.end(), 2, 'c');
+    EXPECT_EQ (*it, "cc");
+    it = tree.emplace_hint (tree.begin(), "a");
+    EXPECT_EQ (it, tree.begin());
+
+    std::vector<std::string> expected = {"a", "bbb", "cc"};
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), expected.begin(), expected.end()));
+}
+
+TEST (ARB_Modifiers, Move_Only_Keys)
+{
+    using key_type = std::unique_ptr<int>;
+    yLab::ARB_Tree<key_type> tree;
+
+    auto key = std::make_unique<int>(1);
+    auto raw = key.get();
+
+    auto [it, inserted] = tree.insert (std::move (key));
+    EXPECT_TRUE (inserted);
+    EXPECT_EQ (it->get(), raw);
+
+    tree.insert (tree.end(), std::make_unique<int>(2));
+    tree.emplace (new int{3});
+    EXPECT_EQ (tree.size(), 3);
+
+    std::vector<key_type> keys;
+    for (auto i = 0; i != 20; ++i)
+        keys.push_back (std::make_unique<int>(i));
+
+    yLab::ARB_Tree<key_type> other{std::make_move_iterator (keys.rbegin()),
+                                   std::make_move_iterator (keys.rend())};
+    EXPECT_EQ (other.size(), keys.size());
+
+    auto moved = yLab::ARB_Tree<key_type>{std::move (other)};
+    EXPECT_EQ (moved.size(), keys.size());
+}
+
+TEST (ARB_Modifiers, Insert_And_Erase_With_Rank)
+{
+    yLab::ARB_Tree<int> tree;
+    std::set<int> model;
+
+    std::mt19937 gen{3};
+    std::uniform_int_distribution<int> dist{0, 200};
+
+    for (auto i = 0; i != 600; ++i)
+    {
+        auto key = dist (gen);
+        auto expected_rank = std::distance (model.begin(), model.lower_bound (key));
+
+        if (i % 3 == 2)
+        {
+            auto [n_erased, rank] = tree.erase_with_rank (key);
+            EXPECT_EQ (n_erased, model.erase (key));
+            EXPECT_EQ (rank, expected_rank);
+        }
+        else
+        {
+            auto [it, inserted, rank] = tree.insert_with_rank (key);
+            EXPECT_EQ (inserted, model.insert (key).second);
+            EXPECT_EQ (*it, key);
+            EXPECT_EQ (rank, expected_rank);
+        }
+    }
+
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+}
+
+namespace
+{
+
+// Throws when the given number of comparisons runs out
+struct Throwing_Less
+{
+    static inline int calls_left = -1;
+
+    bool operator() (int lhs, int rhs) const
+    {
+        if (calls_left > 0 && --calls_left == 0)
+            throw std::runtime_error{"out of comparisons"};
+
+        return lhs < rhs;
+    }
+};
+
+} // unnamed namespace
+
+TEST (ARB_Modifiers, Sizes_After_Failed_Insert)
+{
+    yLab::ARB_Tree<int, Throwing_Less> tree;
+    for (auto key = 0; key != 200; key += 2)
+        tree.insert (key);
+
+    // Sizes of subtrees counted on the way down are taken back on duplicates and exceptions
+    for (auto key = 0; key != 200; key += 2)
+        EXPECT_FALSE (tree.insert (key).second);
+
+    for (auto n_calls : {2, 4, 6, 8})
+    {
+        Throwing_Less::calls_left = n_calls;
+        EXPECT_THROW (tree.insert (75), std::runtime_error);
+
+        Throwing_Less::calls_left = n_calls;
+        EXPECT_THROW (tree.emplace (75), std::runtime_error);
+    }
+    Throwing_Less::calls_left = -1;
+
+    EXPECT_EQ (tree.size(), 100);
+    for (auto k = 1; k <= 100; ++k)
+        EXPECT_EQ (*tree[k], 2 * (k - 1));
+
+    tree.insert (75);
+    tree.erase (74);
+    EXPECT_EQ (tree.size(), 100);
+    EXPECT_EQ (tree.n_less_than (76), 38);
+}
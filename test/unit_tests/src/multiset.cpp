@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <utility>
+#include <vector>
+#include <set>
+
+#include "arb_tree.hpp"
+
+namespace
+{
+
+// Keys are compared by the first member only, the second one tells equivalent keys apart
+using Tagged_Key = std::pair<int, int>;
+
+struct Compare_First
+{
+    bool operator() (const Tagged_Key &lhs, const Tagged_Key &rhs) const noexcept
+    {
+        return lhs.first < rhs.first;
+    }
+};
+
+} // unnamed namespace
+
+TEST (Multiset, Duplicates)
+{
+    yLab::ARB_Multiset<int> tree = {5, 1, 5, 3, 5, 1};
+
+    EXPECT_EQ (tree.size(), 6);
+    EXPECT_EQ (tree, (yLab::ARB_Multiset<int>{1, 1, 3, 5, 5, 5}));
+
+    auto it = tree.insert (3);
+    EXPECT_EQ (*it, 3);
+    EXPECT_EQ (tree.rank (it), 3);
+
+    EXPECT_EQ (tree.count (5), 3);
+    EXPECT_EQ (tree.count (3), 2);
+    EXPECT_EQ (tree.count (4), 0);
+
+    auto [first, last] = tree.equal_range (5);
+    EXPECT_EQ (std::distance (first, last), 3);
+    EXPECT_EQ (tree.rank (first), 4);
+
+    EXPECT_EQ (tree.n_less_than (5), 4);
+    EXPECT_EQ (tree.n_less_equal (5), 7);
+    EXPECT_EQ (*tree[2], 1);
+    EXPECT_EQ (*tree[5], 5);
+
+    EXPECT_EQ (tree.erase_with_rank (5), (std::pair<std::size_t, std::size_t>{3, 4}));
+    EXPECT_EQ (tree.erase (1), 2);
+    EXPECT_EQ (tree, (yLab::ARB_Multiset<int>{3, 3}));
+
+    auto [less, greater] = tree.split (3);
+    EXPECT_TRUE (less.empty());
+    EXPECT_EQ (greater.size(), 2);
+
+    auto joined = decltype (tree)::join (std::move (greater), yLab::ARB_Multiset<int>{3, 4});
+    EXPECT_EQ (joined, (yLab::ARB_Multiset<int>{3, 3, 3, 4}));
+}
+
+TEST (Multiset, Order_Of_Equivalent_Keys)
+{
+    yLab::ARB_Multiset<Tagged_Key, Compare_First> tree;
+    std::multiset<Tagged_Key, Compare_First> model;
+
+    std::mt19937 gen{16};
+    std::uniform_int_distribution<int> key_dist{0, 20};
+
+    for (auto tag = 0; tag != 2000; ++tag)
+    {
+        Tagged_Key key{key_dist (gen), tag};
+
+        if (tag % 4 == 3 && !model.empty())
+        {
+            // Hints are taken from the same positions in both containers
+            auto k = std::uniform_int_distribution<std::size_t>{0, model.size()}(gen);
+
+            tree.insert (tree.next (tree.begin(), k), key);
+            model.insert (std::next (model.begin(), k), key);
+        }
+        else if (tag % 4 == 2)
+        {
+            tree.emplace (key);
+            model.emplace (key);
+        }
+        else
+        {
+            tree.insert (key);
+            model.insert (key);
+        }
+    }
+
+    ASSERT_EQ (tree.size(), model.size());
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end(),
+                             [](const Tagged_Key &lhs, const Tagged_Key &rhs)
+                             {
+                                 return lhs == rhs;
+                             }));
+
+    for (auto key = 0; key <= 20; ++key)
+        EXPECT_EQ (tree.count ({key, 0}), model.count ({key, 0}));
+}
+
+TEST (Multiset, Node_Handles)
+{
+    yLab::ARB_Multiset<int> tree_1 = {1, 2, 2, 3};
+    yLab::ARB_Multiset<int> tree_2 = {2, 4};
+
+    auto handle = tree_1.extract (2);
+    auto it = tree_2.insert (std::move (handle));
+    EXPECT_EQ (*it, 2);
+    EXPECT_EQ (tree_2.count (2), 2);
+
+    tree_1.merge (tree_2);
+    EXPECT_TRUE (tree_2.empty());
+    EXPECT_EQ (tree_1, (yLab::ARB_Multiset<int>{1, 2, 2, 2, 3, 4}));
+
+    std::vector<int> sorted = {0, 0, 1, 1, 1, 2};
+    yLab::ARB_Multiset<int> from_range{sorted.begin(), sorted.end()};
+    EXPECT_EQ (from_range.size(), sorted.size());
+    EXPECT_TRUE (std::equal (from_range.begin(), from_range.end(), sorted.begin(), sorted.end()));
+}
+
+TEST (Multiset, Erase_With_Rank)
+{
+    yLab::ARB_Multiset<int> tree;
+    std::multiset<int> model;
+
+    std::mt19937 gen{16};
+    std::uniform_int_distribution<int> dist{0, 60};
+
+    for (auto i = 0; i != 1500; ++i)
+    {
+        auto key = dist (gen);
+        if (i % 3 == 2)
+        {
+            auto expected_rank = static_cast<std::size_t>(
+                std::distance (model.begin(), model.lower_bound (key)));
+            auto [n_erased, rank] = tree.erase_with_rank (key);
+
+            EXPECT_EQ (n_erased, model.erase (key));
+            EXPECT_EQ (rank, expected_rank);
+        }
+        else
+        {
+            tree.insert (key);
+            model.insert (key);
+        }
+    }
+
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+    EXPECT_EQ (tree.erase (61), 0);
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include <memory_resource>
+#include <memory>
+#include <vector>
+
+#include "arb_tree.hpp"
+
+TEST (Node_Handles, Extract_And_Insert)
+{
+    yLab::ARB_Tree<int> tree = {1, 2, 3, 4, 5};
+
+    auto handle = tree.extract (tree.find (3));
+    ASSERT_FALSE (handle.empty());
+    EXPECT_EQ (handle.value(), 3);
+    EXPECT_EQ (tree, (yLab::ARB_Tree<int>{1, 2, 4, 5}));
+
+    EXPECT_TRUE (tree.extract (10).empty());
+
+    // Re-keying without reallocation
+    handle.value() = 10;
+    auto result = tree.insert (std::move (handle));
+
+    EXPECT_TRUE (result.inserted);
+    EXPECT_TRUE (result.node.empty());
+    EXPECT_EQ (*result.position, 10);
+    EXPECT_EQ (*tree.rbegin(), 10);
+
+    handle = tree.extract (1);
+    handle.value() = 2;
+    result = tree.insert (std::move (handle));
+
+    EXPECT_FALSE (result.inserted);
+    EXPECT_EQ (*result.position, 2);
+    ASSERT_FALSE (result.node.empty());
+    EXPECT_EQ (result.node.value(), 2);
+    EXPECT_EQ (tree, (yLab::ARB_Tree<int>{2, 4, 5, 10}));
+
+    result.node.value() = 0;
+    auto it = tree.insert (tree.begin(), std::move (result.node));
+    EXPECT_EQ (it, tree.begin());
+    EXPECT_EQ (tree, (yLab::ARB_Tree<int>{0, 2, 4, 5, 10}));
+}
+
+TEST (Node_Handles, No_Reallocation)
+{
+    std::pmr::monotonic_buffer_resource resource;
+    std::pmr::polymorphic_allocator<int> alloc{&resource};
+
+    yLab::pmr::ARB_Tree<std::unique_ptr<int>> tree_1{alloc};
+    yLab::pmr::ARB_Tree<std::unique_ptr<int>> tree_2{alloc};
+
+    for (auto i = 0; i != 10; ++i)
+        tree_1.emplace (new int{i});
+
+    auto first = tree_1.begin()->get();
+    auto handle = tree_1.extract (tree_1.begin());
+
+    EXPECT_EQ (handle.value().get(), first);
+    EXPECT_EQ (handle.get_allocator(), alloc);
+
+    tree_2.insert (std::move (handle));
+    EXPECT_EQ (tree_2.begin()->get(), first);
+    EXPECT_EQ (tree_1.size(), 9);
+}
+
+TEST (Node_Handles, Move_Assignment)
+{
+    std::pmr::unsynchronized_pool_resource resource;
+    std::pmr::polymorphic_allocator<int> alloc{&resource};
+
+    yLab::pmr::ARB_Tree<std::shared_ptr<int>> tree{alloc};
+
+    auto first = std::make_shared<int>(1);
+    auto second = std::make_shared<int>(2);
+    tree.insert (first);
+    tree.insert (second);
+
+    auto lhs = tree.extract (tree.find (first));
+    auto rhs = tree.extract (tree.find (second));
+    EXPECT_EQ (first.use_count(), 2);
+
+    // The key held by lhs is destroyed at once
+    lhs = std::move (rhs);
+    EXPECT_TRUE (rhs.empty());
+    EXPECT_FALSE (lhs.empty());
+    EXPECT_EQ (first.use_count(), 1);
+    EXPECT_EQ (lhs.value(), second);
+    EXPECT_EQ (lhs.get_allocator(), alloc);
+
+    lhs = std::move (rhs);
+    EXPECT_TRUE (lhs.empty());
+    EXPECT_EQ (second.use_count(), 1);
+}
+
+TEST (Node_Handles, Swap)
+{
+    std::pmr::unsynchronized_pool_resource resource_1;
+    std::pmr::unsynchronized_pool_resource resource_2;
+    std::pmr::polymorphic_allocator<int> alloc_1{&resource_1};
+    std::pmr::polymorphic_allocator<int> alloc_2{&resource_2};
+
+    yLab::pmr::ARB_Tree<int> tree_1 ({1, 2, 3}, alloc_1);
+    yLab::pmr::ARB_Tree<int> tree_2 ({4, 5, 6}, alloc_2);
+
+    auto h1 = tree_1.extract (2);
+    auto h2 = tree_2.extract (5);
+
+    h1.swap (h2);
+    EXPECT_EQ (h1.value(), 5);
+    EXPECT_EQ (h1.get_allocator(), alloc_2);
+    EXPECT_EQ (h2.value(), 2);
+    EXPECT_EQ (h2.get_allocator(), alloc_1);
+
+    decltype (h1) empty;
+    swap (h1, empty);
+    EXPECT_TRUE (h1.empty());
+    EXPECT_EQ (empty.value(), 5);
+    EXPECT_EQ (empty.get_allocator(), alloc_2);
+
+    tree_2.insert (std::move (empty));
+    tree_1.insert (std::move (h2));
+    EXPECT_EQ (tree_1, (yLab::pmr::ARB_Tree<int>{{1, 2, 3}, alloc_1}));
+    EXPECT_EQ (tree_2, (yLab::pmr::ARB_Tree<int>{{4, 5, 6}, alloc_2}));
+}
+
+TEST (Node_Handles, Merge)
+{
+    std::vector<int> keys_1 = {1, 3, 5, 7, 9, 11};
+    std::vector<int> keys_2 = {2, 3, 4, 5, 12, 0};
+
+    yLab::ARB_Tree<int> tree_1{keys_1.begin(), keys_1.end()};
+    yLab::ARB_Tree<int> tree_2{keys_2.begin(), keys_2.end()};
+
+    tree_1.merge (tree_2);
+
+    EXPECT_EQ (tree_1, (yLab::ARB_Tree<int>{0, 1, 2, 3, 4, 5, 7, 9, 11, 12}));
+    EXPECT_EQ (tree_2, (yLab::ARB_Tree<int>{3, 5}));
+
+    tree_1.merge (yLab::ARB_Tree<int>{6, 8});
+    EXPECT_EQ (tree_1.size(), 12);
+    EXPECT_EQ (*tree_1[7], 6);
+
+    tree_1.merge (tree_1);
+    EXPECT_EQ (tree_1.size(), 12);
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <set>
+#include <vector>
+
+#include "arb_tree.hpp"
+#include "node_pool.hpp"
+#include "nodes.hpp"
+
+TEST (Node_Pool, Erased_Nodes_Are_Reused)
+{
+    yLab::Pooled_ARB_Tree<int> tree;
+
+    for (auto key = 0; key != 100; ++key)
+        tree.insert (key);
+
+    auto stats = tree.get_allocator().stats();
+    EXPECT_EQ (stats.n_slabs, 1);
+    EXPECT_EQ (stats.n_carved, 100);
+    EXPECT_EQ (stats.n_reused, 0);
+
+    for (auto key = 0; key != 100; key += 2)
+    {
+        tree.erase (key);
+        tree.insert (key + 1000);
+    }
+
+    stats = tree.get_allocator().stats();
+    EXPECT_EQ (stats.n_carved, 100);
+    EXPECT_EQ (stats.n_recycled, 50);
+    EXPECT_EQ (stats.n_reused, 50);
+    EXPECT_DOUBLE_EQ (stats.reuse_rate(), 50.0 / 150.0);
+    EXPECT_EQ (tree.size(), 100);
+}
+
+TEST (Node_Pool, Clear_Releases_Slabs)
+{
+    yLab::Pooled_ARB_Tree<int> tree{yLab::Pool_Allocator<int>{16}};
+
+    for (auto key = 0; key != 100; ++key)
+        tree.insert (key);
+
+    // The allocator passed to the constructor is gone, so the tree owns its pool
+    EXPECT_EQ (tree.get_allocator().stats().n_slabs, 7);
+
+    tree.clear();
+    EXPECT_EQ (tree.get_allocator().stats().n_bulk_releases, 1);
+    EXPECT_TRUE (tree.empty());
+
+    tree.insert ({3, 1, 2});
+    EXPECT_EQ (tree, (yLab::Pooled_ARB_Tree<int>{1, 2, 3}));
+}
+
+TEST (Node_Pool, Shared_Pool_Is_Not_Released)
+{
+    yLab::Pool_Allocator<int> alloc;
+    yLab::Pooled_ARB_Tree<int> tree_1{{1, 2, 3}, alloc};
+    yLab::Pooled_ARB_Tree<int> tree_2{{4, 5, 6}, alloc};
+
+    tree_1.clear();
+
+    EXPECT_EQ (alloc.stats().n_bulk_releases, 0);
+    EXPECT_EQ (alloc.stats().n_recycled, 3);
+    EXPECT_EQ (tree_2, (yLab::Pooled_ARB_Tree<int>{4, 5, 6}));
+}
+
+TEST (Node_Pool, Non_Trivial_Keys)
+{
+    yLab::Pooled_ARB_Tree<std::string> tree;
+    std::set<std::string> model;
+
+    for (auto i = 0; i != 50; ++i)
+    {
+        auto key = std::string(40, 'a' + i % 26) + std::to_string (i);
+        tree.insert (key);
+        model.insert (key);
+    }
+
+    auto copy = tree;
+    tree.clear();
+
+    EXPECT_EQ (tree.get_allocator().stats().n_bulk_releases, 0);
+    EXPECT_TRUE (std::equal (copy.begin(), copy.end(), model.begin(), model.end()));
+}
+
+namespace
+{
+
+// Keeps all keys of a subtree, so every node owns heap memory
+struct Keys_Augmentation
+{
+    using value_type = std::vector<int>;
+
+    static value_type make (int key) { return value_type{key}; }
+
+    static value_type combine (const value_type &lhs, const value_type &rhs)
+    {
+        auto result = lhs;
+        result.insert (result.end(), rhs.begin(), rhs.end());
+        return result;
+    }
+};
+
+} // unnamed namespace
+
+TEST (Node_Pool, Non_Trivial_Aggregates)
+{
+    using node_type = yLab::ARB_Node<int, std::size_t, Keys_Augmentation>;
+    yLab::ARB_Tree<int, std::less<int>, yLab::Pool_Allocator<int>, node_type> tree;
+
+    for (auto key = 0; key != 50; ++key)
+        tree.insert (key);
+
+    EXPECT_EQ (tree.aggregate()->size(), 50);
+
+    tree.clear();
+
+    // Aggregates have to be destroyed, so the slabs aren't released in bulk
+    EXPECT_EQ (tree.get_allocator().stats().n_bulk_releases, 0);
+    EXPECT_EQ (tree.get_allocator().stats().n_recycled, 50);
+}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <cstdint>
 
 #include "nodes.hpp"
 
@@ -208,3 +209,59 @@ TEST (Nodes, Right_Rotate)
     EXPECT_EQ (x.subtree_size_, b_size + c_size + 1);
     EXPECT_EQ (y.subtree_size_, x.subtree_size_ + a_size + 1);
 }
+
+TEST (Nodes, Compact_Node_Packs_Color)
+{
+    using node_type = yLab::Compact_ARB_Node<int>;
+    using color_type = typename node_type::color_type;
+
+    static_assert (sizeof (node_type) < sizeof (yLab::ARB_Node<int>));
+    static_assert (std::is_same_v<typename node_type::size_type, std::uint32_t>);
+
+    yLab::End_Node<node_type, std::uint32_t> end_node;
+    node_type parent{1, color_type::black};
+    node_type child{2, color_type::red};
+
+    parent.set_parent (&end_node);
+    child.set_parent (&parent);
+    parent.set_right (&child);
+
+    EXPECT_EQ (parent.get_parent(), &end_node);
+    EXPECT_EQ (parent.get_color(), color_type::black);
+    EXPECT_EQ (child.get_parent(), &parent);
+    EXPECT_EQ (child.parent_unsafe(), &parent);
+    EXPECT_EQ (child.get_color(), color_type::red);
+
+    child.set_color (color_type::black);
+    EXPECT_EQ (child.get_parent(), &parent);
+    EXPECT_EQ (child.get_color(), color_type::black);
+
+    parent.set_color (color_type::red);
+    parent.set_parent (nullptr);
+    EXPECT_EQ (parent.get_parent(), nullptr);
+    EXPECT_EQ (parent.get_color(), color_type::red);
+}
+
+TEST (Nodes, End_Node_Keeps_Rightmost)
+{
+    using node_type = yLab::ARB_Node<int>;
+    using color_type = typename node_type::color_type;
+
+    yLab::End_Node<node_type> end_node;
+    node_type root{2, color_type::black};
+    node_type right{3, color_type::red};
+
+    EXPECT_FALSE (end_node.is_end_node());
+
+    end_node.set_left (&root);
+    end_node.set_rightmost (&right);
+    root.set_parent (&end_node);
+    root.set_right (&right);
+    right.set_parent (&root);
+
+    EXPECT_TRUE (end_node.is_end_node());
+    EXPECT_FALSE (root.is_end_node());
+    EXPECT_EQ (root.get_parent(), &end_node);
+    EXPECT_EQ (yLab::detail::predecessor (&end_node), &right);
+    EXPECT_EQ (yLab::detail::successor (&right), &end_node);
+}
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "optimistic_tree.hpp"
+
+namespace
+{
+
+template<typename T>
+struct Counting_Allocator
+{
+    using value_type = T;
+
+    std::atomic<long> *n_live_;
+
+    explicit Counting_Allocator (std::atomic<long> *n_live) noexcept : n_live_{n_live} {}
+
+    template<typename U>
+    Counting_Allocator (const Counting_Allocator<U> &rhs) noexcept : n_live_{rhs.n_live_} {}
+
+    T *allocate (std::size_t n)
+    {
+        *n_live_ += n;
+        return std::allocator<T>{}.allocate (n);
+    }
+
+    void deallocate (T *ptr, std::size_t n) noexcept
+    {
+        *n_live_ -= n;
+        std::allocator<T>{}.deallocate (ptr, n);
+    }
+
+    template<typename U>
+    bool operator== (const Counting_Allocator<U> &rhs) const noexcept
+    {
+        return n_live_ == rhs.n_live_;
+    }
+};
+
+} // unnamed namespace
+
+TEST (Optimistic_Tree, Reader_Queries)
+{
+    yLab::Optimistic_ARB_Tree<int> tree = {40, 10, 30, 20};
+    auto reader = tree.reader();
+
+    EXPECT_EQ (reader.size(), 4);
+    EXPECT_TRUE (reader.contains (30));
+    EXPECT_FALSE (reader.contains (35));
+    EXPECT_EQ (reader[1], 10);
+    EXPECT_EQ (reader[4], 40);
+    EXPECT_EQ (reader[5], std::nullopt);
+    EXPECT_EQ (reader.n_less_than (30), 2);
+    EXPECT_EQ (reader.n_less_equal (30), 3);
+
+    auto version = tree.version();
+    EXPECT_TRUE (tree.insert (25));
+    EXPECT_FALSE (tree.insert (25));
+    EXPECT_EQ (tree.erase (10), 1);
+    EXPECT_EQ (tree.erase (10), 0);
+    EXPECT_EQ (tree.version(), version + 2);
+
+    EXPECT_EQ (reader[1], 20);
+    EXPECT_EQ (reader.n_less_than (30), 2);
+    EXPECT_EQ (tree.size(), 4);
+
+    auto snapshot = tree.snapshot();
+    tree.clear();
+    EXPECT_TRUE (tree.empty());
+    EXPECT_EQ (reader.size(), 0);
+    EXPECT_EQ (snapshot.size(), 4);
+}
+
+TEST (Optimistic_Tree, Reader_Slots)
+{
+    yLab::Optimistic_ARB_Tree<int, std::less<int>, std::allocator<int>, 2> tree;
+
+    auto reader_1 = tree.reader();
+    {
+        auto reader_2 = tree.reader();
+        EXPECT_THROW (tree.reader(), std::length_error);
+    }
+
+    auto reader_2 = tree.reader();
+    auto moved = std::move (reader_2);
+    EXPECT_THROW (tree.reader(), std::length_error);
+}
+
+TEST (Optimistic_Tree, Retired_Nodes_Are_Freed)
+{
+    std::atomic<long> n_live = 0;
+
+    {
+        using allocator_type = Counting_Allocator<int>;
+        using tree_type = yLab::Optimistic_ARB_Tree<int, std::less<int>, allocator_type>;
+
+        tree_type tree{std::less<int>{}, allocator_type{&n_live}};
+        auto reader = tree.reader();
+
+        for (auto key = 0; key != 300; ++key)
+            tree.insert (key);
+
+        // A read in progress keeps the version it has started with
+        reader.read ([&](auto root)
+        {
+            for (auto key = 0; key != 300; ++key)
+                tree.erase (key);
+
+            EXPECT_EQ (root->subtree_size_, 300);
+            EXPECT_GE (n_live.load(), 300);
+            return 0;
+        });
+
+        // No reads in progress: the next modification frees every retired version
+        tree.insert (0);
+        EXPECT_EQ (n_live.load(), 1);
+    }
+
+    EXPECT_EQ (n_live.load(), 0);
+}
+
+TEST (Optimistic_Tree, Nested_Reads)
+{
+    std::atomic<long> n_live = 0;
+
+    using allocator_type = Counting_Allocator<int>;
+    using tree_type = yLab::Optimistic_ARB_Tree<int, std::less<int>, allocator_type>;
+
+    tree_type tree{std::less<int>{}, allocator_type{&n_live}};
+    auto reader = tree.reader();
+
+    for (auto key = 0; key != 300; ++key)
+        tree.insert (key);
+
+    // A query made through the same handle mustn't end the outer read
+    reader.read ([&](auto root)
+    {
+        EXPECT_EQ (reader.size(), 300);
+
+        for (auto key = 0; key != 300; ++key)
+            tree.erase (key);
+
+        EXPECT_EQ (reader.size(), 0);
+        EXPECT_EQ (root->subtree_size_, 300);
+        EXPECT_GE (n_live.load(), 300);
+        return 0;
+    });
+
+    tree.insert (0);
+    EXPECT_EQ (n_live.load(), 1);
+}
+
+TEST (Optimistic_Tree, Concurrent_Readers)
+{
+    constexpr int n_keys = 3000;
+
+    yLab::Optimistic_ARB_Tree<int> tree;
+    std::atomic<bool> done = false;
+    std::atomic<int> n_failures = 0;
+
+    // Keys are inserted in increasing order, so every version holds 0, 1, ..., size - 1
+    auto reader_thread = [&]
+    {
+        auto reader = tree.reader();
+
+        while (!done.load())
+        {
+            auto is_consistent = reader.read ([&](auto root)
+            {
+                auto size = static_cast<int>(root ? root->subtree_size_ : 0);
+
+                for (auto k = 1; k <= size; k += 97)
+                {
+                    auto node = yLab::detail::kth_persistent_node (root, k);
+                    if (node->key_ != k - 1)
+                        return false;
+                }
+
+                return true;
+            });
+
+            if (!is_consistent)
+                n_failures++;
+
+            if (auto last = reader[reader.size()];
+                last && reader.n_less_than (*last) > static_cast<std::size_t>(*last))
+                n_failures++;
+        }
+    };
+
+    std::vector<std::thread> readers;
+    for (auto i = 0; i != 3; ++i)
+        readers.emplace_back (reader_thread);
+
+    for (auto key = 0; key != n_keys; ++key)
+        tree.insert (key);
+
+    for (auto key = n_keys - 1; key >= n_keys / 2; --key)
+        tree.erase (key);
+
+    done = true;
+    for (auto &thread : readers)
+        thread.join();
+
+    EXPECT_EQ (n_failures.load(), 0);
+    EXPECT_EQ (tree.size(), n_keys / 2);
+}
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <set>
+
+#include "persistent_tree.hpp"
+
+TEST (Persistent_Tree, Modifications)
+{
+    yLab::Persistent_ARB_Tree<int> tree;
+    std::set<int> model;
+
+    std::mt19937 gen{18};
+    std::uniform_int_distribution<int> key_dist{0, 500};
+
+    for (auto i = 0; i != 3000; ++i)
+    {
+        auto key = key_dist (gen);
+        if (i % 3 == 2)
+            EXPECT_EQ (tree.erase (key), model.erase (key));
+        else
+            EXPECT_EQ (tree.insert (key), model.insert (key).second);
+    }
+
+    auto snapshot = tree.snapshot();
+    ASSERT_EQ (snapshot.size(), model.size());
+    EXPECT_TRUE (std::equal (snapshot.begin(), snapshot.end(), model.begin(), model.end()));
+
+    auto model_it = model.begin();
+    for (std::size_t k = 1; k <= model.size(); ++k, ++model_it)
+    {
+        EXPECT_EQ (*snapshot[k], *model_it);
+        EXPECT_EQ (snapshot.n_less_than (*model_it), k - 1);
+        EXPECT_TRUE (snapshot.contains (*model_it));
+    }
+
+    EXPECT_EQ (snapshot[model.size() + 1], snapshot.end());
+    EXPECT_EQ (*snapshot.lower_bound (250), *model.lower_bound (250));
+    EXPECT_EQ (snapshot.count_range (100, 300),
+               std::distance (model.lower_bound (100), model.lower_bound (300)));
+
+    // The iterator from operator[] goes on in order
+    auto it = snapshot[10];
+    EXPECT_TRUE (std::equal (it, snapshot.end(), std::next (model.begin(), 9), model.end()));
+}
+
+TEST (Persistent_Tree, Snapshots_Are_Immutable)
+{
+    yLab::Persistent_ARB_Tree<int> tree = {1, 2, 3, 4, 5};
+
+    auto before = tree.snapshot();
+    auto copy = tree;
+
+    tree.erase (3);
+    tree.insert (10);
+    copy.insert (0);
+
+    EXPECT_EQ (before.size(), 5);
+    EXPECT_TRUE (before.contains (3));
+    EXPECT_FALSE (before.contains (10));
+    EXPECT_EQ (*before[3], 3);
+
+    std::vector<int> after{tree.snapshot().begin(), tree.snapshot().end()};
+    EXPECT_EQ (after, (std::vector{1, 2, 4, 5, 10}));
+    EXPECT_EQ (*copy.snapshot()[1], 0);
+
+    tree.clear();
+    EXPECT_TRUE (tree.empty());
+    EXPECT_EQ (before.size(), 5);
+}
+
+TEST (Persistent_Tree, Concurrent_Readers)
+{
+    constexpr int n_keys = 3000;
+
+    yLab::Persistent_ARB_Tree<int> tree;
+    std::atomic<bool> done = false;
+    std::atomic<int> n_failures = 0;
+
+    // Keys are inserted in increasing order, so a consistent version holds 0, 1, ..., size - 1
+    auto reader = [&]
+    {
+        while (!done.load())
+        {
+            auto snapshot = tree.snapshot();
+            auto size = static_cast<int>(snapshot.size());
+
+            for (auto k = 1; k <= size; k += 97)
+            {
+                if (*snapshot[k] != k - 1 || snapshot.n_less_than (k - 1) != std::size_t(k - 1))
+                    n_failures++;
+            }
+
+            if (snapshot.contains (size))
+                n_failures++;
+        }
+    };
+
+    std::vector<std::thread> readers;
+    for (auto i = 0; i != 3; ++i)
+        readers.emplace_back (reader);
+
+    for (auto key = 0; key != n_keys; ++key)
+        tree.insert (key);
+
+    for (auto key = n_keys - 1; key >= n_keys / 2; --key)
+        tree.erase (key);
+
+    done = true;
+    for (auto &thread : readers)
+        thread.join();
+
+    EXPECT_EQ (n_failures.load(), 0);
+    EXPECT_EQ (tree.size(), n_keys / 2);
+}
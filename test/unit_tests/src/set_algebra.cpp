@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <memory_resource>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <vector>
+#include <set>
+#include <bit>
+#include <thread>
+#include <mutex>
+
+#include "set_algebra.hpp"
+
+namespace
+{
+
+std::set<int> random_keys (std::size_t n, int max_key, std::uint32_t seed)
+{
+    std::mt19937 gen{seed};
+    std::uniform_int_distribution<int> dist{0, max_key};
+
+    std::set<int> keys;
+    while (keys.size() != n)
+        keys.insert (dist (gen));
+
+    return keys;
+}
+
+template<typename Tree>
+void expect_same (const Tree &tree, const std::vector<int> &model)
+{
+    ASSERT_EQ (tree.size(), model.size());
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+
+    for (std::size_t k = 1; k <= model.size(); k += 97)
+        EXPECT_EQ (*tree[k], model[k - 1]);
+}
+
+// Remembers every thread that compares keys
+struct Recording_Less
+{
+    static inline std::mutex mutex;
+    static inline std::set<std::thread::id> threads;
+
+    bool operator() (int lhs, int rhs) const
+    {
+        thread_local bool recorded = false;
+        if (!recorded)
+        {
+            std::lock_guard lock{mutex};
+            threads.insert (std::this_thread::get_id());
+            recorded = true;
+        }
+
+        return lhs < rhs;
+    }
+};
+
+} // unnamed namespace
+
+TEST (Set_Algebra, Small_Trees)
+{
+    using tree_type = yLab::ARB_Tree<int>;
+
+    tree_type lhs = {1, 3, 5, 7, 9};
+    tree_type rhs = {3, 4, 5, 6};
+
+    EXPECT_EQ (yLab::set_union (lhs, rhs), (tree_type{1, 3, 4, 5, 6, 7, 9}));
+    EXPECT_EQ (yLab::set_intersection (lhs, rhs), (tree_type{3, 5}));
+    EXPECT_EQ (yLab::set_difference (lhs, rhs), (tree_type{1, 7, 9}));
+    EXPECT_EQ (yLab::set_difference (rhs, lhs), (tree_type{4, 6}));
+
+    EXPECT_EQ (yLab::set_union (tree_type{}, rhs), rhs);
+    EXPECT_TRUE (yLab::set_intersection (lhs, tree_type{}).empty());
+    EXPECT_EQ (yLab::set_difference (lhs, tree_type{}), lhs);
+    EXPECT_TRUE (yLab::set_difference (lhs, lhs).empty());
+}
+
+TEST (Set_Algebra, Large_Trees)
+{
+    auto lhs_keys = random_keys (100'000, 1'000'000, 1);
+    auto rhs_keys = random_keys (60'000, 1'000'000, 2);
+
+    yLab::ARB_Tree<int> lhs{lhs_keys.begin(), lhs_keys.end()};
+    yLab::ARB_Tree<int> rhs{rhs_keys.begin(), rhs_keys.end()};
+
+    std::vector<int> model;
+    std::set_union (lhs_keys.begin(), lhs_keys.end(), rhs_keys.begin(), rhs_keys.end(),
+                    std::back_inserter (model));
+    expect_same (yLab::set_union (lhs, rhs), model);
+
+    model.clear();
+    std::set_intersection (lhs_keys.begin(), lhs_keys.end(), rhs_keys.begin(), rhs_keys.end(),
+                           std::back_inserter (model));
+    expect_same (yLab::set_intersection (lhs, rhs), model);
+
+    model.clear();
+    std::set_difference (lhs_keys.begin(), lhs_keys.end(), rhs_keys.begin(), rhs_keys.end(),
+                         std::back_inserter (model));
+    expect_same (yLab::set_difference (std::move (lhs), std::move (rhs)), model);
+}
+
+TEST (Set_Algebra, Bounded_Forking)
+{
+    using tree_type = yLab::ARB_Tree<int, Recording_Less>;
+
+    auto lhs_keys = random_keys (400'000, 4'000'000, 3);
+    auto rhs_keys = random_keys (400'000, 4'000'000, 4);
+
+    tree_type lhs{lhs_keys.begin(), lhs_keys.end()};
+    tree_type rhs{rhs_keys.begin(), rhs_keys.end()};
+
+    Recording_Less::threads.clear();
+    auto result = yLab::set_union (std::move (lhs), std::move (rhs));
+
+    // Every level of forking at most doubles the number of threads
+    auto n_threads = std::max (std::thread::hardware_concurrency(), 1u);
+    auto max_threads = std::size_t{1} << std::bit_width (n_threads);
+
+    EXPECT_LE (Recording_Less::threads.size(), max_threads);
+    EXPECT_GE (result.size(), lhs_keys.size());
+}
+
+TEST (Set_Algebra, Unequal_Allocators)
+{
+    std::pmr::unsynchronized_pool_resource resource_1;
+    std::pmr::unsynchronized_pool_resource resource_2;
+
+    yLab::pmr::ARB_Tree<int> lhs{{1, 2, 3, 4}, &resource_1};
+    yLab::pmr::ARB_Tree<int> rhs{{3, 4, 5}, &resource_2};
+
+    auto result = yLab::set_union (std::move (lhs), std::move (rhs));
+
+    EXPECT_EQ (result.get_allocator().resource(), &resource_1);
+    EXPECT_EQ (result, (yLab::pmr::ARB_Tree<int>{1, 2, 3, 4, 5}));
+}
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <compare>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+#include <set>
+
+#include "sharded_tree.hpp"
+
+TEST (Sharded_Tree, Fenwick_Tree)
+{
+    yLab::detail::Atomic_Fenwick_Tree sizes;
+    std::vector<std::size_t> values = {3, 0, 5, 1, 0, 2, 4};
+    sizes.assign (values);
+
+    EXPECT_EQ (sizes.size(), values.size());
+    EXPECT_EQ (sizes.prefix (0), 0);
+    EXPECT_EQ (sizes.prefix (3), 8);
+    EXPECT_EQ (sizes.prefix (7), 15);
+
+    EXPECT_EQ (sizes.find (1), (std::pair<std::size_t, std::size_t>{0, 0}));
+    EXPECT_EQ (sizes.find (4), (std::pair<std::size_t, std::size_t>{2, 3}));
+    EXPECT_EQ (sizes.find (9), (std::pair<std::size_t, std::size_t>{3, 8}));
+    EXPECT_EQ (sizes.find (15), (std::pair<std::size_t, std::size_t>{6, 11}));
+    EXPECT_EQ (sizes.find (16).first, 7);
+
+    sizes.add (1, 2);
+    sizes.add (2, std::size_t(0) - 5);
+    EXPECT_EQ (sizes.prefix (3), 5);
+    EXPECT_EQ (sizes.find (4), (std::pair<std::size_t, std::size_t>{1, 3}));
+}
+
+TEST (Sharded_Tree, Order_Statistics)
+{
+    yLab::Sharded_ARB_Tree<int> tree{std::vector{250, 500, 750}};
+    std::set<int> model;
+
+    std::mt19937 gen{20};
+    std::uniform_int_distribution<int> key_dist{0, 1000};
+
+    for (auto i = 0; i != 3000; ++i)
+    {
+        auto key = key_dist (gen);
+        if (i % 3 == 2)
+            EXPECT_EQ (tree.erase (key), model.erase (key));
+        else
+            EXPECT_EQ (tree.insert (key), model.insert (key).second);
+    }
+
+    auto check = [&]
+    {
+        ASSERT_EQ (tree.size(), model.size());
+
+        auto model_it = model.begin();
+        for (std::size_t k = 1; k <= model.size(); ++k, ++model_it)
+        {
+            EXPECT_EQ (tree[k], *model_it);
+            EXPECT_EQ (tree.n_less_than (*model_it), k - 1);
+            EXPECT_EQ (tree.n_less_equal (*model_it), k);
+        }
+
+        EXPECT_EQ (tree[0], std::nullopt);
+        EXPECT_EQ (tree[model.size() + 1], std::nullopt);
+        EXPECT_EQ (tree.n_less_than (1001), model.size());
+
+        std::vector<int> keys;
+        tree.for_each ([&](int key){ keys.push_back (key); });
+        EXPECT_TRUE (std::equal (keys.begin(), keys.end(), model.begin(), model.end()));
+    };
+
+    check();
+    EXPECT_EQ (tree.n_shards(), 4);
+
+    tree.rebalance();
+    EXPECT_EQ (tree.n_shards(), 1);
+    check();
+}
+
+TEST (Sharded_Tree, Rebalancing)
+{
+    yLab::Sharded_ARB_Tree<int> tree{std::less<int>{}, std::allocator<int>{}, 100};
+
+    // The only shard grows past twice the maximum size and is split by the writer
+    for (auto key = 0; key != 201; ++key)
+        tree.insert (key);
+    EXPECT_EQ (tree.n_shards(), 3);
+
+    for (auto key = 201; key != 1000; ++key)
+        tree.insert (key);
+    tree.rebalance();
+    EXPECT_GE (tree.n_shards(), 10);
+
+    for (auto key = 0; key < 1000; key += 7)
+        EXPECT_EQ (tree.n_less_than (key), key);
+
+    for (auto key = 100; key != 1000; ++key)
+        tree.erase (key);
+    tree.rebalance();
+    EXPECT_EQ (tree.n_shards(), 2);
+    EXPECT_EQ (tree[100], 99);
+    EXPECT_EQ (tree.size(), 100);
+}
+
+namespace
+{
+
+// Copies of keys throw while copies_fail is set
+struct Fragile_Key
+{
+    static inline bool copies_fail = false;
+
+    int value;
+
+    Fragile_Key (int v) : value{v} {}
+
+    Fragile_Key (const Fragile_Key &rhs) : value{rhs.value}
+    {
+        if (copies_fail)
+            throw std::bad_alloc{};
+    }
+
+    Fragile_Key &operator= (const Fragile_Key &rhs) = default;
+
+    auto operator<=> (const Fragile_Key &rhs) const = default;
+};
+
+} // unnamed namespace
+
+TEST (Sharded_Tree, Failed_Rebalancing)
+{
+    yLab::Sharded_ARB_Tree<Fragile_Key> tree{std::less<Fragile_Key>{},
+                                             std::allocator<Fragile_Key>{}, 100};
+    for (auto key = 0; key != 150; ++key)
+        tree.insert (key);
+
+    // New bounds are copied before any shard is touched
+    Fragile_Key::copies_fail = true;
+    EXPECT_THROW (tree.rebalance(), std::bad_alloc);
+    Fragile_Key::copies_fail = false;
+
+    EXPECT_EQ (tree.n_shards(), 1);
+    EXPECT_EQ (tree.size(), 150);
+
+    // operator[] would look for keys that sizes of shards promise forever
+    std::size_t n_keys = 0;
+    tree.for_each ([&n_keys](const Fragile_Key &){ n_keys++; });
+    ASSERT_EQ (n_keys, 150);
+
+    for (std::size_t k = 1; k <= 150; ++k)
+        EXPECT_EQ (tree[k]->value, static_cast<int>(k) - 1);
+
+    tree.rebalance();
+    EXPECT_EQ (tree.n_shards(), 2);
+    EXPECT_EQ (tree.n_less_than (120), 120);
+}
+
+TEST (Sharded_Tree, Background_Rebalancing)
+{
+    yLab::Sharded_ARB_Tree<int> tree{std::less<int>{}, std::allocator<int>{}, 100};
+    tree.start_background_rebalancing();
+
+    for (auto key = 0; key != 1000; ++key)
+        tree.insert (key);
+
+    // Writers only wake the rebalancer up, so shards are split a bit later
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+    while (tree.n_shards() < 5 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for (std::chrono::milliseconds{1});
+
+    EXPECT_GE (tree.n_shards(), 5);
+    EXPECT_EQ (tree.size(), 1000);
+    for (auto key = 0; key < 1000; key += 7)
+        EXPECT_EQ (tree.n_less_than (key), key);
+}
+
+TEST (Sharded_Tree, Concurrent_Writers)
+{
+    constexpr int n_threads = 4;
+    constexpr int n_keys = 4000;
+
+    yLab::Sharded_ARB_Tree<int> tree{std::less<int>{}, std::allocator<int>{}, 256};
+    std::atomic<int> n_failures = 0;
+
+    // Every thread inserts its own residue class and erases a half of it
+    auto writer = [&](int residue)
+    {
+        for (auto key = residue; key < n_keys; key += n_threads)
+        {
+            if (!tree.insert (key) || !tree.contains (key))
+                n_failures++;
+        }
+
+        for (auto key = residue; key < n_keys; key += 2 * n_threads)
+            tree.erase (key);
+    };
+
+    std::vector<std::thread> writers;
+    for (auto residue = 0; residue != n_threads; ++residue)
+        writers.emplace_back (writer, residue);
+
+    std::thread rebalancer{[&]
+    {
+        for (auto i = 0; i != 20; ++i)
+            tree.rebalance();
+    }};
+
+    for (auto &thread : writers)
+        thread.join();
+    rebalancer.join();
+
+    EXPECT_EQ (n_failures.load(), 0);
+    ASSERT_EQ (tree.size(), n_keys / 2);
+
+    for (std::size_t k = 1; k <= tree.size(); k += 13)
+    {
+        auto key = *tree[k];
+        EXPECT_GE (key % (2 * n_threads), n_threads);
+        EXPECT_EQ (tree.n_less_than (key), k - 1);
+    }
+}
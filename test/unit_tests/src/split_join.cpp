@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "arb_tree.hpp"
+
+TEST (Split_Join, Split_By_Key)
+{
+    for (auto n : {0, 1, 2, 7, 100, 1000})
+    {
+        std::vector<int> keys(n);
+        std::iota (keys.begin(), keys.end(), 0);
+
+        for (auto key : {-1, 0, 1, n / 3, n / 2, n - 1, n, n + 5})
+        {
+            // Random order of insertion gives trees of different shapes
+            auto shuffled = keys;
+            std::shuffle (shuffled.begin(), shuffled.end(), std::mt19937{std::uint32_t(n + key)});
+
+            yLab::ARB_Tree<int> tree{shuffled.begin(), shuffled.end()};
+            auto [less, greater] = tree.split (key);
+
+            auto middle = std::lower_bound (keys.begin(), keys.end(), key);
+
+            EXPECT_TRUE (tree.empty());
+            EXPECT_EQ (tree.begin(), tree.end());
+            EXPECT_TRUE (std::equal (less.begin(), less.end(), keys.begin(), middle));
+            EXPECT_TRUE (std::equal (greater.begin(), greater.end(), middle, keys.end()));
+            EXPECT_EQ (less.size(), std::distance (keys.begin(), middle));
+            EXPECT_EQ (greater.size(), std::distance (middle, keys.end()));
+
+            less.insert (key - 10000);
+            greater.insert (key + 10000);
+            EXPECT_EQ (*less.begin(), key - 10000);
+            EXPECT_EQ (*greater.rbegin(), key + 10000);
+        }
+    }
+}
+
+TEST (Split_Join, Split_At_Rank)
+{
+    std::vector<int> keys(300);
+    std::iota (keys.begin(), keys.end(), 0);
+
+    for (auto k : {0, 1, 2, 150, 299, 300, 400})
+    {
+        yLab::Compact_ARB_Tree<int> tree{keys.begin(), keys.end()};
+        tree.insert (1000);
+        tree.erase (1000);
+
+        auto [first, second] = tree.split_at_rank (k);
+        auto n_first = std::min<std::size_t>(k, keys.size());
+
+        EXPECT_EQ (first.size(), n_first);
+        EXPECT_EQ (second.size(), keys.size() - n_first);
+        EXPECT_TRUE (std::equal (first.begin(), first.end(), keys.begin(), keys.begin() + n_first));
+        EXPECT_TRUE (std::equal (second.begin(), second.end(), keys.begin() + n_first, keys.end()));
+    }
+}
+
+TEST (Split_Join, Join)
+{
+    std::mt19937 gen{7};
+
+    for (auto n_left : {0, 1, 3, 64, 500})
+        for (auto n_right : {0, 1, 2, 31, 700})
+        {
+            std::vector<int> keys(n_left + n_right);
+            std::iota (keys.begin(), keys.end(), 0);
+
+            auto left_keys = std::vector(keys.begin(), keys.begin() + n_left);
+            auto right_keys = std::vector(keys.begin() + n_left, keys.end());
+            std::shuffle (left_keys.begin(), left_keys.end(), gen);
+            std::shuffle (right_keys.begin(), right_keys.end(), gen);
+
+            yLab::ARB_Tree<int> left{left_keys.begin(), left_keys.end()};
+            yLab::ARB_Tree<int> right{right_keys.begin(), right_keys.end()};
+
+            auto tree = yLab::ARB_Tree<int>::join (std::move (left), std::move (right));
+
+            EXPECT_EQ (tree.size(), keys.size());
+            EXPECT_TRUE (std::equal (tree.begin(), tree.end(), keys.begin(), keys.end()));
+
+            for (auto k = 1; k <= static_cast<int>(keys.size()); k += 17)
+                EXPECT_EQ (*tree[k], k - 1);
+        }
+}
+
+TEST (Split_Join, Range_Migration)
+{
+    yLab::Pooled_ARB_Tree<int> tree;
+    for (auto key = 0; key != 1000; ++key)
+        tree.insert (key);
+
+    // Cuts [200, 400) out and puts it back
+    auto [head, rest] = tree.split (200);
+    auto [range, tail] = rest.split (400);
+
+    EXPECT_EQ (range.size(), 200);
+    EXPECT_EQ (*range.begin(), 200);
+
+    auto joined = decltype (tree)::join (std::move (head), std::move (tail));
+    EXPECT_EQ (joined.size(), 800);
+    EXPECT_EQ (joined.n_less_than (500), 300);
+
+    auto [lower, upper] = joined.split (200);
+    auto restored = decltype (tree)::join (std::move (lower),
+                                           decltype (tree)::join (std::move (range),
+                                                                  std::move (upper)));
+    EXPECT_EQ (restored.size(), 1000);
+    for (auto k = 1; k <= 1000; ++k)
+        EXPECT_EQ (*restored[k], k - 1);
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <compare>
+#include <random>
+#include <string>
+#include <vector>
+#include <set>
+
+#include "arb_map.hpp"
+
+namespace
+{
+
+// Counts calls of both forms of comparison
+struct Counting_Compare
+{
+    static inline std::size_t n_less = 0;
+    static inline std::size_t n_three_way = 0;
+
+    bool operator() (const std::string &lhs, const std::string &rhs) const
+    {
+        n_less++;
+        return lhs < rhs;
+    }
+
+    std::weak_ordering compare (const std::string &lhs, const std::string &rhs) const
+    {
+        n_three_way++;
+        return lhs <=> rhs;
+    }
+
+    static void reset () noexcept { n_less = n_three_way = 0; }
+};
+
+std::vector<std::string> random_strings (std::size_t n, std::uint32_t seed)
+{
+    std::mt19937 gen{seed};
+    std::uniform_int_distribution<int> dist{0, 99999};
+
+    std::vector<std::string> strings;
+    for (std::size_t i = 0; i != n; ++i)
+        strings.push_back ("key_" + std::to_string (dist (gen)));
+
+    return strings;
+}
+
+} // unnamed namespace
+
+using yLab::detail::three_way_comparator;
+
+static_assert (three_way_comparator<std::less<int>, int, int>);
+static_assert (three_way_comparator<std::less<>, std::string, const char *>);
+static_assert (three_way_comparator<Counting_Compare, std::string, std::string>);
+static_assert (!three_way_comparator<std::greater<int>, int, int>);
+static_assert (!three_way_comparator<std::less<int *>, int *, int *>);
+
+TEST (Three_Way, One_Comparison_Per_Node)
+{
+    yLab::ARB_Tree<std::string, Counting_Compare> tree;
+    std::set<std::string> model;
+
+    for (const auto &key : random_strings (2000, 25))
+    {
+        Counting_Compare::reset();
+        EXPECT_EQ (tree.insert (key).second, model.insert (key).second);
+
+        // Verifiers of debug builds call operator() after every insertion
+        EXPECT_LE (Counting_Compare::n_three_way, tree.height());
+    }
+
+    for (const auto &key : random_strings (500, 26))
+    {
+        Counting_Compare::reset();
+        EXPECT_EQ (tree.contains (key), model.contains (key));
+
+        EXPECT_LE (Counting_Compare::n_three_way, tree.height());
+        EXPECT_EQ (Counting_Compare::n_less, 0);
+    }
+
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+}
+
+TEST (Three_Way, Multiset)
+{
+    yLab::ARB_Multiset<std::string, Counting_Compare> tree;
+    std::multiset<std::string> model;
+
+    for (const auto &key : random_strings (1000, 27))
+    {
+        tree.insert (key.substr (0, 5));
+        model.insert (key.substr (0, 5));
+    }
+
+    ASSERT_EQ (tree.size(), model.size());
+    EXPECT_TRUE (std::equal (tree.begin(), tree.end(), model.begin(), model.end()));
+    EXPECT_EQ (tree.count ("key_1"), model.count ("key_1"));
+    EXPECT_EQ (*tree.find ("key_5"), "key_5");
+}
+
+TEST (Three_Way, Map)
+{
+    yLab::ARB_Map<std::string, int, Counting_Compare> map;
+    for (auto i = 0; i != 100; ++i)
+        map.try_emplace ("key_" + std::to_string (i), i);
+
+    Counting_Compare::reset();
+    EXPECT_EQ (map.find ("key_42")->second, 42);
+    EXPECT_EQ (Counting_Compare::n_less, 0);
+    EXPECT_GT (Counting_Compare::n_three_way, 0);
+
+    EXPECT_FALSE (map.try_emplace ("key_42", 0).second);
+    EXPECT_EQ (map.at ("key_42"), 42);
+    EXPECT_EQ (map.size(), 100);
+}
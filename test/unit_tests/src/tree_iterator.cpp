@@ -1,17 +1,24 @@
 #include <gtest/gtest.h>
 #include <utility>
+#include <iterator>
 
 #include "arb_tree.hpp"
+#include "engines.hpp"
 
-TEST (Iterators, Check_Iterator_Concept)
+template<typename Tree>
+class Iterators : public testing::Test {};
+
+TYPED_TEST_SUITE (Iterators, Engines);
+
+TEST (ARB_Iterators, Check_Iterator_Concept)
 {
     using node_type = yLab::ARB_Node<int>;
     static_assert (std::bidirectional_iterator<yLab::tree_iterator<node_type>>);
 }
 
-TEST (Iterators, Preincrement)
+TYPED_TEST (Iterators, Preincrement)
 {
-    yLab::ARB_Tree tree = {1, 2, 3, 4, 5};
+    TypeParam tree = {1, 2, 3, 4, 5};
     auto it_1 = tree.find (2);
     auto it_2 = tree.find (3);
     auto it_3 = ++it_1;
@@ -20,9 +27,9 @@ TEST (Iterators, Preincrement)
     EXPECT_EQ (it_3, it_2);
 }
 
-TEST (Iterators, Postincrement)
+TYPED_TEST (Iterators, Postincrement)
 {
-    yLab::ARB_Tree tree = {1, 2, 3, 4, 5};
+    TypeParam tree = {1, 2, 3, 4, 5};
     auto it_1 = tree.find (2);
     auto it_2 = tree.find (3);
     auto it_1_copy = it_1;
@@ -32,9 +39,9 @@ TEST (Iterators, Postincrement)
     EXPECT_EQ (it_3, it_1_copy);
 }
 
-TEST (Iterators, Predecrement)
+TYPED_TEST (Iterators, Predecrement)
 {
-    yLab::ARB_Tree tree = {1, 2, 3, 4, 5};
+    TypeParam tree = {1, 2, 3, 4, 5};
     auto it_1 = tree.find (2);
     auto it_2 = tree.find (1);
     auto it_3 = --it_1;
@@ -43,9 +50,9 @@ TEST (Iterators, Predecrement)
     EXPECT_EQ (it_3, it_2);
 }
 
-TEST (Iterators, Postdecrement)
+TYPED_TEST (Iterators, Postdecrement)
 {
-    yLab::ARB_Tree tree = {1, 2, 3, 4, 5};
+    TypeParam tree = {1, 2, 3, 4, 5};
     auto it_1 = tree.find (2);
     auto it_2 = tree.find (1);
     auto it_1_copy = it_1;
@@ -55,16 +62,16 @@ TEST (Iterators, Postdecrement)
     EXPECT_EQ (it_3, it_1_copy);
 }
 
-TEST (Iterators, Dereference)
+TYPED_TEST (Iterators, Dereference)
 {
-    yLab::ARB_Tree tree = {1, 2, 3, 4, 5};
+    TypeParam tree = {1, 2, 3, 4, 5};
 
     auto elem = 1;
     for (auto it = tree.begin(), ite = tree.end(); it != ite; ++it, ++elem)
         EXPECT_EQ (*it, elem);
 }
 
-TEST (Iterators, Arrow)
+TEST (ARB_Iterators, Arrow)
 {
     yLab::ARB_Tree<std::pair<int, int>> tree = {{1, -1}, {2, -2}, {3, -3}};
 
@@ -75,3 +82,51 @@ TEST (Iterators, Arrow)
         EXPECT_EQ (it->second, -elem);
     }
 }
+
+TEST (ARB_Iterators, Sized_Sentinel)
+{
+    using iterator = typename yLab::ARB_Tree<int>::iterator;
+    static_assert (std::sized_sentinel_for<iterator, iterator>);
+
+    yLab::ARB_Tree<int> tree;
+    for (auto key = 0; key != 100; ++key)
+        tree.insert (key);
+
+    EXPECT_EQ (std::ranges::distance (tree.begin(), tree.end()), 100);
+    EXPECT_EQ (tree.end() - tree.begin(), 100);
+    EXPECT_EQ (tree.find (10) - tree.find (30), -20);
+}
+
+TEST (ARB_Iterators, Rank_Next_Prev)
+{
+    yLab::ARB_Tree<int> tree;
+    for (auto key = 0; key != 200; key += 2)
+        tree.insert (key);
+
+    auto n = static_cast<int>(tree.size());
+
+    for (auto i = 0; i <= n; ++i)
+    {
+        auto it = (i == n) ? tree.end() : tree.find (2 * i);
+        EXPECT_EQ (tree.rank (it), i);
+
+        for (auto k = 0; k <= n + 2; k += 7)
+        {
+            auto next = tree.next (it, k);
+            if (i + k >= n)
+                EXPECT_EQ (next, tree.end());
+            else
+                EXPECT_EQ (*next, 2 * (i + k));
+
+            if (k <= i)
+            {
+                auto prev = tree.prev (it, k);
+                EXPECT_EQ (tree.rank (prev), i - k);
+                EXPECT_EQ (tree.distance (prev, it), k);
+            }
+        }
+    }
+
+    EXPECT_EQ (tree.next (tree.begin()), std::next (tree.begin()));
+    EXPECT_EQ (tree.prev (tree.end()), std::prev (tree.end()));
+}